@@ -0,0 +1,261 @@
+﻿#include "animation.h"
+#include "parallel.h"
+
+#include <algorithm>  // std::min, std::max
+#include <chrono>     // 経過時間の計測
+#include <cmath>      // std::fabs
+
+// 3D勾配配列の大きさ（x, y は画面より十分大きく、時間方向はこの周期で繰り返す）
+const int VOLUME_SIZE = 128;
+const int VOLUME_DEPTH = 16;
+const unsigned ANIMATION_SEED = 123;
+
+// 生成時間の移動平均の重み（大きいほど直近のフレームを重視）
+const double AVERAGE_WEIGHT = 0.1;
+
+// 品質を変えた後、次に変えるまで待つフレーム数（下げるときは早く、上げるときは慎重に）
+const int DOWNGRADE_COOLDOWN = 10;
+const int UPGRADE_COOLDOWN = 30;
+
+// 品質を上げたときの予測時間がこの割合以下なら上げる（上げ下げの往復を防ぐ余裕）
+const double UPGRADE_HEADROOM = 0.8;
+
+// 品質ごとの相対的な計算量（計算するピクセル数 × オクターブ数）
+static double qualityCost(const FrameQuality& q) {
+    return (double)q.octaves / ((double)q.step * q.step);
+}
+
+FrameBudget makeFrameBudget(double budgetMs, int maxOctaves) {
+    FrameBudget budget;
+    budget.budgetMs = budgetMs;
+
+    int octaves = std::max(maxOctaves, 1);
+    int half = (octaves + 1) / 2;
+
+    // 先にオクターブを減らし、それでも足りなければ解像度を下げる
+    const FrameQuality candidates[] = {
+        { 1, octaves }, { 1, half }, { 2, octaves }, { 2, half }, { 4, half }, { 4, 1 },
+    };
+    for (const FrameQuality& q : candidates) {
+        if (!budget.ladder.empty() && budget.ladder.back().step == q.step &&
+            budget.ladder.back().octaves == q.octaves) continue;
+        budget.ladder.push_back(q);
+    }
+    return budget;
+}
+
+FrameQuality currentQuality(const FrameBudget& budget) {
+    return budget.ladder[budget.level];
+}
+
+void recordFrameTime(FrameBudget& budget, double generateMs) {
+    FrameStats& s = budget.stats;
+
+    // 統計の更新
+    if (s.frames == 0) {
+        s.averageMs = s.minMs = s.maxMs = generateMs;
+    } else {
+        s.averageMs += (generateMs - s.averageMs) * AVERAGE_WEIGHT;
+        s.minMs = std::min(s.minMs, generateMs);
+        s.maxMs = std::max(s.maxMs, generateMs);
+    }
+    s.lastMs = generateMs;
+    s.frames++;
+    if (generateMs > budget.budgetMs) s.overBudget++;
+
+    if (budget.cooldown > 0) {
+        budget.cooldown--;
+        return;
+    }
+
+    // 移動平均が予算を超えていれば1段階下げ、上げても予算に余裕があれば1段階上げる
+    int next = budget.level;
+    if (s.averageMs > budget.budgetMs && budget.level + 1 < (int)budget.ladder.size()) {
+        next = budget.level + 1;
+        budget.cooldown = DOWNGRADE_COOLDOWN;
+    } else if (budget.level > 0) {
+        double ratio = qualityCost(budget.ladder[budget.level - 1]) /
+            qualityCost(budget.ladder[budget.level]);
+        if (s.averageMs * ratio < budget.budgetMs * UPGRADE_HEADROOM) {
+            next = budget.level - 1;
+            budget.cooldown = UPGRADE_COOLDOWN;
+        }
+    }
+
+    if (next != budget.level) {
+        // 平均値を新しい品質での予測値に置き換えておき、切り替え直後の判断を安定させる
+        s.averageMs *= qualityCost(budget.ladder[next]) / qualityCost(budget.ladder[budget.level]);
+        budget.level = next;
+        s.qualityChanges++;
+    }
+}
+
+GradientVolume makeAnimationVolume() {
+    return makeGradientVolume(VOLUME_SIZE, VOLUME_SIZE, VOLUME_DEPTH, ANIMATION_SEED);
+}
+
+// 格子点 (i * step, j * step) ピクセルの位置で fBm を計算する
+// 時間方向の間引きが有効なら、高オクターブ成分は state.detail を模様の位置だけ更新して使う
+static void evaluateGrid(float* dst, int gridW, int gridH, int step, float z, int octaves,
+    const AnimationParams& params, const GradientVolume& volume, AnimationState& state) {
+
+    float inv = step / params.gridSize;
+    float norm = 1.0f / fbmAmplitudeSum(octaves);
+    int side = params.detailRefreshSide;
+    int fresh = std::max(params.freshOctaves, 1);
+
+    if (side <= 1 || fresh >= octaves) {
+        // 間引きなし：全オクターブを毎回計算
+        // この間 state.detail は更新されないので、間引きに戻ったときに古い値を使わないよう作り直させる
+        state.detailOctaves = 0;
+        parallelFor(gridH, params.threadCount, [&](int j) {
+            float* row = dst + (size_t)j * gridW;
+            for (int i = 0; i < gridW; i++) {
+                row[i] = fbm3Octaves(i * inv, j * inv, z, 0, octaves, volume) * norm;
+            }
+        });
+        return;
+    }
+
+    // 格子の大きさや条件が変わったら高オクターブ成分を全画素で作り直す
+    bool reset = state.detailWidth != gridW || state.detailHeight != gridH ||
+        state.detailStep != step || state.detailOctaves != octaves;
+    if (reset) {
+        state.detail.assign((size_t)gridW * gridH, 0.0f);
+        state.detailWidth = gridW;
+        state.detailHeight = gridH;
+        state.detailStep = step;
+        state.detailOctaves = octaves;
+    }
+
+    // 今回更新する模様の位置（side×side のうち1か所を順番に回す）
+    state.phase = (state.phase + 1) % (side * side);
+    int phaseX = state.phase % side;
+    int phaseY = state.phase / side;
+
+    parallelFor(gridH, params.threadCount, [&](int j) {
+        float* row = dst + (size_t)j * gridW;
+        float* detail = state.detail.data() + (size_t)j * gridW;
+        float fy = j * inv;
+
+        if (reset) {
+            for (int i = 0; i < gridW; i++) {
+                detail[i] = fbm3Octaves(i * inv, fy, z, fresh, octaves - fresh, volume);
+            }
+        } else if (j % side == phaseY) {
+            for (int i = phaseX; i < gridW; i += side) {
+                detail[i] = fbm3Octaves(i * inv, fy, z, fresh, octaves - fresh, volume);
+            }
+        }
+
+        // 毎フレーム計算する低オクターブに、少し前の高オクターブ成分を重ねる
+        for (int i = 0; i < gridW; i++) {
+            row[i] = (fbm3Octaves(i * inv, fy, z, 0, fresh, volume) + detail[i]) * norm;
+        }
+    });
+}
+
+void renderAnimatedFrame(float* out, const AnimationParams& params, const GradientVolume& volume,
+    double seconds, const FrameQuality& quality, AnimationState& state) {
+
+    int width = params.width;
+    int height = params.height;
+    int step = std::max(quality.step, 1);
+    float z = (float)(seconds * params.timeScale);
+
+    if (step == 1) {
+        // 全ピクセルを直接計算
+        evaluateGrid(out, width, height, 1, z, quality.octaves, params, volume, state);
+        return;
+    }
+
+    // step ピクセルおきの粗い格子で計算する（右端・下端を覆うよう1つ余分に取る）
+    int coarseW = (width - 1) / step + 2;
+    int coarseH = (height - 1) / step + 2;
+    state.coarse.resize((size_t)coarseW * coarseH);
+    evaluateGrid(state.coarse.data(), coarseW, coarseH, step, z, quality.octaves, params, volume, state);
+
+    // 粗い格子を双線形補間で元の解像度に広げる
+    float invStep = 1.0f / step;
+    parallelFor(height, params.threadCount, [&](int y) {
+        int j = y / step;
+        float ty = (y - j * step) * invStep;
+        const float* top = state.coarse.data() + (size_t)j * coarseW;
+        const float* bottom = top + coarseW;
+        float* row = out + (size_t)y * width;
+
+        // 粗い格子のセルごとに、まず縦方向を補間してから横に step ピクセル分広げる
+        for (int i = 0, x = 0; x < width; i++) {
+            float left = lerp(top[i], bottom[i], ty);
+            float right = lerp(top[i + 1], bottom[i + 1], ty);
+            int end = std::min(x + step, width);
+            for (int k = 0; x < end; k++, x++) {
+                row[x] = lerp(left, right, k * invStep);
+            }
+        }
+    });
+}
+
+FrameStats runHeadlessAnimation(const AnimationParams& params, double budgetMs, int frames,
+    double fps, FrameQuality* finalQuality) {
+
+    GradientVolume volume = makeAnimationVolume();
+    FrameBudget budget = makeFrameBudget(budgetMs, params.maxOctaves);
+    std::vector<float> frame((size_t)params.width * params.height);
+    AnimationState state;
+
+    for (int f = 0; f < frames; f++) {
+        auto start = std::chrono::steady_clock::now();
+        renderAnimatedFrame(frame.data(), params, volume, f / fps, currentQuality(budget), state);
+        auto end = std::chrono::steady_clock::now();
+        recordFrameTime(budget, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    if (finalQuality) *finalQuality = currentQuality(budget);
+    return budget.stats;
+}
+
+TemporalRunStats compareTemporalAnimation(const AnimationParams& params, int octaves, int frames,
+    double fps) {
+
+    TemporalRunStats result;
+    GradientVolume volume = makeAnimationVolume();
+    size_t pixels = (size_t)params.width * params.height;
+    std::vector<float> full(pixels), temporal(pixels);
+
+    AnimationParams fullParams = params;
+    fullParams.detailRefreshSide = 1;
+    AnimationState fullState, temporalState;
+    FrameQuality quality;
+    quality.octaves = octaves;
+
+    double errorSum = 0.0;
+    for (int f = 0; f < frames; f++) {
+        double seconds = f / fps;
+
+        auto t0 = std::chrono::steady_clock::now();
+        renderAnimatedFrame(full.data(), fullParams, volume, seconds, quality, fullState);
+        auto t1 = std::chrono::steady_clock::now();
+        renderAnimatedFrame(temporal.data(), params, volume, seconds, quality, temporalState);
+        auto t2 = std::chrono::steady_clock::now();
+
+        // 最初のフレームは全画素を計算するので時間の比較からは外す
+        if (f > 0) {
+            result.fullMs += std::chrono::duration<double, std::milli>(t1 - t0).count();
+            result.temporalMs += std::chrono::duration<double, std::milli>(t2 - t1).count();
+        }
+        for (size_t i = 0; i < pixels; i++) {
+            float e = std::fabs(full[i] - temporal[i]);
+            result.maxError = std::max(result.maxError, e);
+            errorSum += e;
+        }
+    }
+
+    result.frames = frames;
+    if (frames > 1) {
+        result.fullMs /= frames - 1;
+        result.temporalMs /= frames - 1;
+    }
+    if (frames > 0) result.meanError = (float)(errorSum / ((double)pixels * frames));
+    return result;
+}
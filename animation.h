@@ -0,0 +1,114 @@
+﻿// アニメーション表示用のノイズ生成
+// 時間を3軸目にした3Dノイズを毎フレーム生成し、フレーム時間の予算に収まるよう
+// 解像度とオクターブ数を自動で下げ上げする
+#pragma once
+
+#include <vector>   // ベクタ型を使用するため
+
+#include "perlin.h" // GradientVolume
+
+// アニメーションの設定
+struct AnimationParams {
+    int width = 1280;          // 出力の横幅（ピクセル）
+    int height = 720;          // 出力の高さ（ピクセル）
+    float gridSize = 32.0f;    // 基本オクターブのグリッド間隔（ピクセル）
+    float timeScale = 0.5f;    // 1秒あたりに進む時間軸の量（グリッド単位）
+    int maxOctaves = 4;        // 品質最高時のオクターブ数
+    int threadCount = 0;       // スレッド数（0 以下なら論理プロセッサ数）
+
+    // 時間方向の間引き（時間軸がゆっくり進むときは前のフレームとほとんど変わらないため）
+    // 1 なら毎フレームすべて計算する。N なら低オクターブだけ毎フレーム計算し、
+    // 高オクターブは N×N の模様で毎フレーム 1/(N×N) の画素だけ更新して、残りは前の値を使う
+    // 誤差は高オクターブ成分が最大 N×N−1 フレーム分古いことだけなので、timeScale が小さいほど小さい
+    int detailRefreshSide = 1;
+    int freshOctaves = 1;      // 毎フレーム全画素で計算する低オクターブの数
+};
+
+// 1フレームの品質（予算に応じて切り替える）
+struct FrameQuality {
+    int step = 1;     // 何ピクセルおきにノイズを計算するか（間は双線形補間で埋める）
+    int octaves = 1;  // 重ねるオクターブ数
+};
+
+// フレームをまたいで使い回す作業領域
+struct AnimationState {
+    std::vector<float> coarse;  // 粗い解像度で計算した値
+    std::vector<float> detail;  // 少しずつ更新する高オクターブ成分
+    int detailWidth = 0;        // detail の大きさと、作ったときの条件（変わったら作り直す）
+    int detailHeight = 0;
+    int detailStep = 0;
+    int detailOctaves = 0;      // 0 なら detail は無効（全オクターブを計算したフレームの後）
+    int phase = 0;              // 今回更新する模様の位置
+};
+
+// フレーム時間の統計
+struct FrameStats {
+    int frames = 0;          // 計測したフレーム数
+    double lastMs = 0.0;     // 直近フレームの生成時間
+    double averageMs = 0.0;  // 生成時間の移動平均
+    double minMs = 0.0;      // 最短
+    double maxMs = 0.0;      // 最長
+    int overBudget = 0;      // 予算を超えたフレーム数
+    int qualityChanges = 0;  // 品質を切り替えた回数
+};
+
+// フレーム時間予算に合わせて品質を調整する状態
+struct FrameBudget {
+    double budgetMs = 1000.0 / 60.0;   // 1フレームの生成に使ってよい時間
+    std::vector<FrameQuality> ladder;  // 品質の段階（先頭ほど高品質）
+    int level = 0;                     // 現在の段階（ladder の添字）
+    int cooldown = 0;                  // 次に品質を変えてよいまでのフレーム数
+    FrameStats stats;
+};
+
+// 品質の段階表を作って予算を初期化する
+// budgetMs: 1フレームの生成に使ってよい時間（ミリ秒）
+// maxOctaves: 品質最高時のオクターブ数
+FrameBudget makeFrameBudget(double budgetMs, int maxOctaves);
+
+// 現在の品質を返す
+FrameQuality currentQuality(const FrameBudget& budget);
+
+// 1フレームの生成時間を記録し、必要なら品質を1段階上げ下げする
+// budget: 更新する予算状態
+// generateMs: 今回のフレームの生成にかかった時間（ミリ秒）
+void recordFrameTime(FrameBudget& budget, double generateMs);
+
+// アニメーション用の3D勾配ベクトル配列を作る（時間方向は一定周期で繰り返す）
+GradientVolume makeAnimationVolume();
+
+// 1フレーム分のノイズを生成する
+// out: 出力先（params.width * params.height 要素、値は概ね -1.0〜1.0）
+// params: アニメーションの設定
+// volume: 3D勾配ベクトル配列
+// seconds: 経過時間（秒）
+// quality: このフレームの品質
+// state: フレームをまたいで使い回す作業領域（時間方向の間引きでは前フレームの値を保持する）
+void renderAnimatedFrame(float* out, const AnimationParams& params, const GradientVolume& volume,
+    double seconds, const FrameQuality& quality, AnimationState& state);
+
+// 画面を使わずにアニメーションを回し、予算制御の結果を返す（検証・計測用）
+// params: アニメーションの設定
+// budgetMs: 1フレームの生成予算（ミリ秒）
+// frames: 生成するフレーム数
+// fps: 想定する表示フレームレート（時間軸の進み方に使う）
+// finalQuality: 最後のフレームの品質を受け取る（nullptr 可）
+FrameStats runHeadlessAnimation(const AnimationParams& params, double budgetMs, int frames,
+    double fps = 60.0, FrameQuality* finalQuality = nullptr);
+
+// 時間方向の間引きの効果（間引きなしとの比較）
+struct TemporalRunStats {
+    int frames = 0;          // 比較したフレーム数
+    double fullMs = 0.0;     // 間引きなしの1フレームあたりの平均生成時間
+    double temporalMs = 0.0; // 間引きありの1フレームあたりの平均生成時間
+    float maxError = 0.0f;   // 全フレーム・全画素での誤差の最大値
+    float meanError = 0.0f;  // 誤差の絶対値の平均
+};
+
+// 間引きあり・なしで同じフレームを生成し、時間と誤差を比べる（検証・計測用）
+// params: アニメーションの設定（detailRefreshSide と freshOctaves が間引きの条件）
+// octaves: 重ねるオクターブ数
+// frames: 比較するフレーム数
+// fps: 想定する表示フレームレート（時間軸の進み方に使う）
+TemporalRunStats compareTemporalAnimation(const AnimationParams& params, int octaves, int frames,
+    double fps = 60.0);
@@ -0,0 +1,419 @@
+﻿#include "async_writer.h"
+
+#include <algorithm>  // std::max, std::min
+#include <cerrno>     // errno
+#include <cstring>    // memset
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>     // open
+#include <sys/uio.h>   // iovec
+#include <unistd.h>    // pwrite, close
+#endif
+
+// io_uring はカーネルのヘッダがあるときだけ組み込む（liburing は使わず、システムコールを直接呼ぶ）
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>     // mmap
+#include <sys/syscall.h>  // __NR_io_uring_setup, __NR_io_uring_enter
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define PERLIN_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+// ThreadPool の既定のスレッド数
+const int ASYNC_WRITE_DEFAULT_THREADS = 4;
+
+// 1つの書き込み
+struct AsyncWriteRequest {
+    uint64_t offset = 0;
+    std::vector<unsigned char> data;
+    size_t done = 0;  // 書き終えたバイト数（短い書き込みは残りを出し直す）
+#if !defined(_WIN32)
+    iovec iov;        // io_uring に渡す範囲（完了まで同じ場所に置いておく）
+#endif
+};
+
+#if defined(PERLIN_HAVE_IO_URING)
+
+// io_uring の投入リング・完了リングと、カーネルと共有するメモリ
+struct UringState {
+    int fd = -1;
+    void* sqRing = nullptr;
+    size_t sqRingSize = 0;
+    void* cqRing = nullptr;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned sqEntries = 0;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    ~UringState() {
+        if (sqes) munmap(sqes, sqesSize);
+        if (cqRing && cqRing != sqRing) munmap(cqRing, cqRingSize);
+        if (sqRing) munmap(sqRing, sqRingSize);
+        if (fd >= 0) ::close(fd);
+    }
+
+    // リングを作る（使えない環境なら false）
+    bool setup(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+        if (fd < 0) return false;
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) {
+            sqRing = nullptr;
+            return false;
+        }
+        if (single) {
+            cqRing = sqRing;
+        } else {
+            cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cqRing == MAP_FAILED) {
+                cqRing = nullptr;
+                return false;
+            }
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* s = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (s == MAP_FAILED) return false;
+        sqes = (io_uring_sqe*)s;
+
+        unsigned char* sq = (unsigned char*)sqRing;
+        sqHead = (unsigned*)(sq + params.sq_off.head);
+        sqTail = (unsigned*)(sq + params.sq_off.tail);
+        sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+        sqArray = (unsigned*)(sq + params.sq_off.array);
+        sqEntries = params.sq_entries;
+        unsigned char* cq = (unsigned char*)cqRing;
+        cqHead = (unsigned*)(cq + params.cq_off.head);
+        cqTail = (unsigned*)(cq + params.cq_off.tail);
+        cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+        cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    // 書き込みを投入リングに1つ積む（カーネルに渡すのは enter のとき）
+    void push(int file, AsyncWriteRequest* request) {
+        request->iov.iov_base = request->data.data() + request->done;
+        request->iov.iov_len = request->data.size() - request->done;
+
+        unsigned tail = *sqTail;
+        unsigned index = tail & *sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->fd = file;
+        sqe->addr = (uint64_t)(uintptr_t)&request->iov;
+        sqe->len = 1;
+        sqe->off = request->offset + request->done;
+        sqe->user_data = (uint64_t)(uintptr_t)request;
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    // 積んだ分をまとめて渡し、waitFor 個の完了を待つ
+    bool enter(unsigned submit, unsigned waitFor) {
+        for (;;) {
+            long result = syscall(__NR_io_uring_enter, fd, submit, waitFor,
+                waitFor > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (result >= 0) return true;
+            if (errno != EINTR) return false;
+        }
+    }
+};
+
+#else
+
+struct UringState {};
+
+#endif
+
+// request の残りをすべて offset の位置に書く（ThreadPool と Reversed で使う）
+static bool writeAt(intptr_t file, AsyncWriteRequest& request) {
+    bool ok = true;
+    while (ok && request.done < request.data.size()) {
+        const unsigned char* p = request.data.data() + request.done;
+        size_t remaining = request.data.size() - request.done;
+        uint64_t offset = request.offset + request.done;
+#if defined(_WIN32)
+        OVERLAPPED position;
+        std::memset(&position, 0, sizeof(position));
+        position.Offset = (DWORD)offset;
+        position.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD written = 0;
+        DWORD chunk = (DWORD)std::min(remaining, (size_t)0x40000000);
+        ok = WriteFile((HANDLE)file, p, chunk, &written, &position) != 0 && written > 0;
+        request.done += written;
+#else
+        ssize_t written = pwrite((int)file, p, remaining, (off_t)offset);
+        if (written < 0 && errno == EINTR) continue;
+        ok = written > 0;
+        if (ok) request.done += (size_t)written;
+#endif
+    }
+    return ok;
+}
+
+// UringState の定義はこのファイルにしか無いので、unique_ptr の破棄もここで行う
+AsyncFileWriter::AsyncFileWriter() {}
+
+AsyncFileWriter::~AsyncFileWriter() {
+    close();
+}
+
+bool AsyncFileWriter::open(const std::string& path, AsyncWriteBackend backend, int queueDepth, int threadCount) {
+    close();
+    this->queueDepth = std::max(1, queueDepth);
+    stopping = false;
+    failed = false;
+    outstanding = 0;
+    inFlight = 0;
+    counters = AsyncWriteStats();
+
+#if defined(_WIN32)
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+    file = (intptr_t)handle;
+#else
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    file = fd;
+#endif
+
+    if (backend == AsyncWriteBackend::Reversed) {
+        active = AsyncWriteBackend::Reversed;
+        return true;
+    }
+
+    active = AsyncWriteBackend::ThreadPool;
+#if defined(PERLIN_HAVE_IO_URING)
+    if (backend != AsyncWriteBackend::ThreadPool) {
+        std::unique_ptr<UringState> state(new UringState());
+        if (state->setup((unsigned)this->queueDepth)) {
+            uring = std::move(state);
+            active = AsyncWriteBackend::IoUring;
+        }
+    }
+#endif
+    if (backend == AsyncWriteBackend::IoUring && active != AsyncWriteBackend::IoUring) {
+        close();
+        return false;
+    }
+
+    if (active == AsyncWriteBackend::IoUring) {
+        threads.emplace_back(&AsyncFileWriter::uringLoop, this);
+    } else {
+        int n = threadCount > 0 ? threadCount : ASYNC_WRITE_DEFAULT_THREADS;
+        for (int i = 0; i < n; i++) threads.emplace_back(&AsyncFileWriter::threadLoop, this);
+    }
+    return true;
+}
+
+bool AsyncFileWriter::write(uint64_t offset, std::vector<unsigned char>&& data) {
+    std::unique_ptr<AsyncWriteRequest> request(new AsyncWriteRequest());
+    request->offset = offset;
+    request->data = std::move(data);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    // 受け付けた数が queueDepth に達していたら、どれかが終わるまで待つ（Reversed は flush まで溜める）
+    if (active != AsyncWriteBackend::Reversed) {
+        changed.wait(lock, [&]() { return failed || outstanding < queueDepth; });
+    }
+    if (failed || !isOpen()) return false;
+    pending.push_back(std::move(request));
+    outstanding++;
+    changed.notify_all();
+    return true;
+}
+
+std::vector<unsigned char> AsyncFileWriter::takeBuffer() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (freeBuffers.empty()) return std::vector<unsigned char>();
+    std::vector<unsigned char> buffer = std::move(freeBuffers.back());
+    freeBuffers.pop_back();
+    buffer.clear();
+    return buffer;
+}
+
+bool AsyncFileWriter::flush() {
+    if (active == AsyncWriteBackend::Reversed) {
+        // 溜めた書き込みを受け付けたのと逆の順に、呼び出し元のスレッドで書く
+        std::deque<std::unique_ptr<AsyncWriteRequest>> requests;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.swap(pending);
+        }
+        while (!requests.empty()) {
+            std::unique_ptr<AsyncWriteRequest> request = std::move(requests.back());
+            requests.pop_back();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                inFlight++;
+                counters.maxInFlight = std::max(counters.maxInFlight, inFlight);
+            }
+            bool ok = writeAt(file, *request);
+            complete(request.release(), ok);
+        }
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&]() { return outstanding == 0; });
+    return !failed;
+}
+
+bool AsyncFileWriter::close() {
+    if (!isOpen()) return true;
+    bool ok = flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    for (auto& th : threads) th.join();
+    threads.clear();
+    uring.reset();
+
+#if defined(_WIN32)
+    ok = CloseHandle((HANDLE)file) != 0 && ok;
+#else
+    ok = ::close((int)file) == 0 && ok;
+#endif
+    file = -1;
+    return ok;
+}
+
+AsyncWriteStats AsyncFileWriter::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+// 書き込みが終わった（または失敗した）ときの後始末。mutex を持たずに呼ぶ
+void AsyncFileWriter::complete(AsyncWriteRequest* request, bool ok) {
+    std::unique_ptr<AsyncWriteRequest> owned(request);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ok) {
+        counters.writes++;
+        counters.bytes += owned->data.size();
+    } else {
+        failed = true;
+    }
+    if (freeBuffers.size() < (size_t)queueDepth) freeBuffers.push_back(std::move(owned->data));
+    outstanding--;
+    inFlight--;
+    changed.notify_all();
+}
+
+// ThreadPool：待ち行列から1つずつ取り出して位置を指定して書く
+void AsyncFileWriter::threadLoop() {
+    for (;;) {
+        std::unique_ptr<AsyncWriteRequest> request;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() { return stopping || !pending.empty(); });
+            if (pending.empty()) return;
+            request = std::move(pending.front());
+            pending.pop_front();
+            inFlight++;
+            counters.maxInFlight = std::max(counters.maxInFlight, inFlight);
+        }
+
+        bool ok = writeAt(file, *request);
+        complete(request.release(), ok);
+    }
+}
+
+// IoUring：1つのスレッドがリングを持ち、待ち行列の書き込みを空いている分だけまとめて投入し、完了をまとめて受け取る
+void AsyncFileWriter::uringLoop() {
+#if defined(PERLIN_HAVE_IO_URING)
+    UringState& ring = *uring;
+    std::vector<AsyncWriteRequest*> resubmit;  // 途中までしか書けなかったもの
+    int submitted = 0;                         // カーネルに渡して完了を受け取っていない数
+
+    for (;;) {
+        std::vector<std::unique_ptr<AsyncWriteRequest>> batch;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() { return stopping || !pending.empty() || submitted > 0 || !resubmit.empty(); });
+            if (stopping && pending.empty() && submitted == 0 && resubmit.empty()) return;
+            int room = (int)ring.sqEntries - submitted - (int)resubmit.size();
+            while (room > 0 && !pending.empty()) {
+                batch.push_back(std::move(pending.front()));
+                pending.pop_front();
+                room--;
+            }
+            inFlight += (int)batch.size();
+            counters.maxInFlight = std::max(counters.maxInFlight, inFlight);
+        }
+
+        unsigned count = 0;
+        for (AsyncWriteRequest* request : resubmit) {
+            ring.push((int)file, request);
+            count++;
+        }
+        resubmit.clear();
+        for (auto& request : batch) {
+            ring.push((int)file, request.release());
+            count++;
+        }
+        submitted += (int)count;
+
+        // 投入と、少なくとも1つの完了の待ちを1回のシステムコールで行う
+        if (!ring.enter(count, submitted > 0 ? 1 : 0)) {
+            // リングが使えなくなった：投入した分の完了は当てにできないので、以後はすべて失敗にする
+            // （カーネルに渡したバッファは解放せずに残し、flush が待たないよう数だけ減らす）
+            std::unique_lock<std::mutex> lock(mutex);
+            failed = true;
+            outstanding -= submitted + (int)pending.size();
+            inFlight -= submitted;
+            pending.clear();
+            changed.notify_all();
+            changed.wait(lock, [&]() { return stopping; });
+            return;
+        }
+        if (count > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            counters.submissions++;
+        }
+
+        unsigned head = *ring.cqHead;
+        unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            io_uring_cqe* cqe = &ring.cqes[head & *ring.cqMask];
+            AsyncWriteRequest* request = (AsyncWriteRequest*)(uintptr_t)cqe->user_data;
+            int result = cqe->res;
+            submitted--;
+            if (result == -EINTR || result == -EAGAIN) {
+                resubmit.push_back(request);
+            } else if (result <= 0) {
+                complete(request, false);
+            } else {
+                request->done += (size_t)result;
+                if (request->done < request->data.size()) {
+                    resubmit.push_back(request);
+                } else {
+                    complete(request, true);
+                }
+            }
+        }
+        __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+    }
+#endif
+}
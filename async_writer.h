@@ -0,0 +1,94 @@
+﻿// 位置を指定した非同期のファイル書き込み（タイルの書き出し用）
+// 書き込みを待ち行列に積んで呼び出し元はすぐに戻り、裏で多数の書き込みを同時に進める
+// Linux では io_uring（まとめて投入し、完了もまとめて受け取る）を使い、使えなければ書き込み用のスレッドで pwrite する
+// （io_uring はカーネルや実行環境の設定で無効なことがあるので、開くときに試して駄目なら自動で切り替える）
+#pragma once
+
+#include <condition_variable>  // 待ち行列の待ち合わせ
+#include <cstddef>             // size_t
+#include <cstdint>             // uint64_t, intptr_t
+#include <deque>               // 待ち行列
+#include <memory>              // std::unique_ptr
+#include <mutex>               // 共有状態の保護
+#include <string>              // ファイル名
+#include <thread>              // 書き込みスレッド
+#include <vector>              // ベクタ型を使用するため
+
+struct AsyncWriteRequest; // 1つの書き込み（async_writer.cpp）
+struct UringState;        // io_uring のリング（async_writer.cpp）
+
+// 書き込みのしかた
+enum class AsyncWriteBackend {
+    Auto,        // io_uring が使えれば io_uring、駄目ならスレッド
+    IoUring,     // io_uring だけ（使えなければ open に失敗する）
+    ThreadPool,  // 書き込み用のスレッドで pwrite（Windows では位置指定の WriteFile）
+    Reversed,    // 検証用：flush / close まで溜めて、受け付けたのと逆の順に書く（書き込みの順に頼っていないかを確かめる）
+};
+
+// 書き込みの統計
+struct AsyncWriteStats {
+    uint64_t writes = 0;       // 完了した書き込みの数
+    uint64_t bytes = 0;        // 書いたバイト数
+    uint64_t submissions = 0;  // io_uring への投入の回数（1回で複数の書き込みをまとめて渡す）
+    int maxInFlight = 0;       // 同時に進めた書き込みの数の最大値
+};
+
+// 位置を指定した非同期の書き込み
+// write は複数スレッドから同時に呼んでよい（重ならない範囲に書くのは呼び出し側の責任）
+class AsyncFileWriter {
+public:
+    AsyncFileWriter();
+    ~AsyncFileWriter();
+    AsyncFileWriter(const AsyncFileWriter&) = delete;
+    AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+    // ファイルを作る（既にあれば空にする）
+    // queueDepth: 同時に扱う書き込みの数（待ち行列を含む。超えると write が空くまで待つ）
+    // threadCount: ThreadPool のときのスレッド数（0 以下なら 4）
+    bool open(const std::string& path, AsyncWriteBackend backend = AsyncWriteBackend::Auto,
+        int queueDepth = 64, int threadCount = 0);
+
+    // data を offset の位置に書く（data の中身は引き取る。完了を待たずに戻る）
+    // 戻り値: 受け付けたら true（それまでの書き込みが失敗していれば false）
+    bool write(uint64_t offset, std::vector<unsigned char>&& data);
+
+    // 書き込みが終わったバッファを再利用のために受け取る（無ければ空のベクタ）
+    std::vector<unsigned char> takeBuffer();
+
+    // それまでの書き込みがすべて終わるまで待つ
+    // 戻り値: すべて成功していれば true
+    bool flush();
+
+    // 書き込みを待ってからファイルを閉じる
+    // 戻り値: すべて成功していれば true
+    bool close();
+
+    bool isOpen() const { return file != -1; }
+
+    // 実際に使っている書き込みのしかた（IoUring か ThreadPool。Reversed を指定したときは Reversed）
+    AsyncWriteBackend backend() const { return active; }
+
+    AsyncWriteStats stats() const;
+
+private:
+    void uringLoop();
+    void threadLoop();
+    void complete(AsyncWriteRequest* request, bool ok);
+
+    intptr_t file = -1;  // POSIX はファイル記述子、Windows は HANDLE
+    AsyncWriteBackend active = AsyncWriteBackend::ThreadPool;
+    int queueDepth = 64;
+
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::unique_ptr<AsyncWriteRequest>> pending;  // 投入待ち
+    std::vector<std::vector<unsigned char>> freeBuffers;     // 書き終えたバッファ
+    int outstanding = 0;   // 受け付けてまだ完了していない書き込みの数
+    int inFlight = 0;      // 書き込み中（投入済み）の数
+    bool stopping = false;
+    bool failed = false;
+    AsyncWriteStats counters;
+
+    std::unique_ptr<UringState> uring;
+    std::vector<std::thread> threads;
+};
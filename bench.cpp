@@ -0,0 +1,784 @@
+﻿// ベンチマーク集（画面を使わない計測専用のプログラム）
+// 名前を指定するとそのベンチマークだけを、指定しなければすべてを順に実行する
+//   g++ -O2 -std=c++14 -pthread perlin.cpp animation.cpp lazy_gradients.cpp noise_kernels.cpp
+//       noise_simd.cpp noise_simd_sse2.cpp noise_simd_sse41.cpp noise_simd_avx2.cpp noise_simd_avx512.cpp
+//       stream_store.cpp tile_codec.cpp image_io.cpp tiff_writer.cpp async_writer.cpp bench.cpp -o perlin_bench
+//   ./perlin_bench startup --period 4096
+// Visual Studio のプロジェクトでは WinMain 側と重ならないようビルド対象から外している
+//
+// Linux でのリンク時最適化（LTO）: 上のコマンドに -flto=auto を加える
+// プロファイルに基づく最適化（PGO）: 全ベンチマークを学習用の実行に使う
+//   1. g++ -O2 -flto=auto -fprofile-generate=pgo ... -o perlin_bench   （計測用のビルド）
+//   2. ./perlin_bench                                                 （pgo/ にプロファイルが溜まる）
+//   3. g++ -O2 -flto=auto -fprofile-use=pgo -fprofile-partial-training ... -o perlin_bench
+// 同じ手順で perlin_cli も学習させられる（ソースを変えたら 1 からやり直す）
+// Visual Studio では Release 構成に /p:PerlinPgo=Instrument → 実行 → /p:PerlinPgo=Optimize を渡す
+#include <algorithm> // std::min
+#include <cmath>    // std::fabs
+#include <chrono>   // 経過時間の計測
+#include <cstdio>   // printf, remove
+#include <cstdlib>  // atoi
+#include <cstring>  // strcmp, strncmp
+#include <string>   // std::string
+#include <vector>   // ベクタ型を使用するため
+
+#include "perlin.h"          // パーリンノイズ本体
+#include "animation.h"       // アニメーションのフレーム生成
+#include "parallel.h"        // parallelFor
+#include "lazy_gradients.h"  // 遅延勾配配列
+#include "noise_kernels.h"   // 行単位のカーネル
+#include "noise_simd.h"      // SIMD ラッパーで書いたカーネル
+#include "stream_store.h"    // 非テンポラルストア
+#include "tile_codec.h"      // タイルの可逆圧縮
+#include "tiff_writer.h"     // タイル分割 TIFF
+
+#if defined(__linux__)
+#include <linux/perf_event.h> // ハードウェアの性能カウンタ
+#include <sys/ioctl.h>        // カウンタの開始・停止
+#include <sys/syscall.h>      // perf_event_open
+#include <unistd.h>           // read, close
+#endif
+
+#if defined(SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>       // 手書きの AVX2 版（比較用）
+#define BENCH_HAND_AVX2 1
+#endif
+
+// コマンドラインのオプション
+struct BenchOptions {
+    int argc;
+    char** argv;
+
+    // "--name value" 形式のオプションを探して値を返す（無ければ fallback）
+    int integer(const char* name, int fallback) const {
+        for (int i = 1; i + 1 < argc; i++) {
+            if (std::strcmp(argv[i], name) == 0) return std::atoi(argv[i + 1]);
+        }
+        return fallback;
+    }
+
+    // 文字列の値（無ければ fallback）
+    const char* text(const char* name, const char* fallback) const {
+        for (int i = 1; i + 1 < argc; i++) {
+            if (std::strcmp(argv[i], name) == 0) return argv[i + 1];
+        }
+        return fallback;
+    }
+};
+
+// 経過時間（ミリ秒）を測る
+class Stopwatch {
+public:
+    Stopwatch() : start(std::chrono::steady_clock::now()) {}
+    double elapsedMs() const {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+// ハードウェアの性能カウンタ（Linux の perf_event_open、自分のプロセスのユーザー空間だけを数える）
+// 使えない環境（仮想マシン、perf_event_paranoid が 3 以上など）では available() が false になる
+class PerfCounters {
+public:
+    // 数える事象
+    enum Event { Cycles, Instructions, L1dMisses, LlcMisses, EVENT_COUNT };
+
+    PerfCounters() {
+        for (int e = 0; e < EVENT_COUNT; e++) fds[e] = -1;
+#if defined(__linux__)
+        const uint32_t types[EVENT_COUNT] = {
+            PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE,
+        };
+        const uint64_t configs[EVENT_COUNT] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        };
+        for (int e = 0; e < EVENT_COUNT; e++) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = types[e];
+            attr.config = configs[e];
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fds[e] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+#endif
+    }
+    ~PerfCounters() {
+#if defined(__linux__)
+        for (int e = 0; e < EVENT_COUNT; e++) {
+            if (fds[e] >= 0) close(fds[e]);
+        }
+#endif
+    }
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available(Event e) const { return fds[e] >= 0; }
+
+    void start() {
+#if defined(__linux__)
+        for (int e = 0; e < EVENT_COUNT; e++) {
+            if (fds[e] < 0) continue;
+            ioctl(fds[e], PERF_EVENT_IOC_RESET, 0);
+            ioctl(fds[e], PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+    void stop() {
+#if defined(__linux__)
+        for (int e = 0; e < EVENT_COUNT; e++) {
+            if (fds[e] >= 0) ioctl(fds[e], PERF_EVENT_IOC_DISABLE, 0);
+        }
+#endif
+    }
+
+    // 直前の start〜stop の間の値（使えない事象は 0）
+    unsigned long long value(Event e) const {
+        unsigned long long v = 0;
+#if defined(__linux__)
+        if (fds[e] >= 0 && read(fds[e], &v, sizeof(v)) != (ssize_t)sizeof(v)) v = 0;
+#endif
+        return v;
+    }
+
+private:
+    int fds[EVENT_COUNT];
+};
+
+// startup: 起動から最初のタイルが出来るまでの時間（勾配配列を全部作る場合と、必要な範囲だけ作る場合）
+// 必要な範囲だけ作るのは TileDiskCache の土台（差で持ったタイルの読み込み）と同じやり方
+//   --period N    勾配配列の周期（既定 4096）
+//   --tile N      最初のタイルの一辺（既定 256）
+//   --repeat N    繰り返し回数（最短の時間を出す、既定 5）
+static void benchStartup(const BenchOptions& options) {
+    int period = options.integer("--period", 4096);
+    int tile = options.integer("--tile", 256);
+    int repeat = std::max(1, options.integer("--repeat", 5));
+    const unsigned seed = 123;
+    const int octaves = 4;
+    const float inv = 1.0f / 32.0f;
+
+    std::vector<float> pixels((size_t)tile * tile);
+    double eagerMs = 1e30;
+    double lazyMs = 1e30;
+    int chunks = 0;
+    int chunkCount = 0;
+
+    for (int r = 0; r < repeat; r++) {
+        Stopwatch eager;
+        GradientGrid grads = makeTileableGradients(period, seed);
+        for (int y = 0; y < tile; y++) {
+            for (int x = 0; x < tile; x++) {
+                pixels[(size_t)y * tile + x] = fbm2(x * inv, y * inv, octaves, period, grads);
+            }
+        }
+        eagerMs = std::min(eagerMs, eager.elapsedMs());
+
+        Stopwatch lazy;
+        LazyGradientTable table(period, seed);
+        for (int y = 0; y < tile; y++) {
+            for (int x = 0; x < tile; x++) {
+                pixels[(size_t)y * tile + x] = fbm2Lazy(x * inv, y * inv, octaves, table);
+            }
+        }
+        lazyMs = std::min(lazyMs, lazy.elapsedMs());
+        chunks = table.builtChunks();
+        chunkCount = table.chunkCount();
+    }
+
+    // 作り終えた後の速さ（チャンクの参照が毎回増える分の差）
+    const int width = 1280;
+    const int height = 720;
+    std::vector<float> frame((size_t)width * height);
+    GradientGrid grads = makeTileableGradients(period, seed);
+    LazyGradientTable table(period, seed);
+    auto renderEager = [&]() {
+        parallelFor(height, 0, [&](int y) {
+            for (int x = 0; x < width; x++) frame[(size_t)y * width + x] = fbm2(x * inv, y * inv, octaves, period, grads);
+        });
+    };
+    auto renderLazy = [&]() {
+        parallelFor(height, 0, [&](int y) {
+            for (int x = 0; x < width; x++) frame[(size_t)y * width + x] = fbm2Lazy(x * inv, y * inv, octaves, table);
+        });
+    };
+    renderLazy(); // チャンクを作り終えておく
+    double eagerFrameMs = 1e30;
+    double lazyFrameMs = 1e30;
+    for (int r = 0; r < repeat; r++) {
+        Stopwatch e;
+        renderEager();
+        eagerFrameMs = std::min(eagerFrameMs, e.elapsedMs());
+        Stopwatch l;
+        renderLazy();
+        lazyFrameMs = std::min(lazyFrameMs, l.elapsedMs());
+    }
+
+    std::printf("startup: period %d, first tile %dx%d, %d octaves\n", period, tile, tile, octaves);
+    std::printf("  first tile    eager %.3f ms, lazy %.3f ms (%d of %d chunks built)\n",
+        eagerMs, lazyMs, chunks, chunkCount);
+    std::printf("  warm frame    eager %.3f ms, lazy %.3f ms (%dx%d)\n", eagerFrameMs, lazyFrameMs, width, height);
+}
+
+// kernel: 1スレッドで perlinTiled を評価する速さ（関数呼び出しと補間の演算そのもの）
+//   --size N      評価する正方形の一辺（既定 1024）
+//   --repeat N    繰り返し回数（最短の時間を出す、既定 5）
+static void benchKernel(const BenchOptions& options) {
+    int size = options.integer("--size", 1024);
+    int repeat = std::max(1, options.integer("--repeat", 5));
+    const int period = 256;
+    const float inv = 1.0f / 32.0f;
+
+    GradientGrid grads = makeTileableGradients(period, 123);
+    std::vector<float> pixels((size_t)size * size);
+    double bestMs = 1e30;
+    for (int r = 0; r < repeat; r++) {
+        Stopwatch watch;
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                pixels[(size_t)y * size + x] = perlinTiled(x * inv, y * inv, period, grads);
+            }
+        }
+        bestMs = std::min(bestMs, watch.elapsedMs());
+    }
+
+    double mpix = (double)size * size / (bestMs * 1000.0);
+    std::printf("kernel: %dx%d perlinTiled, 1 thread\n", size, size);
+    std::printf("  best          %.3f ms (%.1f Mpixel/s)\n", bestMs, mpix);
+}
+
+// frame: アニメーションの1フレーム（3D fBm、全スレッド、品質最高）を作る時間
+//   --width W  --height H  --octaves N  --frames N  --threads N
+static void benchFrame(const BenchOptions& options) {
+    AnimationParams params;
+    params.width = options.integer("--width", params.width);
+    params.height = options.integer("--height", params.height);
+    params.threadCount = options.integer("--threads", params.threadCount);
+    FrameQuality quality;
+    quality.step = 1;
+    quality.octaves = options.integer("--octaves", params.maxOctaves);
+    int frames = std::max(1, options.integer("--frames", 30));
+
+    GradientVolume volume = makeAnimationVolume();
+    AnimationState state;
+    std::vector<float> pixels((size_t)params.width * params.height);
+    double totalMs = 0.0;
+    double bestMs = 1e30;
+    for (int f = 0; f < frames; f++) {
+        Stopwatch watch;
+        renderAnimatedFrame(pixels.data(), params, volume, f / 60.0, quality, state);
+        double ms = watch.elapsedMs();
+        totalMs += ms;
+        bestMs = std::min(bestMs, ms);
+    }
+
+    std::printf("frame: %dx%d, %d octaves, %d frames\n", params.width, params.height, quality.octaves, frames);
+    std::printf("  average       %.3f ms (best %.3f ms)\n", totalMs / frames, bestMs);
+}
+
+// clones: 行単位カーネルの命令セット別の版（target_clones）と、既定の版・1点ずつの評価との比較
+//   --size N  --octaves N  --repeat N
+static void benchClones(const BenchOptions& options) {
+    int size = options.integer("--size", 1024);
+    int octaves = options.integer("--octaves", 4);
+    int repeat = std::max(1, options.integer("--repeat", 5));
+    const int period = 256;
+    const float scale = 1.0f / 32.0f;
+
+    std::vector<float> flat = flattenGradients(makeTileableGradients(period, 123));
+    GradientTableView table;
+    table.period = period;
+    table.data = flat.data();
+
+    std::vector<float> reference((size_t)size * size);
+    std::vector<float> pixels((size_t)size * size);
+
+    // 1点ずつ fbm2Table を呼ぶ（これまでの書き方）
+    double pointMs = 1e30;
+    for (int r = 0; r < repeat; r++) {
+        Stopwatch watch;
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                reference[(size_t)y * size + x] = fbm2Table(x * scale, y * scale, octaves, table);
+            }
+        }
+        pointMs = std::min(pointMs, watch.elapsedMs());
+    }
+
+    // 行単位のカーネル
+    auto measure = [&](void (*kernel)(float*, int, int, int, float, int, const GradientTableView&), float& maxDiff) {
+        double best = 1e30;
+        for (int r = 0; r < repeat; r++) {
+            Stopwatch watch;
+            for (int y = 0; y < size; y++) kernel(pixels.data() + (size_t)y * size, size, 0, y, scale, octaves, table);
+            best = std::min(best, watch.elapsedMs());
+        }
+        maxDiff = 0.0f;
+        for (size_t i = 0; i < pixels.size(); i++) maxDiff = std::max(maxDiff, std::fabs(pixels[i] - reference[i]));
+        return best;
+    };
+    float baselineDiff = 0.0f;
+    float clonesDiff = 0.0f;
+    double baselineMs = measure(fbm2RowBaseline, baselineDiff);
+    double clonesMs = measure(fbm2Row, clonesDiff);
+
+    double pixelsTotal = (double)size * size;
+    std::printf("clones: %dx%d, %d octaves, 1 thread (selected target: %s)\n",
+        size, size, octaves, selectedKernelTarget());
+    std::printf("  per point     %.3f ms (%.1f Mpixel/s)\n", pointMs, pixelsTotal / (pointMs * 1000.0));
+    std::printf("  row default   %.3f ms (%.1f Mpixel/s, max diff %g)\n",
+        baselineMs, pixelsTotal / (baselineMs * 1000.0), baselineDiff);
+    std::printf("  row clones    %.3f ms (%.1f Mpixel/s, max diff %g)\n",
+        clonesMs, pixelsTotal / (clonesMs * 1000.0), clonesDiff);
+}
+
+#if defined(BENCH_HAND_AVX2)
+// 比較用：noise_simd.h と同じ計算を AVX2 の組み込み関数で直接書いたもの
+__attribute__((target("avx2")))
+static void fbm2RowHandAvx2(float* out, int count, int px0, int py, float scale, int octaves,
+    const GradientTableView& table) {
+
+    const int vectorEnd = count - count % 8;
+    for (int i = 0; i < count; i++) out[i] = 0.0f;
+    const __m256 period = _mm256_set1_ps((float)table.period);
+    const __m256i limit = _mm256_set1_epi32(table.period);
+    const __m256i limitMinusOne = _mm256_set1_epi32(table.period - 1);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    float multiplier = 1.0f;
+    float amplitude = 1.0f;
+    for (int o = 0; o < octaves; o++) {
+        PerlinRowSetup r = makePerlinRowSetup(py, scale, multiplier, table);
+        const __m256 fy = _mm256_set1_ps(r.fy);
+        const __m256 fy1 = _mm256_sub_ps(fy, one);
+        const __m256 sy = _mm256_set1_ps(r.sy);
+        const __m256 vScale = _mm256_set1_ps(scale);
+        const __m256 vMultiplier = _mm256_set1_ps(multiplier);
+        const __m256 vAmplitude = _mm256_set1_ps(amplitude);
+        for (int i = 0; i < vectorEnd; i += 8) {
+            __m256 x = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(px0 + i), lanes));
+            x = _mm256_mul_ps(_mm256_mul_ps(x, vScale), vMultiplier);
+            x = _mm256_sub_ps(x, _mm256_mul_ps(_mm256_floor_ps(_mm256_div_ps(x, period)), period));
+            __m256i ix = _mm256_cvttps_epi32(x);
+            __m256 fx = _mm256_sub_ps(x, _mm256_cvtepi32_ps(ix));
+            ix = _mm256_sub_epi32(ix, _mm256_and_si256(_mm256_cmpgt_epi32(ix, limitMinusOne), limit));
+            __m256 fx1 = _mm256_sub_ps(fx, one);
+            __m256i g = _mm256_add_epi32(ix, ix);
+
+            __m256 n0 = _mm256_add_ps(_mm256_mul_ps(fx, _mm256_i32gather_ps(r.row0, g, 4)),
+                _mm256_mul_ps(fy, _mm256_i32gather_ps(r.row0 + 1, g, 4)));
+            __m256 n1 = _mm256_add_ps(_mm256_mul_ps(fx1, _mm256_i32gather_ps(r.row0 + 2, g, 4)),
+                _mm256_mul_ps(fy, _mm256_i32gather_ps(r.row0 + 3, g, 4)));
+            __m256 n2 = _mm256_add_ps(_mm256_mul_ps(fx, _mm256_i32gather_ps(r.row1, g, 4)),
+                _mm256_mul_ps(fy1, _mm256_i32gather_ps(r.row1 + 1, g, 4)));
+            __m256 n3 = _mm256_add_ps(_mm256_mul_ps(fx1, _mm256_i32gather_ps(r.row1 + 2, g, 4)),
+                _mm256_mul_ps(fy1, _mm256_i32gather_ps(r.row1 + 3, g, 4)));
+
+            __m256 sx = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(fx, fx), fx),
+                _mm256_add_ps(_mm256_mul_ps(fx, _mm256_sub_ps(_mm256_mul_ps(fx, _mm256_set1_ps(6.0f)),
+                    _mm256_set1_ps(15.0f))), _mm256_set1_ps(10.0f)));
+            __m256 top = _mm256_add_ps(n0, _mm256_mul_ps(sx, _mm256_sub_ps(n1, n0)));
+            __m256 bottom = _mm256_add_ps(n2, _mm256_mul_ps(sx, _mm256_sub_ps(n3, n2)));
+            __m256 value = _mm256_add_ps(top, _mm256_mul_ps(sy, _mm256_sub_ps(bottom, top)));
+            _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(vAmplitude, value)));
+        }
+        for (int i = vectorEnd; i < count; i++) {
+            out[i] += amplitude * perlinTable((px0 + i) * scale * multiplier, py * scale * multiplier, table);
+        }
+        multiplier *= 2.0f;
+        amplitude *= 0.5f;
+    }
+
+    if (octaves > 1) {
+        float inv = 1.0f / fbmAmplitudeSum(octaves);
+        for (int i = 0; i < count; i++) out[i] *= inv;
+    }
+}
+#endif
+
+// simd: SIMD ラッパーで1回だけ書いたカーネルの命令セット別の実体と、手書きの AVX2 版・target_clones 版の比較
+//   --size N  --octaves N  --repeat N
+static void benchSimd(const BenchOptions& options) {
+    int size = options.integer("--size", 1024);
+    int octaves = options.integer("--octaves", 4);
+    int repeat = std::max(1, options.integer("--repeat", 5));
+    const int period = 256;
+    const float scale = 1.0f / 32.0f;
+
+    std::vector<float> flat = flattenGradients(makeTileableGradients(period, 123));
+    GradientTableView table;
+    table.period = period;
+    table.data = flat.data();
+
+    std::vector<float> reference((size_t)size * size);
+    std::vector<float> pixels((size_t)size * size);
+    for (int y = 0; y < size; y++) fbm2RowBaseline(reference.data() + (size_t)y * size, size, 0, y, scale, octaves, table);
+
+    const char* selected = nullptr;
+    selectFbm2RowKernel(&selected);
+    std::printf("simd: %dx%d, %d octaves, 1 thread (portable selects %s)\n", size, size, octaves, selected);
+
+    auto run = [&](const char* name, Fbm2RowKernel kernel) {
+        double best = 1e30;
+        for (int r = 0; r < repeat; r++) {
+            Stopwatch watch;
+            for (int y = 0; y < size; y++) kernel(pixels.data() + (size_t)y * size, size, 0, y, scale, octaves, table);
+            best = std::min(best, watch.elapsedMs());
+        }
+        float maxDiff = 0.0f;
+        for (size_t i = 0; i < pixels.size(); i++) maxDiff = std::max(maxDiff, std::fabs(pixels[i] - reference[i]));
+        std::printf("  %-12s  %8.3f ms (%6.1f Mpixel/s, max diff %g)\n",
+            name, best, (double)size * size / (best * 1000.0), maxDiff);
+    };
+
+    run("scalar", fbm2RowScalar);
+#if defined(SIMD_X86)
+    Fbm2RowKernel best = selectFbm2RowKernel();
+    run("sse2", fbm2RowSse2);
+    if (best != fbm2RowSse2) run("sse4.1", fbm2RowSse41);
+    if (best == fbm2RowAvx2 || best == fbm2RowAvx512) run("avx2", fbm2RowAvx2);
+#if defined(BENCH_HAND_AVX2)
+    if (best == fbm2RowAvx2 || best == fbm2RowAvx512) run("hand avx2", fbm2RowHandAvx2);
+#endif
+    if (best == fbm2RowAvx512) run("avx512f", fbm2RowAvx512);
+#endif
+    run("clones", fbm2Row);
+}
+
+// permute: 32 方向の固定勾配をハッシュで選ぶカーネルで、表引きを gather と vpermi2ps で比べる
+//   --size N  --octaves N  --repeat N
+static void benchPermute(const BenchOptions& options) {
+    int size = options.integer("--size", 1024);
+    int octaves = options.integer("--octaves", 4);
+    int repeat = std::max(1, options.integer("--repeat", 5));
+    const float scale = 1.0f / 32.0f;
+
+    HashedNoise noise;
+    noise.period = 256;
+    noise.seed = 123;
+
+    std::vector<float> reference((size_t)size * size);
+    std::vector<float> pixels((size_t)size * size);
+    for (int y = 0; y < size; y++) fbm2HashedRowScalar(reference.data() + (size_t)y * size, size, 0, y, scale, octaves, noise);
+
+    std::printf("permute: %dx%d, %d octaves, 1 thread\n", size, size, octaves);
+
+    auto run = [&](const char* name, Fbm2HashedRowKernel kernel) {
+        double best = 1e30;
+        for (int r = 0; r < repeat; r++) {
+            Stopwatch watch;
+            for (int y = 0; y < size; y++) kernel(pixels.data() + (size_t)y * size, size, 0, y, scale, octaves, noise);
+            best = std::min(best, watch.elapsedMs());
+        }
+        float maxDiff = 0.0f;
+        for (size_t i = 0; i < pixels.size(); i++) maxDiff = std::max(maxDiff, std::fabs(pixels[i] - reference[i]));
+        std::printf("  %-16s  %8.3f ms (%6.1f Mpixel/s, max diff %g)\n",
+            name, best, (double)size * size / (best * 1000.0), maxDiff);
+    };
+
+    run("scalar", fbm2HashedRowScalar);
+#if defined(SIMD_X86)
+    Fbm2RowKernel best = selectFbm2RowKernel();
+    if (best == fbm2RowAvx2 || best == fbm2RowAvx512) run("avx2 gather", fbm2HashedRowAvx2);
+    if (best == fbm2RowAvx512) {
+        run("avx512f gather", fbm2HashedRowAvx512Gather);
+        run("avx512f permute", fbm2HashedRowAvx512);
+    }
+#endif
+}
+
+// stream: LLC より大きな出力を全スレッドで埋めるときの、通常のストアと非テンポラルストアの比較
+// 1行ごとに fBm を計算する場合と、値を書くだけ（メモリ帯域だけで決まる）の場合を測る
+//   --width W  --height H  --octaves N  --threads N  --repeat N
+static void benchStream(const BenchOptions& options) {
+    int width = options.integer("--width", 4096);
+    int height = options.integer("--height", 4096);
+    int octaves = options.integer("--octaves", 2);
+    int threads = options.integer("--threads", 0);
+    int repeat = std::max(1, options.integer("--repeat", 3));
+    const int period = 256;
+    const float scale = 1.0f / 32.0f;
+
+    std::vector<float> flat = flattenGradients(makeTileableGradients(period, 123));
+    GradientTableView table;
+    table.period = period;
+    table.data = flat.data();
+
+    std::vector<float> pixels((size_t)width * height);
+    double bytes = (double)pixels.size() * sizeof(float);
+    StoreMode autoMode = resolveStoreMode(StoreMode::Auto, (size_t)bytes);
+    std::printf("stream: %dx%d (%.0f MiB), %d octaves, %d threads, LLC %.1f MiB (auto uses %s)\n",
+        width, height, bytes / (1 << 20), octaves, resolveThreadCount(threads),
+        (double)lastLevelCacheBytes() / (1 << 20), autoMode == StoreMode::Streaming ? "streaming" : "normal");
+
+    auto measure = [&](const char* name, StoreMode mode, bool generate) {
+        double best = 1e30;
+        for (int r = 0; r < repeat; r++) {
+            Stopwatch watch;
+            writeRows(pixels.data(), width, height, (size_t)width, threads, [&](float* row, int y) {
+                if (generate) {
+                    fbm2Row(row, width, 0, y, scale, octaves, table);
+                } else {
+                    for (int x = 0; x < width; x++) row[x] = (float)(x ^ y);
+                }
+            }, mode);
+            best = std::min(best, watch.elapsedMs());
+        }
+        std::printf("  %-18s  %8.3f ms (%7.1f Mpixel/s, %5.2f GB/s)\n",
+            name, best, (double)width * height / (best * 1000.0), bytes / (best * 1e6));
+    };
+
+    measure("fill normal", StoreMode::Normal, false);
+    measure("fill streaming", StoreMode::Streaming, false);
+    measure("fbm normal", StoreMode::Normal, true);
+    measure("fbm streaming", StoreMode::Streaming, true);
+}
+
+// prefetch: 大きな勾配配列で矩形単位のカーネルを回し、先読みの距離ごとの時間と性能カウンタを比べる
+// 高いオクターブほど1ピクセル行ごとに新しい勾配の行へ進むので、先読みしないとその行の読み込みで待たされる
+// タイルの幅では1つの勾配の行から読むのが数キャッシュラインだけなので、ハードウェアの先読みが働きにくい
+// 既定は幅 64 のタイルを縦に並べた列
+//   --period N  --width W  --height H  --octaves N  --grid N  --repeat N  --distance N（指定すればその距離だけ）
+static void benchPrefetch(const BenchOptions& options) {
+    int period = options.integer("--period", 4096);
+    int width = options.integer("--width", 64);
+    int height = options.integer("--height", 8192);
+    int octaves = options.integer("--octaves", 4);
+    float scale = 1.0f / (float)std::max(1, options.integer("--grid", 4));
+    int repeat = std::max(1, options.integer("--repeat", 3));
+    int only = options.integer("--distance", -1);
+
+    std::vector<float> flat = flattenGradients(makeTileableGradients(period, 123));
+    GradientTableView table;
+    table.period = period;
+    table.data = flat.data();
+
+    const char* selected = nullptr;
+    Fbm2BlockKernel kernel = selectFbm2BlockKernel(&selected);
+    std::printf("prefetch: period %d (%.0f MiB table), %dx%d, grid %g, %d octaves, %s, 1 thread\n",
+        period, (double)flat.size() * sizeof(float) / (1 << 20), width, height, 1.0f / scale, octaves, selected);
+
+    PerfCounters counters;
+    if (!counters.available(PerfCounters::Cycles)) std::printf("  (performance counters unavailable)\n");
+
+    std::vector<float> pixels((size_t)width * height);
+    std::vector<float> reference;
+    const int distances[] = { 0, 1, 2, 4, 8, 16 };
+    for (int distance : distances) {
+        if (only >= 0 && distance != only && distance != 0) continue;
+        double best = 1e30;
+        unsigned long long values[PerfCounters::EVENT_COUNT] = {};
+        for (int r = 0; r < repeat; r++) {
+            // 毎回別の場所を読む（前回の実行でキャッシュに残った勾配を使わないように）
+            int py0 = (r + 1) * height * 3;
+            Stopwatch watch;
+            counters.start();
+            kernel(pixels.data(), width, height, (size_t)width, 0, py0, scale, octaves, table, distance);
+            counters.stop();
+            double ms = watch.elapsedMs();
+            if (ms < best) {
+                best = ms;
+                for (int e = 0; e < PerfCounters::EVENT_COUNT; e++) {
+                    values[e] = counters.value((PerfCounters::Event)e);
+                }
+            }
+        }
+
+        // 先読みで値が変わらないことを確かめる（最後の実行の場所で比べる）
+        if (distance == 0) reference = pixels;
+        float maxDiff = 0.0f;
+        for (size_t i = 0; i < pixels.size(); i++) maxDiff = std::max(maxDiff, std::fabs(pixels[i] - reference[i]));
+
+        std::printf("  distance %-3d  %8.3f ms (%6.1f Mpixel/s, max diff %g)", distance, best,
+            (double)width * height / (best * 1000.0), maxDiff);
+        if (counters.available(PerfCounters::Cycles)) {
+            double pixelCount = (double)width * height;
+            std::printf("  cycles/px %.1f  IPC %.2f  L1D miss/px %.3f  LLC miss/px %.4f",
+                values[PerfCounters::Cycles] / pixelCount,
+                values[PerfCounters::Cycles] ? (double)values[PerfCounters::Instructions] / values[PerfCounters::Cycles] : 0.0,
+                values[PerfCounters::L1dMisses] / pixelCount, values[PerfCounters::LlcMisses] / pixelCount);
+        }
+        std::printf("\n");
+    }
+}
+
+// codec: 高さマップのタイルの圧縮の比率と速さ（予測のしかたごと）
+// 地形に使う程度の設定（グリッド 128、6 オクターブ）と、細かい設定（グリッド 16、4 オクターブ）で測る
+//   --tile N  --tiles N（一辺のタイル数）  --repeat N
+static void benchCodec(const BenchOptions& options) {
+    int tile = options.integer("--tile", 256);
+    int tiles = options.integer("--tiles", 4);
+    int repeat = std::max(1, options.integer("--repeat", 3));
+    int size = tile * tiles;
+
+    std::vector<float> flat = flattenGradients(makeTileableGradients(256, 123));
+    GradientTableView table;
+    table.period = 256;
+    table.data = flat.data();
+
+    struct Terrain {
+        const char* name;
+        int grid;
+        int octaves;
+    };
+    const Terrain terrains[] = { { "terrain", 128, 6 }, { "detail", 16, 4 } };
+    const struct {
+        const char* name;
+        TilePredictor predictor;
+    } predictors[] = {
+        { "none", TilePredictor::None }, { "left", TilePredictor::Left }, { "median", TilePredictor::Median },
+    };
+
+    std::printf("codec: %d tiles of %dx%d, 1 thread\n", tiles * tiles, tile, tile);
+    std::vector<float> pixels((size_t)size * size);
+    std::vector<float> decoded((size_t)size * size);
+    std::vector<uint8_t> encoded;
+    double rawBytes = (double)pixels.size() * sizeof(float);
+    for (const Terrain& terrain : terrains) {
+        fbm2BlockPortable(pixels.data(), size, size, (size_t)size, 0, 0, 1.0f / terrain.grid, terrain.octaves, table);
+
+        for (const auto& p : predictors) {
+            double encodeMs = 1e30;
+            double decodeMs = 1e30;
+            bool lossless = true;
+            for (int r = 0; r < repeat; r++) {
+                encoded.clear();
+                std::vector<size_t> offsets;
+                Stopwatch encodeWatch;
+                for (int t = 0; t < tiles * tiles; t++) {
+                    offsets.push_back(encoded.size());
+                    const float* src = pixels.data() + (size_t)(t / tiles) * tile * size + (size_t)(t % tiles) * tile;
+                    encodeTile(src, tile, tile, (size_t)size, p.predictor, encoded);
+                }
+                encodeMs = std::min(encodeMs, encodeWatch.elapsedMs());
+                offsets.push_back(encoded.size());
+
+                Stopwatch decodeWatch;
+                for (int t = 0; t < tiles * tiles; t++) {
+                    float* dst = decoded.data() + (size_t)(t / tiles) * tile * size + (size_t)(t % tiles) * tile;
+                    lossless &= decodeTile(encoded.data() + offsets[t], offsets[t + 1] - offsets[t], tile, tile,
+                        p.predictor, dst, (size_t)size);
+                }
+                decodeMs = std::min(decodeMs, decodeWatch.elapsedMs());
+            }
+            lossless &= std::memcmp(pixels.data(), decoded.data(), pixels.size() * sizeof(float)) == 0;
+
+            std::printf("  %-8s %-7s  ratio %.3f  encode %5.2f GB/s  decode %5.2f GB/s  %s\n",
+                terrain.name, p.name, rawBytes / encoded.size(), rawBytes / (encodeMs * 1e6),
+                rawBytes / (decodeMs * 1e6), lossless ? "lossless" : "MISMATCH");
+        }
+    }
+}
+
+// tiffwrite: タイル分割 TIFF を複数スレッドから書くときの速さ（ファイルへの書き込みのしかたごと）
+// queue 1 は書き込みを1つずつ待つ場合（従来の同期書き込みに近い）
+//   --tile N  --tiles N（一辺のタイル数）  --threads N  --queue N  --out FILE（既定 bench_tiles.tif、最後に消す）
+static void benchTiffWrite(const BenchOptions& options) {
+    int tile = options.integer("--tile", 256);
+    int tiles = options.integer("--tiles", 16);
+    int threads = options.integer("--threads", 0);
+    int queue = std::max(1, options.integer("--queue", 64));
+    std::string path = options.text("--out", "bench_tiles.tif");
+    int size = tile * tiles;
+
+    std::vector<float> flat = flattenGradients(makeTileableGradients(256, 123));
+    GradientTableView table;
+    table.period = 256;
+    table.data = flat.data();
+    std::vector<float> pixels((size_t)size * size);
+    fbm2BlockPortable(pixels.data(), size, size, (size_t)size, 0, 0, 1.0f / 128, 6, table);
+
+    const struct {
+        const char* name;
+        AsyncWriteBackend backend;
+        int queue;
+    } modes[] = {
+        { "threads q1", AsyncWriteBackend::ThreadPool, 1 },
+        { "threads", AsyncWriteBackend::ThreadPool, queue },
+        { "io_uring q1", AsyncWriteBackend::IoUring, 1 },
+        { "io_uring", AsyncWriteBackend::IoUring, queue },
+    };
+
+    std::printf("tiffwrite: %d tiles of %dx%d float, %d threads, queue %d\n", tiles * tiles, tile, tile,
+        resolveThreadCount(threads), queue);
+    for (const auto& m : modes) {
+        TiffOptions tiff;
+        tiff.tileSize = tile;
+        tiff.writeBackend = m.backend;
+        tiff.writeQueueDepth = m.queue;
+
+        TiledTiffWriter writer;
+        Stopwatch watch;
+        if (!writer.open(path, size, size, tiff)) {
+            std::printf("  %-12s unavailable\n", m.name);
+            continue;
+        }
+        bool ok = true;
+        parallelFor(tiles * tiles, threads, [&](int t) {
+            const float* src = pixels.data() + (size_t)(t / tiles) * tile * size + (size_t)(t % tiles) * tile;
+            if (!writer.writeTile(t % tiles, t / tiles, src, (size_t)size)) ok = false;
+        });
+        ok = writer.finish() && ok;
+        double ms = watch.elapsedMs();
+        AsyncWriteStats stats = writer.writeStats();
+        std::printf("  %-12s %8.2f ms  %7.1f MB/s  writes %llu  submissions %llu  max in flight %d  %s\n",
+            m.name, ms, stats.bytes / (ms * 1e3), (unsigned long long)stats.writes,
+            (unsigned long long)stats.submissions, stats.maxInFlight, ok ? "ok" : "FAILED");
+    }
+    std::remove(path.c_str());
+}
+
+// ベンチマークの一覧
+struct Benchmark {
+    const char* name;
+    void (*run)(const BenchOptions& options);
+};
+
+static const Benchmark BENCHMARKS[] = {
+    { "startup", benchStartup },
+    { "kernel", benchKernel },
+    { "frame", benchFrame },
+    { "clones", benchClones },
+    { "simd", benchSimd },
+    { "permute", benchPermute },
+    { "stream", benchStream },
+    { "prefetch", benchPrefetch },
+    { "codec", benchCodec },
+    { "tiffwrite", benchTiffWrite },
+};
+
+int main(int argc, char** argv) {
+    BenchOptions options = { argc, argv };
+
+    // オプションでない引数はベンチマークの名前
+    std::vector<std::string> names;
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], "--", 2) == 0) {
+            i++; // 値を読み飛ばす
+            continue;
+        }
+        names.push_back(argv[i]);
+    }
+
+    int ran = 0;
+    for (const Benchmark& b : BENCHMARKS) {
+        if (!names.empty() && std::find(names.begin(), names.end(), b.name) == names.end()) continue;
+        b.run(options);
+        ran++;
+    }
+    if (ran == 0) {
+        std::printf("usage: perlin_bench [name...] [options]\nbenchmarks:");
+        for (const Benchmark& b : BENCHMARKS) std::printf(" %s", b.name);
+        std::printf("\n");
+        return 1;
+    }
+    return 0;
+}
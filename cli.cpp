@@ -0,0 +1,751 @@
+﻿// 画面を使わないコマンドライン版（検証・計測・バッチ処理用）
+// DxLib に依存しないので Linux でもそのままビルドできる
+//   g++ -O2 -std=c++14 -pthread perlin.cpp contour.cpp animation.cpp frame_pipeline.cpp
+//       image_io.cpp tiff_writer.cpp loop.cpp sequence.cpp noise_graph.cpp preset.cpp lazy_gradients.cpp
+//       noise_simd.cpp noise_simd_sse2.cpp noise_simd_sse41.cpp noise_simd_avx2.cpp noise_simd_avx512.cpp
+//       tile_codec.cpp tile_cache.cpp row_stream.cpp async_writer.cpp shm_ring.cpp cli.cpp -o perlin_cli
+// Visual Studio のプロジェクトでは WinMain 側と重ならないようビルド対象から外している
+#include <algorithm> // std::max
+#include <chrono>   // 経過時間の計測
+#include <cmath>    // std::fabs
+#include <cstdio>   // printf
+#include <cstdlib>  // atoi, atof
+#include <cstring>  // strcmp
+#include <string>   // std::string
+#include <vector>   // ベクタ型を使用するため
+
+#include "animation.h"       // アニメーション生成と予算制御
+#include "frame_pipeline.h"  // バックグラウンド生成
+#include "image_io.h"        // 画像の書き出し
+#include "loop.h"            // ループアニメーション
+#include "sequence.h"        // 連番書き出し
+#include "noise_graph.h"     // ノイズの合成グラフ
+#include "noise_expr.h"      // ノイズ式（式テンプレート）
+#include "preset.h"          // 生成器のプリセット
+#include "tile_cache.h"      // タイルのディスクキャッシュ
+#include "parallel.h"        // parallelFor
+#include "row_stream.h"      // 行単位のストリーム書き出し
+#include "shm_ring.h"        // 共有メモリのリング
+
+#if defined(_WIN32)
+#include <fcntl.h>  // _O_BINARY
+#include <io.h>     // _setmode
+#else
+#include <csignal>  // SIGPIPE
+#endif
+
+// 使い方を表示する
+static void printUsage() {
+    std::printf(
+        "usage: perlin_cli <command> [options]\n"
+        "\n"
+        "commands:\n"
+        "  animate   run the animated generator headless with a frame-time budget\n"
+        "            --frames N   --budget MS   --width W   --height H\n"
+        "            --octaves N  --threads N   --fps F\n"
+        "  pipeline  generate on a background thread and check the presenter never stalls\n"
+        "            --frames N   --budget MS   --present MS  --width W   --height H\n"
+        "            --octaves N  --threads N\n"
+        "  temporal  compare full regeneration with temporally decimated detail octaves\n"
+        "            --frames N   --fps F       --width W     --height H  --octaves N\n"
+        "            --fresh N    --side N      --threads N\n"
+        "  loop      write a seamlessly looping animation as numbered files\n"
+        "            --frames N   --radius R    --width W     --height H  --octaves N\n"
+        "            --threads N  --out PREFIX  --format F\n"
+        "  sequence  write the animation as numbered files, several frames in flight\n"
+        "            --frames N   --fps F       --width W     --height H  --octaves N\n"
+        "            --tile N     --threads N   --inflight N  --out PREFIX\n"
+        "            --format F   --compress 0|1  --io auto|uring|threads\n"
+        "  graph     render the sample terrain graph, with and without sharing\n"
+        "            --width W    --height H    --tile N      --threads N --out FILE.png\n"
+        "  expr      compare the expression template with the equivalent noise graph\n"
+        "            --width W    --height H    --tile N      --threads N\n"
+        "  preset    write a preset, or map one and compare it with a rebuild\n"
+        "            --save FILE  --seed N      --grid G      --octaves N --period N\n"
+        "            --load FILE  --width W     --height H\n"
+        "  cache     render the terrain graph through the compressed tile cache in DIR\n"
+        "            --dir DIR    --width W     --height H    --tile N    --threads N\n"
+        "            --predictor 0..2  --residual 0|1  --erode N  --talus T\n"
+        "            --seed N     --grid G      --octaves N   --period N  (residual base)\n"
+        "  stream    stream the terrain graph band by band to stdout or a file\n"
+        "            --width W    --height H    --band N      --threads N --inflight N\n"
+        "            --format pgm|pfm|raw       --out FILE\n"
+        "  serve     render the terrain graph into a shared-memory ring for consume\n"
+        "            --name NAME  --width W     --height H    --chunk N   --slots N\n"
+        "            --threads N  --timeout MS  --force 0|1  (replace a stale NAME)\n"
+        "  consume   read the chunks published by serve without copying them\n"
+        "            --name NAME  --timeout MS  --verify 0|1\n"
+        "\n"
+        "formats (--format F): pgm png pfm raw tiff tiff16\n");
+}
+
+// "--name value" 形式のオプションを探して値を返す（無ければ nullptr）
+static const char* findOption(int argc, char** argv, const char* name) {
+    for (int i = 2; i + 1 < argc; i++) {
+        if (std::strcmp(argv[i], name) == 0) return argv[i + 1];
+    }
+    return nullptr;
+}
+
+static int optionInt(int argc, char** argv, const char* name, int fallback) {
+    const char* v = findOption(argc, argv, name);
+    return v ? std::atoi(v) : fallback;
+}
+
+static double optionDouble(int argc, char** argv, const char* name, double fallback) {
+    const char* v = findOption(argc, argv, name);
+    return v ? std::atof(v) : fallback;
+}
+
+// animate: 予算制御付きのアニメーションを画面なしで回して統計を出す
+static int runAnimate(int argc, char** argv) {
+    AnimationParams params;
+    params.width = optionInt(argc, argv, "--width", params.width);
+    params.height = optionInt(argc, argv, "--height", params.height);
+    params.maxOctaves = optionInt(argc, argv, "--octaves", params.maxOctaves);
+    params.threadCount = optionInt(argc, argv, "--threads", params.threadCount);
+    int frames = optionInt(argc, argv, "--frames", 300);
+    double fps = optionDouble(argc, argv, "--fps", 60.0);
+    double budgetMs = optionDouble(argc, argv, "--budget", 1000.0 / fps);
+
+    FrameQuality quality;
+    FrameStats stats = runHeadlessAnimation(params, budgetMs, frames, fps, &quality);
+
+    std::printf("frames        %d\n", stats.frames);
+    std::printf("budget        %.3f ms\n", budgetMs);
+    std::printf("last          %.3f ms\n", stats.lastMs);
+    std::printf("average       %.3f ms\n", stats.averageMs);
+    std::printf("min / max     %.3f / %.3f ms\n", stats.minMs, stats.maxMs);
+    std::printf("over budget   %d\n", stats.overBudget);
+    std::printf("changes       %d\n", stats.qualityChanges);
+    std::printf("final quality step %d, octaves %d\n", quality.step, quality.octaves);
+    return 0;
+}
+
+// pipeline: 生成を別スレッドに任せ、表示側が止まらないことを確かめる
+static int runPipeline(int argc, char** argv) {
+    AnimationParams params;
+    params.width = optionInt(argc, argv, "--width", params.width);
+    params.height = optionInt(argc, argv, "--height", params.height);
+    params.maxOctaves = optionInt(argc, argv, "--octaves", params.maxOctaves);
+    params.threadCount = optionInt(argc, argv, "--threads", params.threadCount);
+    int frames = optionInt(argc, argv, "--frames", 300);
+    double presentMs = optionDouble(argc, argv, "--present", 1000.0 / 60.0);
+    double budgetMs = optionDouble(argc, argv, "--budget", presentMs);
+
+    PipelineRunStats stats = runHeadlessPipeline(params, budgetMs, frames, presentMs);
+
+    std::printf("presented     %d\n", stats.presented);
+    std::printf("fresh         %d\n", stats.fresh);
+    std::printf("produced      %lld\n", stats.produced);
+    std::printf("acquire max   %.3f ms\n", stats.acquireMaxMs);
+    std::printf("elapsed       %.3f ms\n", stats.elapsedMs);
+    return 0;
+}
+
+// temporal: 時間方向の間引きで生成時間と誤差がどう変わるかを調べる
+static int runTemporal(int argc, char** argv) {
+    AnimationParams params;
+    params.width = optionInt(argc, argv, "--width", params.width);
+    params.height = optionInt(argc, argv, "--height", params.height);
+    params.threadCount = optionInt(argc, argv, "--threads", params.threadCount);
+    params.detailRefreshSide = optionInt(argc, argv, "--side", 2);
+    params.freshOctaves = optionInt(argc, argv, "--fresh", params.freshOctaves);
+    int octaves = optionInt(argc, argv, "--octaves", params.maxOctaves);
+    int frames = optionInt(argc, argv, "--frames", 60);
+    double fps = optionDouble(argc, argv, "--fps", 60.0);
+
+    TemporalRunStats stats = compareTemporalAnimation(params, octaves, frames, fps);
+
+    std::printf("frames        %d\n", stats.frames);
+    std::printf("full          %.3f ms/frame\n", stats.fullMs);
+    std::printf("temporal      %.3f ms/frame\n", stats.temporalMs);
+    std::printf("speedup       %.2fx\n", stats.temporalMs > 0.0 ? stats.fullMs / stats.temporalMs : 0.0);
+    std::printf("max error     %.5f\n", stats.maxError);
+    std::printf("mean error    %.5f\n", stats.meanError);
+    return 0;
+}
+
+// "--format" オプションから書き出し形式を決める
+static ImageFormat optionFormat(int argc, char** argv, ImageFormat fallback) {
+    const char* v = findOption(argc, argv, "--format");
+    if (!v) return fallback;
+    if (std::strcmp(v, "raw") == 0) return ImageFormat::RawFloat;
+    if (std::strcmp(v, "png") == 0) return ImageFormat::PNG;
+    if (std::strcmp(v, "pfm") == 0) return ImageFormat::PFM;
+    if (std::strcmp(v, "tiff16") == 0) return ImageFormat::Tiff16;
+    if (std::strcmp(v, "tiff") == 0) return ImageFormat::TiffFloat;
+    return ImageFormat::PGM;
+}
+
+// loop: 継ぎ目なくループするアニメーションを連番ファイルに書き出す
+static int runLoop(int argc, char** argv) {
+    LoopParams params;
+    params.width = optionInt(argc, argv, "--width", params.width);
+    params.height = optionInt(argc, argv, "--height", params.height);
+    params.frames = optionInt(argc, argv, "--frames", params.frames);
+    params.radius = (float)optionDouble(argc, argv, "--radius", params.radius);
+    params.octaves = optionInt(argc, argv, "--octaves", params.octaves);
+    params.threadCount = optionInt(argc, argv, "--threads", params.threadCount);
+    const char* out = findOption(argc, argv, "--out");
+    ImageFormat format = optionFormat(argc, argv, ImageFormat::PGM);
+
+    if (!exportLoopSequence(params, out ? out : "loop_", format)) {
+        std::fprintf(stderr, "failed to write loop frames\n");
+        return 1;
+    }
+    std::printf("wrote %d frames\n", params.frames);
+    return 0;
+}
+
+// "--io" オプションからファイルへの書き込みのしかたを決める（auto / uring / threads）
+static AsyncWriteBackend optionWriteBackend(int argc, char** argv) {
+    const char* v = findOption(argc, argv, "--io");
+    if (!v) return AsyncWriteBackend::Auto;
+    if (std::strcmp(v, "uring") == 0) return AsyncWriteBackend::IoUring;
+    if (std::strcmp(v, "threads") == 0) return AsyncWriteBackend::ThreadPool;
+    return AsyncWriteBackend::Auto;
+}
+
+// sequence: 時間で変化するノイズを連番ファイルに書き出す
+static int runSequence(int argc, char** argv) {
+    SequenceParams sequence;
+    sequence.width = optionInt(argc, argv, "--width", sequence.width);
+    sequence.height = optionInt(argc, argv, "--height", sequence.height);
+    sequence.frames = optionInt(argc, argv, "--frames", sequence.frames);
+    sequence.tileSize = optionInt(argc, argv, "--tile", sequence.tileSize);
+    sequence.threadCount = optionInt(argc, argv, "--threads", sequence.threadCount);
+    sequence.maxFramesInFlight = optionInt(argc, argv, "--inflight", sequence.maxFramesInFlight);
+    const char* out = findOption(argc, argv, "--out");
+    if (out) sequence.prefix = out;
+    sequence.format = optionFormat(argc, argv, sequence.format);
+    sequence.compress = optionInt(argc, argv, "--compress", 0) != 0;
+    sequence.writeBackend = optionWriteBackend(argc, argv);
+    if (sequence.width <= 0 || sequence.height <= 0) {
+        std::fprintf(stderr, "sequence needs --width and --height > 0\n");
+        return 1;
+    }
+
+    AnimationParams animation;
+    int octaves = optionInt(argc, argv, "--octaves", animation.maxOctaves);
+    double fps = optionDouble(argc, argv, "--fps", 60.0);
+
+    SequenceStats stats = exportAnimationSequence(animation, fps, octaves, sequence);
+    if (!stats.ok) {
+        std::fprintf(stderr, "failed to write frame %d\n", stats.framesWritten);
+        return 1;
+    }
+    std::printf("frames        %d\n", stats.framesWritten);
+    std::printf("elapsed       %.3f ms (%.3f ms/frame)\n", stats.elapsedMs,
+        stats.framesWritten > 0 ? stats.elapsedMs / stats.framesWritten : 0.0);
+    std::printf("reorder max   %d\n", stats.maxReorderDepth);
+    return 0;
+}
+
+// 見本の地形グラフ（平地と、座標をゆがめた山地を低周波のノイズで切り替える）
+// 戻り値: 出力ノードの番号
+static int buildTerrainGraph(NoiseGraph& graph) {
+    int base = graph.perlin(1.0f / 128.0f, 5, 1);
+    int warpX = graph.perlin(1.0f / 256.0f, 2, 3);
+    int warpY = graph.perlin(1.0f / 256.0f, 2, 4);
+    int warped = graph.warp(base, warpX, warpY, 48.0f);
+
+    int detail = graph.perlin(1.0f / 32.0f, 3, 2);
+    int mountains = graph.clamp(graph.add(graph.scaleBias(warped, 1.6f, 0.2f),
+        graph.scaleBias(detail, 0.2f, 0.0f)), -1.0f, 1.0f);
+
+    // 平地は同じ設定のノイズを改めて作って組み立てる（追加時に上のノードとまとめられる）
+    int plainsDetail = graph.scaleBias(graph.perlin(1.0f / 32.0f, 3, 2), 0.05f, 0.0f);
+    int plains = graph.add(graph.scaleBias(graph.perlin(1.0f / 128.0f, 5, 1), 0.25f, -0.3f), plainsDetail);
+
+    int control = graph.perlin(1.0f / 512.0f, 1, 5);
+    return graph.select(control, plains, mountains, 0.0f, 0.1f);
+}
+
+// graph: 見本の地形グラフをタイルごとに評価して画像に書き出す
+// 共通部分を使い回した場合と使い回さない場合の時間も比べる
+static int runGraph(int argc, char** argv) {
+    int width = optionInt(argc, argv, "--width", 1280);
+    int height = optionInt(argc, argv, "--height", 720);
+    int tile = optionInt(argc, argv, "--tile", 64);
+    int threads = optionInt(argc, argv, "--threads", 0);
+    const char* out = findOption(argc, argv, "--out");
+
+    NoiseGraph graph;
+    int output = buildTerrainGraph(graph);
+
+    std::vector<float> pixels((size_t)width * height);
+    std::vector<float> unshared((size_t)width * height);
+    auto start = std::chrono::steady_clock::now();
+    graph.render(output, pixels.data(), width, height, tile, threads);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    graph.setSubexpressionSharing(false);
+    start = std::chrono::steady_clock::now();
+    graph.render(output, unshared.data(), width, height, tile, threads);
+    double unsharedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    graph.setSubexpressionSharing(true);
+
+    float maxDiff = 0.0f;
+    for (size_t i = 0; i < pixels.size(); i++) maxDiff = std::max(maxDiff, std::fabs(pixels[i] - unshared[i]));
+
+    NoiseGraphReport report = graph.report(output);
+    std::printf("nodes         %d (unique %d, shared %d)\n", report.nodes, report.uniqueNodes, report.sharedNodes);
+    std::printf("cost/pixel    %.0f -> %.0f (%.1f%% saved)\n", report.naiveCost, report.sharedCost,
+        report.naiveCost > 0.0 ? 100.0 * (1.0 - report.sharedCost / report.naiveCost) : 0.0);
+    std::printf("elapsed       %.3f ms (without sharing %.3f ms)\n", ms, unsharedMs);
+    std::printf("max diff      %g\n", maxDiff);
+    if (out && !writeImage(out, pixels.data(), width, height, ImageFormat::PNG)) {
+        std::fprintf(stderr, "failed to write %s\n", out);
+        return 1;
+    }
+    return 0;
+}
+
+// expr: 同じ式を式テンプレートと NoiseGraph で評価し、時間と差を比べる
+static int runExpr(int argc, char** argv) {
+    int width = optionInt(argc, argv, "--width", 1280);
+    int height = optionInt(argc, argv, "--height", 720);
+    int tile = optionInt(argc, argv, "--tile", 64);
+    int threads = optionInt(argc, argv, "--threads", 0);
+    const int period = 256;
+
+    // 式テンプレート版
+    std::vector<float> table1 = flattenGradients(makeTileableGradients(period, 1));
+    std::vector<float> table2 = flattenGradients(makeTileableGradients(period, 2));
+    GradientTableView v1, v2;
+    v1.period = period;
+    v1.data = table1.data();
+    v2.period = period;
+    v2.data = table2.data();
+    auto expression = fbm(perlinSource(v1, 1.0f / 128.0f), 5) * 0.5f +
+        fbm(perlinSource(v2, 1.0f / 32.0f), 3) * 0.25f + 0.1f;
+
+    // 同じ式の NoiseGraph 版
+    NoiseGraph graph;
+    int output = graph.add(graph.scaleBias(graph.perlin(1.0f / 128.0f, 5, 1), 0.5f, 0.0f),
+        graph.scaleBias(graph.perlin(1.0f / 32.0f, 3, 2), 0.25f, 0.1f));
+
+    std::vector<float> a((size_t)width * height), b((size_t)width * height);
+    auto t0 = std::chrono::steady_clock::now();
+    renderExpression(expression, a.data(), width, height, tile, threads);
+    auto t1 = std::chrono::steady_clock::now();
+    graph.render(output, b.data(), width, height, tile, threads);
+    auto t2 = std::chrono::steady_clock::now();
+
+    float maxDiff = 0.0f;
+    for (size_t i = 0; i < a.size(); i++) maxDiff = std::max(maxDiff, std::fabs(a[i] - b[i]));
+
+    std::printf("expression    %.3f ms\n", std::chrono::duration<double, std::milli>(t1 - t0).count());
+    std::printf("graph         %.3f ms\n", std::chrono::duration<double, std::milli>(t2 - t1).count());
+    std::printf("max diff      %g\n", maxDiff);
+    return 0;
+}
+
+// preset: プリセットを書き出す（--save）か、割り当てて起動時間と値を確かめる（--load）
+static int runPreset(int argc, char** argv) {
+    const char* save = findOption(argc, argv, "--save");
+    const char* load = findOption(argc, argv, "--load");
+    if (save) {
+        NoisePreset preset;
+        preset.seed = (unsigned)optionInt(argc, argv, "--seed", (int)preset.seed);
+        preset.gridSize = (float)optionDouble(argc, argv, "--grid", preset.gridSize);
+        preset.octaves = optionInt(argc, argv, "--octaves", preset.octaves);
+        preset.period = optionInt(argc, argv, "--period", 4096);
+        if (!savePreset(save, preset)) {
+            std::fprintf(stderr, "failed to write %s\n", save);
+            return 1;
+        }
+        return 0;
+    }
+    if (!load) {
+        std::fprintf(stderr, "preset needs --save FILE or --load FILE\n");
+        return 1;
+    }
+
+    int width = optionInt(argc, argv, "--width", 256);
+    int height = optionInt(argc, argv, "--height", 256);
+
+    // 割り当てて最初の1枚を作るまで
+    auto start = std::chrono::steady_clock::now();
+    MappedPreset mapped;
+    if (!mapped.open(load)) {
+        std::fprintf(stderr, "failed to map %s\n", load);
+        return 1;
+    }
+    std::vector<float> fromPreset((size_t)width * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) fromPreset[(size_t)y * width + x] = mapped.evaluate((float)x, (float)y);
+    }
+    double mappedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // 同じ設定を乱数から作り直して最初の1枚を作るまで
+    const NoisePreset& preset = mapped.settings();
+    start = std::chrono::steady_clock::now();
+    GradientGrid grads = makeTileableGradients(preset.period, preset.seed);
+    std::vector<float> rebuilt((size_t)width * height);
+    float inv = 1.0f / preset.gridSize;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            rebuilt[(size_t)y * width + x] = fbm2(x * inv, y * inv, preset.octaves, preset.period, grads);
+        }
+    }
+    double rebuiltMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    float maxDiff = 0.0f;
+    for (size_t i = 0; i < rebuilt.size(); i++) maxDiff = std::max(maxDiff, std::fabs(rebuilt[i] - fromPreset[i]));
+
+    std::printf("period        %d (seed %u, %d octaves)\n", preset.period, preset.seed, preset.octaves);
+    std::printf("first frame   %.3f ms mapped, %.3f ms rebuilt\n", mappedMs, rebuiltMs);
+    std::printf("max diff      %g\n", maxDiff);
+    return 0;
+}
+
+// 後処理の見本: タイルの中だけで行う簡単な熱侵食
+// 隣の一番低い画素との差が talus を超えていれば、超えた分の半分に rate を掛けた量を低い方へ移す
+static void erodeTile(float* values, int width, int height, size_t stride, int iterations, float talus, float rate) {
+    static const int DX[4] = { 1, -1, 0, 0 };
+    static const int DY[4] = { 0, 0, 1, -1 };
+    for (int i = 0; i < iterations; i++) {
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                float* here = values + (size_t)y * stride + x;
+                float* lowest = nullptr;
+                float drop = talus;
+                for (int d = 0; d < 4; d++) {
+                    int nx = x + DX[d];
+                    int ny = y + DY[d];
+                    if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+                    float* neighbor = values + (size_t)ny * stride + nx;
+                    if (*here - *neighbor > drop) {
+                        drop = *here - *neighbor;
+                        lowest = neighbor;
+                    }
+                }
+                if (!lowest) continue;
+                float moved = (drop - talus) * 0.5f * rate;
+                *here -= moved;
+                *lowest += moved;
+            }
+        }
+    }
+}
+
+// cache: 見本の地形グラフをタイルごとに、キャッシュにあれば読み込み、無ければ作って書き込む
+// 2回目以降は読み込むだけになるので、作り直す場合との時間と、圧縮後の大きさを比べられる
+// --residual 1 なら fBm の土台に侵食をかけた層を作り、土台の設定と土台との差だけを書き込む
+static int runCache(int argc, char** argv) {
+    const char* dir = findOption(argc, argv, "--dir");
+    int width = optionInt(argc, argv, "--width", 2048);
+    int height = optionInt(argc, argv, "--height", 2048);
+    int tile = optionInt(argc, argv, "--tile", 256);
+    int threads = optionInt(argc, argv, "--threads", 0);
+    int predictor = optionInt(argc, argv, "--predictor", (int)TilePredictor::Median);
+    bool residual = optionInt(argc, argv, "--residual", 0) != 0;
+    int erode = optionInt(argc, argv, "--erode", 8);
+    float talus = (float)optionDouble(argc, argv, "--talus", 0.012);
+    if (!dir || tile <= 0 || predictor < 0 || predictor > (int)TilePredictor::Median) {
+        std::fprintf(stderr, "cache needs --dir DIR (and --tile > 0, --predictor 0..2)\n");
+        return 1;
+    }
+
+    TileDiskCache cache;
+    if (!cache.open(dir, (TilePredictor)predictor)) {
+        std::fprintf(stderr, "failed to open %s\n", dir);
+        return 1;
+    }
+
+    NoisePreset basePreset;
+    basePreset.seed = (unsigned)optionInt(argc, argv, "--seed", 1);
+    basePreset.gridSize = (float)optionDouble(argc, argv, "--grid", 128.0);
+    basePreset.octaves = optionInt(argc, argv, "--octaves", 5);
+    basePreset.period = optionInt(argc, argv, "--period", 256);
+    if (residual && !cache.setBaseGenerator(basePreset)) {
+        std::fprintf(stderr, "invalid base generator settings\n");
+        return 1;
+    }
+
+    NoiseGraph graph;
+    int output = buildTerrainGraph(graph);
+
+    int tilesX = (width + tile - 1) / tile;
+    int tilesY = (height + tile - 1) / tile;
+    std::vector<float> pixels((size_t)width * height);
+    std::vector<size_t> storedBytes((size_t)tilesX * tilesY, 0);
+    std::vector<size_t> valueBytes((size_t)tilesX * tilesY, 0);
+    std::vector<char> hit((size_t)tilesX * tilesY, 0);
+    std::vector<char> failed((size_t)tilesX * tilesY, 0);
+
+    auto start = std::chrono::steady_clock::now();
+    parallelFor(tilesX * tilesY, threads, [&](int t) {
+        int tx = t % tilesX;
+        int ty = t / tilesX;
+        int x0 = tx * tile;
+        int y0 = ty * tile;
+        int w = std::min(tile, width - x0);
+        int h = std::min(tile, height - y0);
+        float* dst = pixels.data() + (size_t)y0 * width + x0;
+        if (cache.load(tx, ty, dst, w, h, (size_t)width)) {
+            hit[t] = 1;
+            return;
+        }
+        if (residual) {
+            cache.evaluateBase(x0, y0, w, h, dst, (size_t)width);
+            erodeTile(dst, w, h, (size_t)width, erode, talus, 0.5f);
+            storedBytes[t] = cache.storeResidual(tx, ty, x0, y0, dst, w, h, (size_t)width);
+
+            // 値そのもので持った場合の大きさ（比較用）
+            std::vector<uint8_t> payload;
+            valueBytes[t] = sizeof(TileFileHeader) + encodeTile(dst, w, h, (size_t)width, (TilePredictor)predictor, payload);
+        } else {
+            graph.evaluateTile(output, x0, y0, w, h, dst, (size_t)width);
+            storedBytes[t] = cache.store(tx, ty, dst, w, h, (size_t)width);
+        }
+        failed[t] = storedBytes[t] == 0;
+    });
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    int hits = 0;
+    int failures = 0;
+    size_t written = 0;
+    size_t asValues = 0;
+    for (size_t i = 0; i < hit.size(); i++) {
+        hits += hit[i];
+        failures += failed[i];
+        written += storedBytes[i];
+        asValues += valueBytes[i];
+    }
+    int misses = tilesX * tilesY - hits;
+    double rawBytes = (double)width * height * sizeof(float);
+
+    std::printf("tiles         %d (hit %d, miss %d)\n", tilesX * tilesY, hits, misses);
+    std::printf("elapsed       %.3f ms (%.1f Mpx/s)\n", ms, ms > 0.0 ? width * (double)height / (ms * 1e3) : 0.0);
+    if (misses > 0) {
+        std::printf("written       %.2f MiB (ratio %.3f over the missed tiles)\n", written / (1024.0 * 1024.0),
+            written > 0 ? rawBytes * misses / (tilesX * (double)tilesY) / written : 0.0);
+        if (residual) {
+            std::printf("as values     %.2f MiB (residual is %.1fx smaller)\n", asValues / (1024.0 * 1024.0),
+                written > 0 ? (double)asValues / written : 0.0);
+        }
+    }
+    if (failures > 0) {
+        std::fprintf(stderr, "failed to write %d tiles to %s\n", failures, dir);
+        return 1;
+    }
+    return 0;
+}
+
+// stream: 見本の地形グラフを数行ずつ作り、出来た順に標準出力（または --out のファイル）へ流す
+// 画像のデータが標準出力に出るので、報告は標準エラー出力に書く
+static int runStream(int argc, char** argv) {
+    RowStreamParams params;
+    params.width = optionInt(argc, argv, "--width", params.width);
+    params.height = optionInt(argc, argv, "--height", params.height);
+    params.bandRows = optionInt(argc, argv, "--band", params.bandRows);
+    params.threadCount = optionInt(argc, argv, "--threads", params.threadCount);
+    params.maxBandsInFlight = optionInt(argc, argv, "--inflight", params.maxBandsInFlight);
+    params.format = optionFormat(argc, argv, ImageFormat::PGM);
+    if (!isStreamableFormat(params.format)) {
+        std::fprintf(stderr, "stream supports --format pgm, pfm or raw\n");
+        return 1;
+    }
+
+    const char* path = findOption(argc, argv, "--out");
+    FILE* out = stdout;
+    if (path) {
+        out = std::fopen(path, "wb");
+        if (!out) {
+            std::fprintf(stderr, "failed to open %s\n", path);
+            return 1;
+        }
+    } else {
+#if defined(_WIN32)
+        _setmode(_fileno(stdout), _O_BINARY); // 改行の変換をさせない
+#endif
+    }
+#if !defined(_WIN32)
+    // 下流（head など）が先にパイプを閉じても落ちずに、書き込みの失敗（EPIPE）として止まる
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+    NoiseGraph graph;
+    int output = buildTerrainGraph(graph);
+    int width = params.width;
+    RowStreamStats stats = streamRows(out, params, [&](int y0, int count, float* rows) {
+        graph.evaluateTile(output, 0, y0, width, count, rows, (size_t)width);
+    });
+    if (path) std::fclose(out);
+
+    std::fprintf(stderr, "streamed      %.2f MiB in %.3f ms (first band after %.3f ms)\n",
+        stats.bytesWritten / (1024.0 * 1024.0), stats.elapsedMs, stats.firstBandMs);
+    if (stats.closed) {
+        std::fprintf(stderr, "output closed by the reader, stopped early\n");
+        return 1;
+    }
+    if (!stats.ok) {
+        std::fprintf(stderr, "failed to write the stream\n");
+        return 1;
+    }
+    return 0;
+}
+
+// serve: 見本の地形グラフをチャンクごとに共有メモリのリングの枠へ直接描き、別プロセスの consume に渡す
+// 読み込み側が開くのを待ってから始め、全部を読み終えるまで待って終わる
+static int runServe(int argc, char** argv) {
+    const char* name = findOption(argc, argv, "--name");
+    int width = optionInt(argc, argv, "--width", 4096);
+    int height = optionInt(argc, argv, "--height", 4096);
+    int chunk = optionInt(argc, argv, "--chunk", 256);
+    int slots = optionInt(argc, argv, "--slots", 8);
+    int threads = optionInt(argc, argv, "--threads", 0);
+    int timeout = optionInt(argc, argv, "--timeout", 10000);
+    bool force = optionInt(argc, argv, "--force", 0) != 0;
+    if (!name || chunk <= 0) {
+        std::fprintf(stderr, "serve needs --name NAME (and --chunk > 0)\n");
+        return 1;
+    }
+
+    ShmRingProducer ring;
+    if (!ring.create(name, slots, chunk, chunk, force)) {
+        if (ring.nameTaken()) {
+            std::fprintf(stderr, "shared memory %s already exists (another serve is running, "
+                "or one exited without cleaning up; --force 1 replaces it)\n", name);
+        } else {
+            std::fprintf(stderr, "failed to create shared memory %s\n", name);
+        }
+        return 1;
+    }
+    if (!ring.waitForConsumer(timeout)) {
+        std::fprintf(stderr, "no consumer attached to %s\n", name);
+        return 1;
+    }
+
+    NoiseGraph graph;
+    int output = buildTerrainGraph(graph);
+    int chunksX = (width + chunk - 1) / chunk;
+    int chunksY = (height + chunk - 1) / chunk;
+    int bandRows = 16;
+
+    auto start = std::chrono::steady_clock::now();
+    double waitMs = 0.0;
+    for (int c = 0; c < chunksX * chunksY; c++) {
+        int x0 = (c % chunksX) * chunk;
+        int y0 = (c / chunksX) * chunk;
+        int w = std::min(chunk, width - x0);
+        int h = std::min(chunk, height - y0);
+
+        auto waitStart = std::chrono::steady_clock::now();
+        float* slot = ring.acquire(timeout);
+        waitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+        if (!slot) {
+            std::fprintf(stderr, "consumer stopped reading %s\n", name);
+            return 1;
+        }
+
+        // 枠に直接描く（数行ずつ全スレッドで分ける）
+        size_t stride = ring.stride();
+        parallelFor((h + bandRows - 1) / bandRows, threads, [&](int band) {
+            int y = band * bandRows;
+            graph.evaluateTile(output, x0, y0 + y, w, std::min(bandRows, h - y), slot + (size_t)y * stride, stride);
+        });
+        ring.publish(x0, y0, w, h);
+    }
+    ring.finish();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    bool drained = ring.waitForDrain(timeout);
+
+    std::printf("chunks        %llu (%dx%d, %d slots)\n", (unsigned long long)ring.published(), chunk, chunk, slots);
+    std::printf("elapsed       %.3f ms (%.3f ms waiting for free slots)\n", ms, waitMs);
+    ring.close();
+    if (!drained) {
+        std::fprintf(stderr, "consumer did not read every chunk\n");
+        return 1;
+    }
+    return 0;
+}
+
+// consume: serve が共有メモリに書いたチャンクをコピーせずに読む
+// --verify 1 なら同じ地形グラフで作り直して一致を確かめる
+static int runConsume(int argc, char** argv) {
+    const char* name = findOption(argc, argv, "--name");
+    int timeout = optionInt(argc, argv, "--timeout", 10000);
+    bool verify = optionInt(argc, argv, "--verify", 0) != 0;
+    if (!name) {
+        std::fprintf(stderr, "consume needs --name NAME\n");
+        return 1;
+    }
+
+    ShmRingConsumer ring;
+    if (!ring.attach(name, timeout)) {
+        std::fprintf(stderr, "failed to attach to %s\n", name);
+        return 1;
+    }
+
+    NoiseGraph graph;
+    int output = buildTerrainGraph(graph);
+    std::vector<float> expected;
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t chunks = 0;
+    double pixels = 0.0;
+    double sum = 0.0;
+    float maxDiff = 0.0f;
+    bool ordered = true;
+    ShmChunk c;
+    while (ring.next(c, timeout)) {
+        ordered &= c.sequence == chunks;
+        for (int y = 0; y < c.height; y++) {
+            const float* row = c.values + (size_t)y * c.stride;
+            for (int x = 0; x < c.width; x++) sum += row[x];
+        }
+        if (verify) {
+            expected.resize((size_t)c.width * c.height);
+            graph.evaluateTile(output, c.x, c.y, c.width, c.height, expected.data(), (size_t)c.width);
+            for (int y = 0; y < c.height; y++) {
+                for (int x = 0; x < c.width; x++) {
+                    maxDiff = std::max(maxDiff, std::fabs(c.values[(size_t)y * c.stride + x] - expected[(size_t)y * c.width + x]));
+                }
+            }
+        }
+        pixels += (double)c.width * c.height;
+        chunks++;
+        ring.release();
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    bool complete = ring.finished();
+    ring.close();
+
+    std::printf("chunks        %llu (%.1f Mpx, mean %.5f)\n", (unsigned long long)chunks, pixels / 1e6,
+        pixels > 0.0 ? sum / pixels : 0.0);
+    std::printf("elapsed       %.3f ms\n", ms);
+    if (verify) std::printf("max diff      %g\n", maxDiff);
+    if (!complete || !ordered) {
+        std::fprintf(stderr, complete ? "chunks arrived out of order\n" : "timed out before the producer finished\n");
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage();
+        return 1;
+    }
+
+    std::string command = argv[1];
+    if (command == "animate") return runAnimate(argc, argv);
+    if (command == "pipeline") return runPipeline(argc, argv);
+    if (command == "temporal") return runTemporal(argc, argv);
+    if (command == "loop") return runLoop(argc, argv);
+    if (command == "sequence") return runSequence(argc, argv);
+    if (command == "graph") return runGraph(argc, argv);
+    if (command == "expr") return runExpr(argc, argv);
+    if (command == "preset") return runPreset(argc, argv);
+    if (command == "cache") return runCache(argc, argv);
+    if (command == "stream") return runStream(argc, argv);
+    if (command == "serve") return runServe(argc, argv);
+    if (command == "consume") return runConsume(argc, argv);
+
+    printUsage();
+    return 1;
+}
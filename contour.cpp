@@ -0,0 +1,224 @@
+﻿#include "contour.h"
+#include "parallel.h"
+
+#include <algorithm>      // std::min, std::reverse
+#include <cstdint>        // int64_t
+#include <unordered_map>  // 辺番号から線分を引く表
+
+namespace {
+
+// 辺番号
+// 横の辺 (x,y)-(x+1,y) は (y*width+x)*2、縦の辺 (x,y)-(x,y+1) は (y*width+x)*2+1
+// 辺ごとに交点の位置が1つに決まるので、隣のタイルとも同じ番号で線をつなげられる
+typedef int64_t EdgeId;
+
+// 辺番号の列（線分や、つなぎ途中の折れ線）
+struct EdgeChain {
+    std::vector<EdgeId> edges;
+    bool closed = false;
+};
+
+// セルの4辺（上・右・下・左）
+enum { EDGE_TOP = 0, EDGE_RIGHT = 1, EDGE_BOTTOM = 2, EDGE_LEFT = 3 };
+
+// ケース番号ごとの線分（辺の組、-1 は無し）
+// ケース番号 = 左上 | 右上<<1 | 右下<<2 | 左下<<3（各ビットは level 以上なら 1）
+// 5 と 10 は鞍点なので、セル中心の値で別途つなぎ方を決める
+const int SEGMENT_TABLE[16][4] = {
+    { -1, -1, -1, -1 },
+    { EDGE_LEFT, EDGE_TOP, -1, -1 },
+    { EDGE_TOP, EDGE_RIGHT, -1, -1 },
+    { EDGE_LEFT, EDGE_RIGHT, -1, -1 },
+    { EDGE_RIGHT, EDGE_BOTTOM, -1, -1 },
+    { EDGE_LEFT, EDGE_TOP, EDGE_RIGHT, EDGE_BOTTOM },
+    { EDGE_TOP, EDGE_BOTTOM, -1, -1 },
+    { EDGE_LEFT, EDGE_BOTTOM, -1, -1 },
+    { EDGE_BOTTOM, EDGE_LEFT, -1, -1 },
+    { EDGE_BOTTOM, EDGE_TOP, -1, -1 },
+    { EDGE_TOP, EDGE_RIGHT, EDGE_BOTTOM, EDGE_LEFT },
+    { EDGE_BOTTOM, EDGE_RIGHT, -1, -1 },
+    { EDGE_RIGHT, EDGE_LEFT, -1, -1 },
+    { EDGE_RIGHT, EDGE_TOP, -1, -1 },
+    { EDGE_TOP, EDGE_LEFT, -1, -1 },
+    { -1, -1, -1, -1 },
+};
+
+// セル (x,y) の辺を辺番号に変換する
+EdgeId cellEdge(int x, int y, int side, int width) {
+    switch (side) {
+    case EDGE_TOP:    return ((EdgeId)y * width + x) * 2;
+    case EDGE_RIGHT:  return ((EdgeId)y * width + x + 1) * 2 + 1;
+    case EDGE_BOTTOM: return ((EdgeId)(y + 1) * width + x) * 2;
+    default:          return ((EdgeId)y * width + x) * 2 + 1;
+    }
+}
+
+// 辺番号を交点の座標に変換する（辺の両端の値で線形補間）
+std::pair<float, float> edgePoint(EdgeId id, const float* heightmap, int width, float level) {
+    int cell = (int)(id / 2);
+    int x = cell % width;
+    int y = cell / width;
+    float a = heightmap[cell];
+    float b = (id & 1) ? heightmap[cell + width] : heightmap[cell + 1];
+    float t = (b != a) ? (level - a) / (b - a) : 0.5f;
+    if (id & 1) return { (float)x, y + t };
+    return { x + t, (float)y };
+}
+
+// 辺番号の列どうしを、端の辺番号が一致するところでつなぐ
+// 1つの辺に接する列は最大2本なので、端から順にたどれば一意につながる
+// pieces: つなぐ前の列（閉じた列はそのまま出力へ回る）
+// 戻り値: つないだ後の列
+std::vector<EdgeChain> chainPieces(const std::vector<EdgeChain>& pieces) {
+    std::vector<EdgeChain> result;
+
+    // 端の辺番号 → その辺を端に持つ列の番号
+    std::unordered_map<EdgeId, std::vector<int>> ends;
+    ends.reserve(pieces.size() * 2);
+    for (int i = 0; i < (int)pieces.size(); i++) {
+        if (pieces[i].closed) {
+            result.push_back(pieces[i]);
+            continue;
+        }
+        ends[pieces[i].edges.front()].push_back(i);
+        ends[pieces[i].edges.back()].push_back(i);
+    }
+
+    std::vector<char> used(pieces.size(), 0);
+
+    // start 番の列から順にたどって1本にまとめる
+    auto walk = [&](int start, bool reverseFirst) {
+        EdgeChain chain;
+        chain.edges = pieces[start].edges;
+        if (reverseFirst) std::reverse(chain.edges.begin(), chain.edges.end());
+        used[start] = 1;
+
+        int current = start;
+        for (;;) {
+            EdgeId tail = chain.edges.back();
+            if (chain.edges.size() > 2 && tail == chain.edges.front()) {
+                // 始点に戻ってきたので閉曲線
+                chain.edges.pop_back();
+                chain.closed = true;
+                break;
+            }
+            int next = -1;
+            for (int candidate : ends[tail]) {
+                if (candidate != current && !used[candidate]) { next = candidate; break; }
+            }
+            if (next < 0) break;
+
+            const std::vector<EdgeId>& e = pieces[next].edges;
+            if (e.front() == tail) {
+                chain.edges.insert(chain.edges.end(), e.begin() + 1, e.end());
+            } else {
+                chain.edges.insert(chain.edges.end(), e.rbegin() + 1, e.rend());
+            }
+            used[next] = 1;
+            current = next;
+        }
+        result.push_back(std::move(chain));
+    };
+
+    // まず端が空いている（相手がいない）列から始めて開いた線をたどる
+    for (int i = 0; i < (int)pieces.size(); i++) {
+        if (used[i] || pieces[i].closed) continue;
+        if (ends[pieces[i].edges.front()].size() == 1) walk(i, false);
+        else if (ends[pieces[i].edges.back()].size() == 1) walk(i, true);
+    }
+    // 残りはすべて閉曲線
+    for (int i = 0; i < (int)pieces.size(); i++) {
+        if (!used[i] && !pieces[i].closed) walk(i, false);
+    }
+    return result;
+}
+
+// 1タイル分のセルを処理して、タイル内でつないだ列を返す
+std::vector<EdgeChain> contourTile(const float* heightmap, int width,
+    int cx0, int cy0, int cx1, int cy1, float level) {
+
+    std::vector<EdgeChain> segments;
+    int cols = cx1 - cx0;
+
+    // 1行分のケース番号（上の行と下の行の判定を組み合わせる）
+    // 分岐のない単純なループなので、コンパイラの自動ベクトル化が効く
+    std::vector<unsigned char> upper(cols + 1), lower(cols + 1), cases(cols);
+
+    const float* row = heightmap + (size_t)cy0 * width + cx0;
+    for (int i = 0; i <= cols; i++) upper[i] = row[i] >= level;
+
+    for (int y = cy0; y < cy1; y++) {
+        const float* next = heightmap + (size_t)(y + 1) * width + cx0;
+        for (int i = 0; i <= cols; i++) lower[i] = next[i] >= level;
+        for (int i = 0; i < cols; i++) {
+            cases[i] = (unsigned char)(upper[i] | (upper[i + 1] << 1) |
+                (lower[i + 1] << 2) | (lower[i] << 3));
+        }
+
+        for (int i = 0; i < cols; i++) {
+            int c = cases[i];
+            if (c == 0 || c == 15) continue;
+            int x = cx0 + i;
+
+            const int* table = SEGMENT_TABLE[c];
+            if (c == 5 || c == 10) {
+                // 鞍点：セル中心の値が level 以上なら level 以上の角どうしが中心でつながるので、
+                // level 未満の角を切り離すつなぎ方（反転したケースの線分）に入れ替える
+                const float* p = heightmap + (size_t)y * width + x;
+                float center = (p[0] + p[1] + p[width] + p[width + 1]) * 0.25f;
+                if (center >= level) table = SEGMENT_TABLE[15 - c];
+            }
+            for (int s = 0; s < 4 && table[s] >= 0; s += 2) {
+                EdgeChain seg;
+                seg.edges.push_back(cellEdge(x, y, table[s], width));
+                seg.edges.push_back(cellEdge(x, y, table[s + 1], width));
+                segments.push_back(std::move(seg));
+            }
+        }
+        upper.swap(lower);
+    }
+    return chainPieces(segments);
+}
+
+} // namespace
+
+std::vector<ContourLine> extractContours(const float* heightmap, int width, int height,
+    float level, int tileSize, int threadCount) {
+
+    std::vector<ContourLine> lines;
+    int cellsW = width - 1;
+    int cellsH = height - 1;
+    if (cellsW <= 0 || cellsH <= 0) return lines;
+    if (tileSize <= 0) tileSize = 64;
+
+    int tilesX = (cellsW + tileSize - 1) / tileSize;
+    int tilesY = (cellsH + tileSize - 1) / tileSize;
+
+    // タイルごとに並列で線分を作り、タイル内でつないでおく
+    std::vector<std::vector<EdgeChain>> tileChains(tilesX * tilesY);
+    parallelFor(tilesX * tilesY, threadCount, [&](int t) {
+        int cx0 = (t % tilesX) * tileSize;
+        int cy0 = (t / tilesX) * tileSize;
+        int cx1 = std::min(cx0 + tileSize, cellsW);
+        int cy1 = std::min(cy0 + tileSize, cellsH);
+        tileChains[t] = contourTile(heightmap, width, cx0, cy0, cx1, cy1, level);
+    });
+
+    // タイル境界で切れた列をつなぎ直す
+    std::vector<EdgeChain> pieces;
+    for (auto& chains : tileChains) {
+        for (auto& c : chains) pieces.push_back(std::move(c));
+    }
+    std::vector<EdgeChain> chains = chainPieces(pieces);
+
+    // 辺番号を座標に変換する
+    lines.resize(chains.size());
+    parallelFor((int)chains.size(), threadCount, [&](int i) {
+        lines[i].closed = chains[i].closed;
+        lines[i].points.reserve(chains[i].edges.size());
+        for (EdgeId id : chains[i].edges) {
+            lines[i].points.push_back(edgePoint(id, heightmap, width, level));
+        }
+    });
+    return lines;
+}
@@ -0,0 +1,22 @@
+﻿// 等高線抽出（マーチングスクエア）
+// 高さマップをタイルに分けて並列に処理し、タイル境界で線をつなぎ直す
+#pragma once
+
+#include <utility>  // std::pair
+#include <vector>   // ベクタ型を使用するため
+
+// 1本の等高線（ピクセル座標の折れ線）
+struct ContourLine {
+    std::vector<std::pair<float, float>> points; // 頂点列 (x, y)
+    bool closed = false;                         // true なら始点と終点がつながった閉曲線
+};
+
+// 高さマップから指定した高さの等高線を取り出す
+// heightmap: 高さマップ（width * height 要素、行優先。generateHeightmap の出力をそのまま渡せる）
+// width, height: 高さマップのサイズ
+// level: 等高線を引く高さ
+// tileSize: 1タイルあたりのセル数（一辺）
+// threadCount: スレッド数（0 以下なら論理プロセッサ数）
+// 戻り値: 等高線の一覧（画像の端で切れる線は開いた折れ線になる）
+std::vector<ContourLine> extractContours(const float* heightmap, int width, int height,
+    float level, int tileSize = 64, int threadCount = 0);
@@ -0,0 +1,107 @@
+﻿#include "frame_pipeline.h"
+
+#include <algorithm>  // std::max
+#include <chrono>     // 経過時間の計測
+
+BackgroundRenderer::BackgroundRenderer(const AnimationParams& params, double budgetMs)
+    : params(params),
+      volume(makeAnimationVolume()),
+      budget(makeFrameBudget(budgetMs, params.maxOctaves)) {
+
+    for (FrameSlot& slot : slots) {
+        slot.pixels.assign((size_t)params.width * params.height, 0.0f);
+    }
+}
+
+BackgroundRenderer::~BackgroundRenderer() {
+    stop();
+}
+
+void BackgroundRenderer::start() {
+    if (running.exchange(true)) return;
+    worker = std::thread(&BackgroundRenderer::run, this);
+}
+
+void BackgroundRenderer::stop() {
+    if (!running.exchange(false)) return;
+    {
+        // 待機中の生成スレッドを起こす
+        std::lock_guard<std::mutex> lock(waitMutex);
+    }
+    consumed.notify_one();
+    worker.join();
+}
+
+bool BackgroundRenderer::acquire() {
+    // 新しいフレームが無ければ何もしない（ロック無しで確認）
+    if (!(readyState.load(std::memory_order_acquire) & FRESH_BIT)) return false;
+
+    // 表示し終えたバッファを受け渡し待ちに回し、新しいフレームを受け取る
+    int previous = readyState.exchange(frontIndex, std::memory_order_acq_rel);
+    frontIndex = previous & INDEX_MASK;
+
+    // 生成スレッドが受け取り待ちをしていれば再開させる
+    {
+        std::lock_guard<std::mutex> lock(waitMutex);
+    }
+    consumed.notify_one();
+    return true;
+}
+
+void BackgroundRenderer::run() {
+    auto startTime = std::chrono::steady_clock::now();
+    AnimationState state;
+    long long index = 0;
+
+    while (running.load()) {
+        FrameSlot& slot = slots[backIndex];
+
+        // 裏のバッファにフレームを生成（表示側はこのバッファに触らない）
+        auto generateStart = std::chrono::steady_clock::now();
+        slot.seconds = std::chrono::duration<double>(generateStart - startTime).count();
+        slot.quality = currentQuality(budget);
+        renderAnimatedFrame(slot.pixels.data(), params, volume, slot.seconds, slot.quality, state);
+        auto generateEnd = std::chrono::steady_clock::now();
+        recordFrameTime(budget, std::chrono::duration<double, std::milli>(generateEnd - generateStart).count());
+        slot.index = index++;
+        slot.stats = budget.stats;
+        produced++;
+
+        // 完成したフレームを受け渡し待ちと差し替える
+        int previous = readyState.exchange(backIndex | FRESH_BIT, std::memory_order_acq_rel);
+        backIndex = previous & INDEX_MASK;
+
+        // 表示側が受け取るまで待つ（それ以上先のフレームを作っても表示されない）
+        std::unique_lock<std::mutex> lock(waitMutex);
+        consumed.wait(lock, [&]() {
+            return !running.load() || !(readyState.load() & FRESH_BIT);
+        });
+    }
+}
+
+PipelineRunStats runHeadlessPipeline(const AnimationParams& params, double budgetMs,
+    int presentations, double presentMs) {
+
+    PipelineRunStats result;
+    BackgroundRenderer renderer(params, budgetMs);
+
+    auto start = std::chrono::steady_clock::now();
+    renderer.start();
+    for (int i = 0; i < presentations; i++) {
+        auto acquireStart = std::chrono::steady_clock::now();
+        if (renderer.acquire()) result.fresh++;
+        auto acquireEnd = std::chrono::steady_clock::now();
+        result.acquireMaxMs = std::max(result.acquireMaxMs,
+            std::chrono::duration<double, std::milli>(acquireEnd - acquireStart).count());
+
+        // 表示（転送・画面反映）の代わりに一定時間待つ
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(presentMs));
+        result.presented++;
+    }
+    renderer.stop();
+
+    result.produced = renderer.producedFrames();
+    result.elapsedMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,90 @@
+﻿// 表示と切り離したバックグラウンドでのフレーム生成
+// 表示側がフレーム N を見せている間に、生成スレッドがフレーム N+1 を別のバッファに作り、
+// 出来上がったらアトミックに差し替える
+#pragma once
+
+#include <atomic>              // バッファ番号の受け渡し
+#include <condition_variable>  // 生成スレッドの待機
+#include <mutex>               // 待機用
+#include <thread>              // 生成スレッド
+#include <vector>              // ベクタ型を使用するため
+
+#include "animation.h"  // アニメーション生成と予算制御
+
+// 生成済みの1フレーム
+struct FrameSlot {
+    std::vector<float> pixels;  // ノイズ値（width * height 要素）
+    long long index = -1;       // 何番目に生成したフレームか（未生成なら -1）
+    double seconds = 0.0;       // 生成に使った時刻（秒）
+    FrameQuality quality;       // 生成時の品質
+    FrameStats stats;           // 生成した時点の予算制御の統計
+};
+
+// 生成スレッドと表示側の間でフレームを受け渡す
+// バッファは3枚（表示中・生成中・受け渡し待ち）で、表示側はロックを取らずに差し替えられる
+// 生成スレッドは受け渡し待ちのフレームが受け取られるまで次のフレームに進まない
+class BackgroundRenderer {
+public:
+    // params: アニメーションの設定
+    // budgetMs: 1フレームの生成予算（ミリ秒）
+    BackgroundRenderer(const AnimationParams& params, double budgetMs);
+    ~BackgroundRenderer();
+
+    BackgroundRenderer(const BackgroundRenderer&) = delete;
+    BackgroundRenderer& operator=(const BackgroundRenderer&) = delete;
+
+    // 生成スレッドを開始・停止する
+    void start();
+    void stop();
+
+    // 新しいフレームが出来ていれば表示用バッファと差し替える（表示側から呼ぶ）
+    // 戻り値: 差し替えたら true（false なら前回のフレームをそのまま使う）
+    bool acquire();
+
+    // 表示用のフレーム（次に acquire を呼ぶまで内容は変わらない）
+    const FrameSlot& front() const { return slots[frontIndex]; }
+
+    // 生成スレッドが作ったフレームの総数
+    long long producedFrames() const { return produced.load(); }
+
+private:
+    // 生成スレッドの本体
+    void run();
+
+    // readyState の下位ビットがバッファ番号、FRESH_BIT が「まだ表示側が受け取っていない」印
+    static const int FRESH_BIT = 4;
+    static const int INDEX_MASK = 3;
+
+    AnimationParams params;
+    GradientVolume volume;
+    FrameBudget budget;
+
+    FrameSlot slots[3];
+    int frontIndex = 0;                // 表示側だけが触る
+    int backIndex = 1;                 // 生成スレッドだけが触る
+    std::atomic<int> readyState{ 2 };  // 受け渡し待ちのバッファ
+
+    std::atomic<bool> running{ false };
+    std::atomic<long long> produced{ 0 };
+    std::thread worker;
+
+    // 受け渡し待ちのフレームが受け取られるまで生成スレッドを待たせる
+    std::mutex waitMutex;
+    std::condition_variable consumed;
+};
+
+// 生成を別スレッドで回し、表示側は一定時間ごとにフレームを受け取るだけにして結果を返す（検証・計測用）
+struct PipelineRunStats {
+    int presented = 0;          // 表示側が表示したフレーム数
+    int fresh = 0;              // そのうち新しいフレームに差し替えられた数
+    long long produced = 0;     // 生成されたフレーム数
+    double acquireMaxMs = 0.0;  // acquire にかかった最長時間（表示側が止まった時間）
+    double elapsedMs = 0.0;     // 全体の経過時間
+};
+
+// params: アニメーションの設定
+// budgetMs: 1フレームの生成予算（ミリ秒）
+// presentations: 表示側のループ回数
+// presentMs: 表示側の1回あたりの処理時間（転送・表示の代わりに待つ）
+PipelineRunStats runHeadlessPipeline(const AnimationParams& params, double budgetMs,
+    int presentations, double presentMs);
@@ -0,0 +1,198 @@
+﻿#include "image_io.h"
+
+#include <algorithm> // std::min
+#include <array>    // CRC 表
+#include <cstdint>  // uint32_t
+#include <cstdio>   // snprintf
+#include <fstream>  // ファイル出力
+#include <vector>   // 1行分の変換バッファ
+
+#include "tiff_writer.h" // タイル分割 TIFF
+
+unsigned char noiseToGray(float n) {
+    n = (n + 1.0f) / 2.0f;     // -1〜1 → 0〜1
+    int gray = (int)(n * 255); // 0〜255
+    return (unsigned char)(gray < 0 ? 0 : (gray > 255 ? 255 : gray));
+}
+
+unsigned short noiseToGray16(float n) {
+    n = (n + 1.0f) / 2.0f;                // -1〜1 → 0〜1
+    int gray = (int)(n * 65535 + 0.5f);   // 0〜65535（四捨五入）
+    return (unsigned short)(gray < 0 ? 0 : (gray > 65535 ? 65535 : gray));
+}
+
+bool isTiffFormat(ImageFormat format) {
+    return format == ImageFormat::Tiff16 || format == ImageFormat::TiffFloat;
+}
+
+const char* imageExtension(ImageFormat format) {
+    switch (format) {
+    case ImageFormat::PGM: return "pgm";
+    case ImageFormat::PNG: return "png";
+    case ImageFormat::PFM: return "pfm";
+    case ImageFormat::Tiff16:
+    case ImageFormat::TiffFloat: return "tif";
+    default:               return "raw";
+    }
+}
+
+std::string numberedPath(const std::string& prefix, int index, ImageFormat format) {
+    char number[32];
+    std::snprintf(number, sizeof(number), "%04d.", index);
+    return prefix + number + imageExtension(format);
+}
+
+// PGM（P5）を書き出す
+static bool writePGM(std::ofstream& file, const float* values, int width, int height) {
+    file << "P5\n" << width << " " << height << "\n255\n";
+
+    std::vector<unsigned char> row(width);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            row[x] = noiseToGray(values[(size_t)y * width + x]);
+        }
+        file.write((const char*)row.data(), width);
+    }
+    return (bool)file;
+}
+
+// PFM（Pf、倍率 -1 はリトルエンディアン）を書き出す。行は下から順に並べる
+static bool writePFM(std::ofstream& file, const float* values, int width, int height) {
+    file << "Pf\n" << width << " " << height << "\n-1.0\n";
+    for (int y = height - 1; y >= 0; y--) {
+        file.write((const char*)(values + (size_t)y * width), (std::streamsize)sizeof(float) * width);
+    }
+    return (bool)file;
+}
+
+// CRC-32 の表（1バイト分ずつ）
+static std::array<uint32_t, 256> makeCrcTable() {
+    std::array<uint32_t, 256> table;
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        table[n] = c;
+    }
+    return table;
+}
+
+// PNG のチャンクに使う CRC-32（複数スレッドから同時に呼んでもよい）
+static uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0) {
+    static const std::array<uint32_t, 256> table = makeCrcTable();
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// 32bit 値をビッグエンディアンで追加する
+static void appendBE32(std::vector<unsigned char>& out, uint32_t v) {
+    out.push_back((unsigned char)(v >> 24));
+    out.push_back((unsigned char)(v >> 16));
+    out.push_back((unsigned char)(v >> 8));
+    out.push_back((unsigned char)v);
+}
+
+// PNG のチャンク（長さ・種類・データ・CRC）を書き出す
+static void writeChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data) {
+    std::vector<unsigned char> head;
+    appendBE32(head, (uint32_t)data.size());
+    head.insert(head.end(), type, type + 4);
+
+    uint32_t crc = crc32(head.data() + 4, 4);
+    crc = crc32(data.data(), data.size(), crc);
+    std::vector<unsigned char> tail;
+    appendBE32(tail, crc);
+
+    file.write((const char*)head.data(), head.size());
+    file.write((const char*)data.data(), data.size());
+    file.write((const char*)tail.data(), tail.size());
+}
+
+// PNG（8bit グレースケール）を書き出す
+// 画像データは deflate の無圧縮ブロックに入れる（書き出しを速くし、外部ライブラリを使わないため）
+static bool writePNG(std::ofstream& file, const float* values, int width, int height) {
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    file.write((const char*)signature, sizeof(signature));
+
+    std::vector<unsigned char> header;
+    appendBE32(header, (uint32_t)width);
+    appendBE32(header, (uint32_t)height);
+    header.push_back(8); // ビット深度
+    header.push_back(0); // グレースケール
+    header.push_back(0); // 圧縮方式
+    header.push_back(0); // フィルタ方式
+    header.push_back(0); // インターレース無し
+    writeChunk(file, "IHDR", header);
+
+    // 各行の先頭にフィルタ種別 0（無し）を付けた生データ
+    std::vector<unsigned char> raw((size_t)(width + 1) * height);
+    for (int y = 0; y < height; y++) {
+        unsigned char* row = raw.data() + (size_t)y * (width + 1);
+        row[0] = 0;
+        for (int x = 0; x < width; x++) {
+            row[x + 1] = noiseToGray(values[(size_t)y * width + x]);
+        }
+    }
+
+    // zlib ストリーム：ヘッダ、最大 65535 バイトずつの無圧縮ブロック、Adler-32
+    std::vector<unsigned char> zlib;
+    zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    size_t offset = 0;
+    do {
+        size_t size = std::min(raw.size() - offset, (size_t)65535);
+        bool last = offset + size == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back((unsigned char)size);
+        zlib.push_back((unsigned char)(size >> 8));
+        zlib.push_back((unsigned char)~size);
+        zlib.push_back((unsigned char)(~size >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+        offset += size;
+    } while (offset < raw.size());
+
+    // Adler-32（5552 バイトごとにまとめて剰余を取っても桁あふれしない）
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < raw.size(); ) {
+        size_t end = std::min(raw.size(), i + 5552);
+        for (; i < end; i++) {
+            a += raw[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    appendBE32(zlib, (b << 16) | a);
+    writeChunk(file, "IDAT", zlib);
+    writeChunk(file, "IEND", std::vector<unsigned char>());
+    return (bool)file;
+}
+
+bool writeImage(const std::string& path, const float* values, int width, int height, ImageFormat format,
+    const ImageOptions& options) {
+
+    if (isTiffFormat(format)) {
+        TiffOptions tiff;
+        tiff.sample = format == ImageFormat::Tiff16 ? TiffSampleFormat::UInt16 : TiffSampleFormat::Float32;
+        tiff.tileSize = options.tileSize;
+        tiff.compress = options.compress;
+        tiff.writeBackend = options.writeBackend;
+        return writeTiff(path, values, width, height, tiff);
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    switch (format) {
+    case ImageFormat::PGM:
+        return writePGM(file, values, width, height);
+    case ImageFormat::PNG:
+        return writePNG(file, values, width, height);
+    case ImageFormat::PFM:
+        return writePFM(file, values, width, height);
+    default:
+        file.write((const char*)values, (std::streamsize)sizeof(float) * width * height);
+        return (bool)file;
+    }
+}
@@ -0,0 +1,46 @@
+﻿// 画像ファイルの書き出し（ノイズ値の配列をそのままファイルにする）
+#pragma once
+
+#include <string>   // ファイル名
+
+#include "async_writer.h" // AsyncWriteBackend
+
+// 書き出す形式
+enum class ImageFormat {
+    PGM,       // 8bit グレースケール（バイナリ PGM）
+    PNG,       // 8bit グレースケール PNG（圧縮なし）
+    RawFloat,  // 32bit float をそのまま並べたもの（リトルエンディアン、ヘッダ無し）
+    PFM,       // 32bit float のグレースケール PFM（リトルエンディアン、下の行から並ぶ）
+    Tiff16,    // 16bit グレースケールのタイル分割 TIFF
+    TiffFloat, // 32bit float のタイル分割 TIFF
+};
+
+// 形式ごとの書き出し設定（今は TIFF だけが使う）
+struct ImageOptions {
+    int tileSize = 256;     // TIFF のタイルの一辺（16 の倍数に切り上げる）
+    bool compress = false;  // TIFF を予測符号化 + LZW で圧縮する
+    AsyncWriteBackend writeBackend = AsyncWriteBackend::Auto;  // TIFF のファイルへの書き込みのしかた
+};
+
+// ノイズ値（-1.0〜1.0 程度）を 0〜255 の階調に変換する（範囲外は切り詰める）
+unsigned char noiseToGray(float n);
+
+// ノイズ値（-1.0〜1.0 程度）を 0〜65535 の階調に変換する（範囲外は切り詰める）
+unsigned short noiseToGray16(float n);
+
+// タイル分割 TIFF の形式かどうか
+bool isTiffFormat(ImageFormat format);
+
+// 形式に対応する拡張子（"pgm" など）
+const char* imageExtension(ImageFormat format);
+
+// 連番のファイル名を作る（prefix + 4桁以上の番号 + "." + 拡張子）
+std::string numberedPath(const std::string& prefix, int index, ImageFormat format);
+
+// ノイズ値の配列を画像ファイルとして書き出す
+// path: 書き出し先
+// values: ノイズ値（width * height 要素、行優先）
+// options: 形式ごとの設定
+// 戻り値: 成功したら true
+bool writeImage(const std::string& path, const float* values, int width, int height, ImageFormat format,
+    const ImageOptions& options = ImageOptions());
@@ -0,0 +1,99 @@
+﻿#include "lazy_gradients.h"
+
+#include <cmath>    // std::floor
+#include <random>   // 乱数生成用
+
+#include "perlin.h" // fade, lerp, randomGradient
+
+LazyGradientTable::LazyGradientTable(int period, unsigned seed, int chunkSize)
+    : periodCells(period), seed(seed), built(0) {
+
+    chunkShift = 0;
+    while ((1 << chunkShift) < chunkSize) chunkShift++;
+    chunkMask = (1 << chunkShift) - 1;
+    chunksPerRow = (period + chunkMask) >> chunkShift;
+
+    int count = chunksPerRow * chunksPerRow;
+    chunks.reset(new std::atomic<float*>[count]);
+    for (int i = 0; i < count; i++) chunks[i].store(nullptr, std::memory_order_relaxed);
+}
+
+LazyGradientTable::~LazyGradientTable() {
+    int count = chunksPerRow * chunksPerRow;
+    for (int i = 0; i < count; i++) delete[] chunks[i].load(std::memory_order_relaxed);
+}
+
+const float* LazyGradientTable::buildChunk(int cx, int cy) const {
+    int side = 1 << chunkShift;
+    float* chunk = new float[(size_t)side * side * 2];
+
+    // チャンクごとに独立した乱数列（作る順番やスレッドに左右されない）
+    std::seed_seq sequence{ seed, (unsigned)cx, (unsigned)cy };
+    std::mt19937 rng(sequence);
+    for (int i = 0; i < side * side; i++) {
+        std::pair<float, float> g = randomGradient(rng);
+        chunk[i * 2] = g.first;
+        chunk[i * 2 + 1] = g.second;
+    }
+
+    // 同時に同じチャンクを作ったスレッドがあれば、先に公開された方を使う
+    float* expected = nullptr;
+    if (chunks[cy * chunksPerRow + cx].compare_exchange_strong(expected, chunk,
+            std::memory_order_acq_rel, std::memory_order_acquire)) {
+        built.fetch_add(1, std::memory_order_relaxed);
+        return chunk;
+    }
+    delete[] chunk;
+    return expected;
+}
+
+// 勾配ベクトル g と、格子点 (ix, iy) から点 (x, y) までの距離ベクトルの内積
+static inline float dotGradient(const float* g, int ix, int iy, float x, float y) {
+    return (x - ix) * g[0] + (y - iy) * g[1];
+}
+
+float perlinLazy(float x, float y, const LazyGradientTable& table) {
+    // [0, period) に折り返す（perlinTiled と同じ）
+    int period = table.period();
+    x = x - std::floor(x / period) * period;
+    y = y - std::floor(y / period) * period;
+    if (x >= period) x = 0.0f;
+    if (y >= period) y = 0.0f;
+
+    int x0 = (int)x;
+    int y0 = (int)y;
+    float sx = fade(x - x0);
+    float sy = fade(y - y0);
+
+    // 4隅が同じチャンクにあれば（ほとんどの場合）チャンクを引くのは1回で済む
+    const float* g00 = table.gradient(x0, y0);
+    const float* g10;
+    const float* g01;
+    const float* g11;
+    if (table.cellInsideChunk(x0, y0)) {
+        g10 = g00 + 2;
+        g01 = g00 + table.rowStride();
+        g11 = g01 + 2;
+    } else {
+        g10 = table.gradient(x0 + 1, y0);
+        g01 = table.gradient(x0, y0 + 1);
+        g11 = table.gradient(x0 + 1, y0 + 1);
+    }
+
+    float ix0 = lerp(dotGradient(g00, x0, y0, x, y), dotGradient(g10, x0 + 1, y0, x, y), sx);
+    float ix1 = lerp(dotGradient(g01, x0, y0 + 1, x, y), dotGradient(g11, x0 + 1, y0 + 1, x, y), sx);
+    return lerp(ix0, ix1, sy);
+}
+
+float fbm2Lazy(float x, float y, int octaves, const LazyGradientTable& table) {
+    float sum = 0.0f;
+    float amplitude = 1.0f;
+    for (int o = 0; o < octaves; o++) {
+        sum += amplitude * perlinLazy(x, y, table);
+        x *= 2.0f;
+        y *= 2.0f;
+        amplitude *= 0.5f;
+    }
+    float total = fbmAmplitudeSum(octaves);
+    return total > 0.0f ? sum / total : 0.0f;
+}
@@ -0,0 +1,68 @@
+﻿// 必要になった範囲だけを作るタイル可能な勾配配列
+// 周期の大きい勾配配列を起動時にまとめて作ると、最初のタイルが出るまで待たされる
+// ここでは配列をチャンク（chunkSize × chunkSize のグリッド点）に分け、初めて使われたときにそのチャンクだけを作る
+// 作ったチャンクは原子的なポインタで公開するので、作った後の参照はロックを取らない
+//
+// チャンクごとに (seed, チャンク座標) から乱数を初期化するので、どの順に作っても同じ値になる
+// （makeTileableGradients とは乱数の並びが違うため、同じ種でも模様は別になる）
+#pragma once
+
+#include <atomic>   // チャンクの公開
+#include <memory>   // std::unique_ptr
+
+class LazyGradientTable {
+public:
+    // period: 周期（グリッド点数）
+    // seed: 乱数の種
+    // chunkSize: チャンクの一辺（2の累乗に切り上げる）
+    LazyGradientTable(int period, unsigned seed, int chunkSize = 64);
+    ~LazyGradientTable();
+    LazyGradientTable(const LazyGradientTable&) = delete;
+    LazyGradientTable& operator=(const LazyGradientTable&) = delete;
+
+    int period() const { return periodCells; }
+
+    // グリッド点 (gx, gy) の勾配ベクトル（[0] が x 成分、[1] が y 成分）
+    // gx, gy: [0, period] の範囲（period は 0 と同じ点として扱う）
+    // 複数スレッドから同時に呼んでよい
+    const float* gradient(int gx, int gy) const {
+        if (gx >= periodCells) gx -= periodCells;
+        if (gy >= periodCells) gy -= periodCells;
+        int cx = gx >> chunkShift;
+        int cy = gy >> chunkShift;
+        const float* chunk = chunks[cy * chunksPerRow + cx].load(std::memory_order_acquire);
+        if (!chunk) chunk = buildChunk(cx, cy);
+        int local = ((gy & chunkMask) << chunkShift) + (gx & chunkMask);
+        return chunk + local * 2;
+    }
+
+    // グリッドのセル (gx, gy)〜(gx + 1, gy + 1) の4点が同じチャンクに入っているか
+    // 入っていれば gradient(gx, gy) から右隣は +2、下隣は +rowStride() の位置にある
+    bool cellInsideChunk(int gx, int gy) const {
+        return (gx & chunkMask) != chunkMask && (gy & chunkMask) != chunkMask &&
+            gx + 1 < periodCells && gy + 1 < periodCells;
+    }
+    int rowStride() const { return 2 << chunkShift; }
+
+    // 作り終えたチャンクの数と全体のチャンクの数
+    int builtChunks() const { return built.load(std::memory_order_relaxed); }
+    int chunkCount() const { return chunksPerRow * chunksPerRow; }
+
+private:
+    // チャンクを作って公開する（他のスレッドが先に公開していればそちらを使う）
+    const float* buildChunk(int cx, int cy) const;
+
+    int periodCells;
+    unsigned seed;
+    int chunkShift;
+    int chunkMask;
+    int chunksPerRow;
+    std::unique_ptr<std::atomic<float*>[]> chunks;
+    mutable std::atomic<int> built;
+};
+
+// 遅延勾配配列でタイル可能なパーリンノイズを評価する（座標は周期で折り返す）
+float perlinLazy(float x, float y, const LazyGradientTable& table);
+
+// perlinLazy を複数オクターブ重ねたもの（振幅の合計で正規化）
+float fbm2Lazy(float x, float y, int octaves, const LazyGradientTable& table);
@@ -0,0 +1,56 @@
+﻿#include "loop.h"
+#include "sequence.h"
+
+#include <cmath>    // sin, cos
+
+// 4D勾配配列の大きさ（x, y は画面より十分大きく、時間の円が通る z, w は小さくてよい）
+const int LOOP_VOLUME_XY = 64;
+const int LOOP_VOLUME_ZW = 8;
+const unsigned LOOP_SEED = 123;
+
+// 時間の円の中心（格子点からずらして、円上で値が偏らないようにする）
+const float LOOP_CENTER = 3.5f;
+
+GradientHypervolume makeLoopVolume() {
+    return makeGradientHypervolume(LOOP_VOLUME_XY, LOOP_VOLUME_XY, LOOP_VOLUME_ZW, LOOP_VOLUME_ZW, LOOP_SEED);
+}
+
+void renderLoopTile(float* out, const LoopParams& params, const GradientHypervolume& volume, int frame,
+    int x0, int y0, int x1, int y1) {
+
+    // フレーム番号を円上の角度に変換（frames フレームで一周）
+    float angle = 2.0f * 3.1415926f * (float)(frame % params.frames) / params.frames;
+    float z = LOOP_CENTER + params.radius * std::cos(angle);
+    float w = LOOP_CENTER + params.radius * std::sin(angle);
+    float inv = 1.0f / params.gridSize;
+
+    for (int y = y0; y < y1; y++) {
+        float* row = out + (size_t)y * params.width;
+        for (int x = x0; x < x1; x++) {
+            row[x] = fbm4(x * inv, y * inv, z, w, params.octaves, volume);
+        }
+    }
+}
+
+void renderLoopFrame(float* out, const LoopParams& params, const GradientHypervolume& volume, int frame) {
+    renderLoopTile(out, params, volume, frame, 0, 0, params.width, params.height);
+}
+
+bool exportLoopSequence(const LoopParams& params, const std::string& prefix, ImageFormat format) {
+    GradientHypervolume volume = makeLoopVolume();
+
+    // フレームどうしは独立しているので、フレーム単位で分担すれば同期は番号の取り合いだけで済む
+    SequenceParams sequence;
+    sequence.width = params.width;
+    sequence.height = params.height;
+    sequence.frames = params.frames;
+    sequence.threadCount = params.threadCount;
+    sequence.prefix = prefix;
+    sequence.format = format;
+
+    SequenceStats stats = renderSequence(sequence,
+        [&](int frame, int x0, int y0, int x1, int y1, float* pixels) {
+            renderLoopTile(pixels, params, volume, frame, x0, y0, x1, y1);
+        });
+    return stats.ok;
+}
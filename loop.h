@@ -0,0 +1,38 @@
+﻿// 継ぎ目なくループするアニメーション
+// 4次元ノイズの 3軸目・4軸目の平面上で円を一周するように時間を進めるので、
+// 最後のフレームの次が最初のフレームに滑らかにつながる
+#pragma once
+
+#include <string>   // 出力ファイル名
+
+#include "perlin.h"   // GradientHypervolume
+#include "image_io.h" // ImageFormat
+
+// ループアニメーションの設定
+struct LoopParams {
+    int width = 1280;        // 横幅（ピクセル）
+    int height = 720;        // 高さ（ピクセル）
+    float gridSize = 32.0f;  // 基本オクターブのグリッド間隔（ピクセル）
+    int frames = 120;        // 1ループのフレーム数
+    float radius = 1.0f;     // 時間方向の円の半径（グリッド単位、大きいほど1ループ中の変化が大きい）
+    int octaves = 4;         // 重ねるオクターブ数
+    int threadCount = 0;     // スレッド数（0 以下なら論理プロセッサ数）
+};
+
+// ループアニメーション用の4D勾配ベクトル配列を作る
+GradientHypervolume makeLoopVolume();
+
+// ループの frame 番目のフレームのうち矩形 [x0, x1) × [y0, y1) を生成する（1スレッドで計算する）
+// out: フレーム全体の出力先（width * height 要素）
+// frame: フレーム番号（frames を法として扱う）
+void renderLoopTile(float* out, const LoopParams& params, const GradientHypervolume& volume, int frame,
+    int x0, int y0, int x1, int y1);
+
+// ループの frame 番目のフレーム全体を生成する
+void renderLoopFrame(float* out, const LoopParams& params, const GradientHypervolume& volume, int frame);
+
+// ループの全フレームをフレーム単位で並列に生成し、番号順に連番ファイルとして書き出す
+// prefix: 出力ファイル名の先頭（"out/loop_" なら out/loop_0000.pgm, out/loop_0001.pgm, ...）
+// format: 書き出す形式
+// 戻り値: すべて書き出せたら true
+bool exportLoopSequence(const LoopParams& params, const std::string& prefix, ImageFormat format);
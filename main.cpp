@@ -1,9 +1,13 @@
 ﻿// DxLib のヘッダファイル（描画や画面制御に使用）
 #include "DxLib.h"
 
-#include <cmath>    // 数学関数（sin, cos など）用
 #include <vector>   // ベクタ型を使用するため
-#include <random>   // 乱数生成用
+
+#include "perlin.h"   // パーリンノイズ本体
+#include "contour.h"  // 等高線抽出
+#include "animation.h" // アニメーション生成と予算制御
+#include "frame_pipeline.h" // バックグラウンド生成
+#include "image_io.h"  // ノイズ値から階調への変換
 
 // 画面サイズ（描画するピクセル領域）
 const int WIDTH = 1280;   // 横幅（ピクセル）
@@ -12,81 +16,129 @@ const int HEIGHT = 720;  // 高さ（ピクセル）
 // グリッドの間隔（パーリンノイズの基本単位サイズ）
 const int GRID_SIZE = 32;
 
-// 補間関数：スムーズステップ（S字カーブ）
-// t: [0.0〜1.0] の補間パラメータ
-// 戻り値: tを滑らかにした値
-float fade(float t) {
-    return t * t * t * (t * (t * 6 - 15) + 10);
-}
-
-// 線形補間関数
-// a, b: 補間元の2値
-// t: 補間係数（0〜1）
-// 戻り値: aとbをtで補間した値
-float lerp(float a, float b, float t) {
-    return a + t * (b - a);
-}
+// 等高線を重ねて描くかどうかと、その高さの間隔
+const bool SHOW_CONTOURS = true;
+const float CONTOUR_STEP = 0.1f;
 
-// ドット積計算：グリッドの勾配ベクトルと対象点からの距離ベクトルの内積を求める
-// ix, iy: 勾配ベクトルのグリッド座標
-// x, y: 対象点の座標（連続空間）
-// gradients: 勾配ベクトルの2次元配列
-// 戻り値: 点(x,y)とグリッド(ix,iy)のベクトルの内積
-float dotGridGradient(int ix, int iy, float x, float y,
-    const std::vector<std::vector<std::pair<float, float>>>& gradients) {
+// true なら時間で変化するノイズをアニメーション表示する（false なら静止画＋等高線）
+const bool ANIMATED_VIEW = true;
 
-    // 点とグリッドの差分（距離ベクトル）
-    float dx = x - ix;
-    float dy = y - iy;
+// 1フレームの生成に使ってよい時間
+// 生成は別スレッドで表示と並行して進むので、60fps の1フレーム分をまるごと使える
+const double FRAME_BUDGET_MS = 1000.0 / 60.0;
 
-    // 勾配ベクトルの取得（ランダムに与えられている）
-    auto grad = gradients[iy][ix];
+// 高オクターブを何フレームかけて一巡させるか（N×N の模様、1 なら毎フレーム全画素）
+const int DETAIL_REFRESH_SIDE = 2;
 
-    // 距離ベクトルと勾配ベクトルの内積
-    return dx * grad.first + dy * grad.second;
-}
+// 静止画のノイズと等高線を裏画面に描画する
+static void drawStaticView() {
 
-// パーリンノイズ計算関数（1オクターブ）
-// x, y: ノイズ空間上の座標（float）
-// gradients: 勾配ベクトルの2次元配列
-// 戻り値: パーリンノイズ値（範囲は概ね -1.0〜1.0）
-float perlin(float x, float y,
-    const std::vector<std::vector<std::pair<float, float>>>& gradients) {
+    // 勾配ベクトルを格納する2次元ベクトル
+    // グリッド点は (WIDTH / GRID_SIZE + 2) × (HEIGHT / GRID_SIZE + 2)
+    int gridW = WIDTH / GRID_SIZE + 2;
+    int gridH = HEIGHT / GRID_SIZE + 2;
 
-    // 対象座標の左上整数グリッド
-    int x0 = (int)x;
-    int y0 = (int)y;
+    // 勾配ベクトルを各グリッド点に割り当てる（種は固定して毎回同じパターンに）
+    GradientGrid gradients = makeGradients(gridW, gridH, 123);
 
-    // 右隣・下隣のグリッド
-    int x1 = x0 + 1;
-    int y1 = y0 + 1;
+    // 全画素のノイズ値（-1.0〜1.0 程度）を高さマップとして計算
+    std::vector<float> heightmap(WIDTH * HEIGHT);
+    generateHeightmap(heightmap.data(), WIDTH, HEIGHT, GRID_SIZE, gradients);
 
-    // 小数部分を補間パラメータにする（S字補間に備える）
-    float sx = fade(x - x0);
-    float sy = fade(y - y0);
+    // 高さマップを画面に描画
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            float n = heightmap[y * WIDTH + x];
 
-    // 4つのグリッド点に対する内積計算
-    float n0 = dotGridGradient(x0, y0, x, y, gradients);
-    float n1 = dotGridGradient(x1, y0, x, y, gradients);
-    float ix0 = lerp(n0, n1, sx); // 上辺補間
+            // 値を 0〜255 にマッピング（グレースケール）
+            int gray = noiseToGray(n);
 
-    float n2 = dotGridGradient(x0, y1, x, y, gradients);
-    float n3 = dotGridGradient(x1, y1, x, y, gradients);
-    float ix1 = lerp(n2, n3, sx); // 下辺補間
+            // ピクセルを描画（RGB同値でグレースケール）
+            DrawPixel(x, y, GetColor(gray, gray, gray));
+        }
+    }
 
-    // 上下を補間して最終ノイズ値にする
-    return lerp(ix0, ix1, sy);
+    // 等高線を重ねて描画
+    if (SHOW_CONTOURS) {
+        unsigned int lineColor = GetColor(255, 160, 0);
+        for (int k = -5; k <= 5; k++) {
+            float level = k * CONTOUR_STEP;
+            std::vector<ContourLine> lines = extractContours(heightmap.data(), WIDTH, HEIGHT, level);
+            for (const ContourLine& line : lines) {
+                size_t count = line.points.size();
+                size_t segments = line.closed ? count : count - 1;
+                for (size_t i = 0; i < segments; i++) {
+                    const auto& a = line.points[i];
+                    const auto& b = line.points[(i + 1) % count];
+                    DrawLineAA(a.first, a.second, b.first, b.second, lineColor);
+                }
+            }
+        }
+    }
 }
 
-// 勾配ベクトルをランダムに生成
-// gen: 乱数エンジン
-// 戻り値: 単位長の2Dベクトル（cosθ, sinθ）
-std::pair<float, float> randomGradient(std::mt19937& gen) {
-    std::uniform_real_distribution<float> dist(0.0f, 2.0f * 3.1415926f);
-    float angle = dist(gen); // 0〜2πのランダム角度
-    return { std::cos(angle), std::sin(angle) }; // 単位ベクトル
-}
+// 時間で変化するノイズを毎フレーム生成して表示する（ESCキーで終了）
+// 生成は別スレッドで次のフレームを作り、表示側は出来上がったフレームを受け取るだけにする
+// 生成時間が予算を超えそうなら解像度やオクターブ数を自動で下げる
+static void runAnimatedView() {
+    AnimationParams params;
+    params.width = WIDTH;
+    params.height = HEIGHT;
+    params.gridSize = (float)GRID_SIZE;
+    params.detailRefreshSide = DETAIL_REFRESH_SIDE;
+
+    BackgroundRenderer renderer(params, FRAME_BUDGET_MS);
+    renderer.start();
+
+    // ピクセルを書き込むソフトイメージと、それを転送したグラフィック
+    int softImage = MakeXRGB8ColorSoftImage(WIDTH, HEIGHT);
+    int graph = -1;
+    unsigned int textColor = GetColor(255, 255, 0);
 
+    LONGLONG lastFrame = GetNowHiPerformanceCount();
+    double frameIntervalMs = 0.0;
+
+    while (!ProcessMessage() && !CheckHitKey(KEY_INPUT_ESCAPE)) {
+        // 新しいフレームが出来ていれば受け取り、グレースケールに変換して転送
+        if (renderer.acquire()) {
+            const std::vector<float>& pixels = renderer.front().pixels;
+            for (int y = 0; y < HEIGHT; y++) {
+                for (int x = 0; x < WIDTH; x++) {
+                    int gray = noiseToGray(pixels[y * WIDTH + x]);
+                    DrawPixelSoftImage_Unsafe_XRGB8(softImage, x, y, gray, gray, gray);
+                }
+            }
+            if (graph < 0) graph = CreateGraphFromSoftImage(softImage);
+            else ReCreateGraphFromSoftImage(softImage, graph);
+        }
+
+        ClearDrawScreen();
+        if (graph >= 0) DrawGraph(0, 0, graph, FALSE);
+
+        // フレーム時間の統計を表示（生成側の値は表示中のフレームを作った時点のもの）
+        const FrameSlot& shown = renderer.front();
+        const FrameStats& s = shown.stats;
+        DrawFormatString(8, 8, textColor, _T("frame %.2f ms (%.1f fps)  generated %lld  shown #%lld"),
+            frameIntervalMs, frameIntervalMs > 0.0 ? 1000.0 / frameIntervalMs : 0.0,
+            renderer.producedFrames(), shown.index);
+        DrawFormatString(8, 28, textColor, _T("generate %.2f ms  avg %.2f  min %.2f  max %.2f  budget %.2f"),
+            s.lastMs, s.averageMs, s.minMs, s.maxMs, FRAME_BUDGET_MS);
+        DrawFormatString(8, 48, textColor, _T("step %d  octaves %d  over budget %d / %d"),
+            shown.quality.step, shown.quality.octaves, s.overBudget, s.frames);
+
+        ScreenFlip();
+
+        // 表示まで含めた1フレームの間隔（移動平均）
+        LONGLONG now = GetNowHiPerformanceCount();
+        double interval = (now - lastFrame) / 1000.0;
+        frameIntervalMs = frameIntervalMs > 0.0 ? frameIntervalMs * 0.9 + interval * 0.1 : interval;
+        lastFrame = now;
+    }
+
+    renderer.stop();
+    if (graph >= 0) DeleteGraph(graph);
+    DeleteSoftImage(softImage);
+}
 
 int WINAPI WinMain(
     _In_ HINSTANCE hInstance,
@@ -100,47 +152,17 @@ int WINAPI WinMain(
     // 描画先を裏画面に設定（ダブルバッファリング）
     SetDrawScreen(DX_SCREEN_BACK);
 
-    // 勾配ベクトルを格納する2次元ベクトル
-    // グリッド点は (WIDTH / GRID_SIZE + 2) × (HEIGHT / GRID_SIZE + 2)
-    int gridW = WIDTH / GRID_SIZE + 2;
-    int gridH = HEIGHT / GRID_SIZE + 2;
-
-    // 乱数生成器（種は固定して毎回同じパターンに）
-    std::mt19937 rng(123);
+    if (ANIMATED_VIEW) {
+        runAnimatedView();
+    } else {
+        drawStaticView();
 
-    // 勾配ベクトルを各グリッド点に割り当てる
-    std::vector<std::vector<std::pair<float, float>>> gradients(
-        gridH, std::vector<std::pair<float, float>>(gridW));
-    for (int y = 0; y < gridH; y++) {
-        for (int x = 0; x < gridW; x++) {
-            gradients[y][x] = randomGradient(rng);
+        // 終了までメッセージループ（ESCキーで終了）
+        while (!ProcessMessage() && !CheckHitKey(KEY_INPUT_ESCAPE)) {
+            ScreenFlip(); // 裏画面を表画面に反映（表示）
         }
     }
 
-    // 全画素に対してノイズを計算し、画面に描画
-    for (int y = 0; y < HEIGHT; y++) {
-        for (int x = 0; x < WIDTH; x++) {
-            // 現在のピクセルをノイズ空間に正規化（グリッドサイズで割る）
-            float fx = (float)x / GRID_SIZE;
-            float fy = (float)y / GRID_SIZE;
-
-            // パーリンノイズ値（-1.0〜1.0 程度）
-            float n = perlin(fx, fy, gradients);
-
-            // 値を 0〜255 にマッピング（グレースケール）
-            n = (n + 1.0f) / 2.0f;     // -1〜1 → 0〜1
-            int gray = (int)(n * 255); // 0〜255
-
-            // ピクセルを描画（RGB同値でグレースケール）
-            DrawPixel(x, y, GetColor(gray, gray, gray));
-        }
-    }
-
-    // 終了までメッセージループ（ESCキーで終了）
-    while (!ProcessMessage() && !CheckHitKey(KEY_INPUT_ESCAPE)) {
-        ScreenFlip(); // 裏画面を表画面に反映（表示）
-    }
-
     // DxLib 終了処理
     DxLib_End();
     return 0;
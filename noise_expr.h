@@ -0,0 +1,284 @@
+﻿// コンパイル時に組み立てるノイズ式（式テンプレート）
+// 例: auto terrain = fbm(perlinSource(table1, 1.0f / 128), 5) * 0.5f + ridged(fbm(perlinSource(table2, 1.0f / 32), 3)) * 0.25f;
+//     renderExpression(terrain, pixels, width, height);
+// 式全体が1つの型になるので、タイルの計算は式全体を展開した1つの SIMD のループにまとまる
+// （各ノードは WIDTH 点分の値をレジスタで受け渡し、仮想関数呼び出しも、NoiseGraph のような途中の値の作業領域も無い）
+// 組み立てる形が実行時に決まる場合は NoiseGraph を使う
+//
+// 式の型は使う側の翻訳単位でしか決まらないので、命令セットごとの本体（noise_expr_simd.h）は
+// noise_simd_*.cpp と同じ命令セットの指定をこのヘッダーの中で切り替えながら読み込み、実行中の CPU に合わせて選ぶ
+#pragma once
+
+#include <algorithm>  // std::min
+#include <cmath>      // std::floor
+#include <cstddef>    // size_t
+
+#include "perlin.h"     // GradientTableView, fade, fbmAmplitudeSum
+#include "parallel.h"   // parallelFor
+#include "noise_simd.h" // detectSimdLevel, simd.h
+
+// すべての式の基底（CRTP）。演算子をノイズ式どうしに限定するために使う
+template <class Derived>
+struct NoiseExpr {
+    const Derived& self() const { return static_cast<const Derived&>(*this); }
+};
+
+// パーリンノイズ（1オクターブ、perlinTable と同じ値）
+// 勾配配列（flattenGradients で並べたもの）は参照で持つので、式を使い終わるまで破棄しないこと
+struct PerlinSourceExpr : NoiseExpr<PerlinSourceExpr> {
+    GradientTableView table;
+    float frequency;
+
+    PerlinSourceExpr(const GradientTableView& table, float frequency) : table(table), frequency(frequency) {}
+};
+
+// 定数
+struct ConstantExpr : NoiseExpr<ConstantExpr> {
+    float value;
+
+    explicit ConstantExpr(float value) : value(value) {}
+};
+
+// 2項演算の種類
+struct AddOp {};
+struct SubtractOp {};
+struct MultiplyOp {};
+
+template <class Op, class L, class R>
+struct BinaryExpr : NoiseExpr<BinaryExpr<Op, L, R>> {
+    L left;
+    R right;
+
+    BinaryExpr(const L& left, const R& right) : left(left), right(right) {}
+};
+
+// 任意の式を複数オクターブ重ねる（周波数2倍・振幅半分、振幅の合計で正規化）
+template <class E>
+struct FbmExpr : NoiseExpr<FbmExpr<E>> {
+    E source;
+    int octaves;
+    float total;  // 振幅の合計
+
+    FbmExpr(const E& source, int octaves) : source(source), octaves(octaves), total(fbmAmplitudeSum(octaves)) {}
+};
+
+// 尾根状のノイズ（1 - |値|、0 付近が鋭い峰になる）
+template <class E>
+struct RidgedExpr : NoiseExpr<RidgedExpr<E>> {
+    E source;
+
+    explicit RidgedExpr(const E& source) : source(source) {}
+};
+
+// 値を [lower, upper] に切り詰める
+template <class E>
+struct ClampExpr : NoiseExpr<ClampExpr<E>> {
+    E source;
+    float lower;
+    float upper;
+
+    ClampExpr(const E& source, float lower, float upper) : source(source), lower(lower), upper(upper) {}
+};
+
+// 式を作る関数
+inline PerlinSourceExpr perlinSource(const GradientTableView& table, float frequency) {
+    return PerlinSourceExpr(table, frequency);
+}
+
+template <class E>
+FbmExpr<E> fbm(const NoiseExpr<E>& source, int octaves) {
+    return FbmExpr<E>(source.self(), octaves);
+}
+
+template <class E>
+RidgedExpr<E> ridged(const NoiseExpr<E>& source) {
+    return RidgedExpr<E>(source.self());
+}
+
+template <class E>
+ClampExpr<E> clampExpr(const NoiseExpr<E>& source, float lower, float upper) {
+    return ClampExpr<E>(source.self(), lower, upper);
+}
+
+// 演算子（式どうし、または式と数値）
+template <class L, class R>
+BinaryExpr<AddOp, L, R> operator+(const NoiseExpr<L>& l, const NoiseExpr<R>& r) {
+    return BinaryExpr<AddOp, L, R>(l.self(), r.self());
+}
+template <class L>
+BinaryExpr<AddOp, L, ConstantExpr> operator+(const NoiseExpr<L>& l, float r) {
+    return BinaryExpr<AddOp, L, ConstantExpr>(l.self(), ConstantExpr(r));
+}
+template <class R>
+BinaryExpr<AddOp, ConstantExpr, R> operator+(float l, const NoiseExpr<R>& r) {
+    return BinaryExpr<AddOp, ConstantExpr, R>(ConstantExpr(l), r.self());
+}
+
+template <class L, class R>
+BinaryExpr<SubtractOp, L, R> operator-(const NoiseExpr<L>& l, const NoiseExpr<R>& r) {
+    return BinaryExpr<SubtractOp, L, R>(l.self(), r.self());
+}
+template <class L>
+BinaryExpr<SubtractOp, L, ConstantExpr> operator-(const NoiseExpr<L>& l, float r) {
+    return BinaryExpr<SubtractOp, L, ConstantExpr>(l.self(), ConstantExpr(r));
+}
+template <class R>
+BinaryExpr<SubtractOp, ConstantExpr, R> operator-(float l, const NoiseExpr<R>& r) {
+    return BinaryExpr<SubtractOp, ConstantExpr, R>(ConstantExpr(l), r.self());
+}
+
+template <class L, class R>
+BinaryExpr<MultiplyOp, L, R> operator*(const NoiseExpr<L>& l, const NoiseExpr<R>& r) {
+    return BinaryExpr<MultiplyOp, L, R>(l.self(), r.self());
+}
+template <class L>
+BinaryExpr<MultiplyOp, L, ConstantExpr> operator*(const NoiseExpr<L>& l, float r) {
+    return BinaryExpr<MultiplyOp, L, ConstantExpr>(l.self(), ConstantExpr(r));
+}
+template <class R>
+BinaryExpr<MultiplyOp, ConstantExpr, R> operator*(float l, const NoiseExpr<R>& r) {
+    return BinaryExpr<MultiplyOp, ConstantExpr, R>(ConstantExpr(l), r.self());
+}
+
+// 命令セットごとの本体（exprScalar / exprSse2 / exprSse41 / exprAvx2 / exprAvx512 の evaluateTile）
+// noise_simd_*.cpp と同じく積和を FMA にまとめないので、Perlin と fBm の値は fbm2 とビット単位で同じになる
+// 指定はこの範囲の関数にだけ効き、使う側のほかの関数は既定の命令セットのまま
+#if defined(__clang__)
+#pragma float_control(push)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#define NOISE_EXPR_SIMD SimdScalar
+#define NOISE_EXPR_NAMESPACE exprScalar
+#include "noise_expr_simd.h"
+
+#if defined(SIMD_X86)
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC の avx512fintrin.h は未初期化の値を意図的に使う（_mm512_undefined_ps）ので、その誤検出を止める
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+// SSE2
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sse2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#endif
+#define SIMD_ENABLE_SSE2
+#include "simd.h"
+#define NOISE_EXPR_SIMD SimdSse2
+#define NOISE_EXPR_NAMESPACE exprSse2
+#include "noise_expr_simd.h"
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+// SSE4.1
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sse4.1"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#endif
+#define SIMD_ENABLE_SSE41
+#include "simd.h"
+#define NOISE_EXPR_SIMD SimdSse41
+#define NOISE_EXPR_NAMESPACE exprSse41
+#include "noise_expr_simd.h"
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+// AVX2
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+#define SIMD_ENABLE_AVX2
+#include "simd.h"
+#define NOISE_EXPR_SIMD SimdAvx2
+#define NOISE_EXPR_NAMESPACE exprAvx2
+#include "noise_expr_simd.h"
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+// AVX-512F
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#endif
+#define SIMD_ENABLE_AVX512
+#include "simd.h"
+#define NOISE_EXPR_SIMD SimdAvx512
+#define NOISE_EXPR_NAMESPACE exprAvx512
+#include "noise_expr_simd.h"
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+#if defined(__clang__)
+#pragma float_control(pop)
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+// 式の値を矩形領域について求める（実行中の CPU で使える最も幅の広い命令セットの本体を使う）
+// x0, y0: 左上のピクセル座標
+// out: 書き込み先（行 y の先頭は out + y * stride）
+template <class E>
+void evaluateExpressionTile(const NoiseExpr<E>& expression, int x0, int y0, int width, int height,
+    float* out, size_t stride) {
+
+    const E& e = expression.self();
+#if defined(SIMD_X86)
+    switch (detectSimdLevel()) {
+    case SimdLevel::Avx512: exprAvx512::evaluateTile(e, x0, y0, width, height, out, stride); return;
+    case SimdLevel::Avx2:   exprAvx2::evaluateTile(e, x0, y0, width, height, out, stride);   return;
+    case SimdLevel::Sse41:  exprSse41::evaluateTile(e, x0, y0, width, height, out, stride);  return;
+    case SimdLevel::Sse2:   exprSse2::evaluateTile(e, x0, y0, width, height, out, stride);   return;
+    default: break;
+    }
+#endif
+    exprScalar::evaluateTile(e, x0, y0, width, height, out, stride);
+}
+
+// 式の値を画像全体について求める（タイルごとに並列に評価する）
+template <class E>
+void renderExpression(const NoiseExpr<E>& expression, float* out, int width, int height,
+    int tileSize = 64, int threadCount = 0) {
+
+    if (tileSize <= 0) tileSize = 64;
+    int tilesX = (width + tileSize - 1) / tileSize;
+    int tilesY = (height + tileSize - 1) / tileSize;
+
+    parallelFor(tilesX * tilesY, threadCount, [&](int t) {
+        int x0 = (t % tilesX) * tileSize;
+        int y0 = (t / tilesX) * tileSize;
+        int w = std::min(tileSize, width - x0);
+        int h = std::min(tileSize, height - y0);
+        evaluateExpressionTile(expression, x0, y0, w, h, out + (size_t)y0 * width + x0, (size_t)width);
+    });
+}
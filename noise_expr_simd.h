@@ -0,0 +1,145 @@
+﻿// noise_expr.h の式を WIDTH 点ずつまとめて求める本体（命令セットごとに1回ずつ読み込まれる）
+// このファイルには #pragma once を付けない。noise_expr.h が命令セットの指定を切り替えながら、次の2つを定義して読み込む
+//   NOISE_EXPR_SIMD      : simd.h の命令セットの型（SimdScalar、SimdAvx2 など）
+//   NOISE_EXPR_NAMESPACE : 中身を置く名前空間（命令セットごとに別の名前）
+// 組み込み関数はその命令セットを許可した関数の中にしか展開できないので、テンプレートも読み込むたびに定義し直す
+//
+// 式のノードは、同じ y に並ぶ WIDTH 点 (x[k], y) の値をまとめて返す
+// （式の中で座標を変えるのは fBm の2倍だけなので、1行の中で y が変わることは無い）
+
+namespace NOISE_EXPR_NAMESPACE {
+
+typedef NOISE_EXPR_SIMD S;
+typedef S::F F;
+typedef S::I I;
+
+// 式 E の値（ノードの種類ごとに特殊化する）
+template <class E>
+struct Lanes;
+
+template <>
+struct Lanes<ConstantExpr> {
+    static SIMD_INLINE F evaluate(const ConstantExpr& e, F, float) { return F(e.value); }
+};
+
+// 勾配配列を読むパーリンノイズ（TablePerlinEvaluator と同じ式なので、値は perlinTable と同じ）
+template <>
+struct Lanes<PerlinSourceExpr> {
+    static SIMD_INLINE F evaluate(const PerlinSourceExpr& e, F px, float py) {
+        const GradientTableView& table = e.table;
+        const float periodCells = (float)table.period;
+
+        // y は全点で同じなので、セルの行と fade は1回だけ求める
+        float y = py * e.frequency;
+        y = y - std::floor(y / periodCells) * periodCells;
+        int iy = (int)y;
+        float ry = y - (float)iy;
+        if (iy >= table.period) iy = 0;
+        const float* row0 = table.data + (size_t)iy * (table.period + 1) * 2;
+        const float* row1 = row0 + (table.period + 1) * 2;
+
+        const F period(periodCells);
+        const F one(1.0f);
+        const F fy(ry);
+        const F fy1 = fy - one;
+
+        // 座標を周期で折り返す（丸めで period ちょうどになった点は格子 0 に戻す）
+        F x = px * F(e.frequency);
+        x = x - S::floor(x / period) * period;
+        I ix = S::truncate(x);
+        F fx = x - S::toFloat(ix);
+        ix = S::wrapIndex(ix, table.period);
+        F fx1 = fx - one;
+
+        // 4隅の勾配との内積
+        I g = ix + ix;
+        F n0 = fx * S::gather(row0, g) + fy * S::gather(row0 + 1, g);
+        F n1 = fx1 * S::gather(row0 + 2, g) + fy * S::gather(row0 + 3, g);
+        F n2 = fx * S::gather(row1, g) + fy1 * S::gather(row1 + 1, g);
+        F n3 = fx1 * S::gather(row1 + 2, g) + fy1 * S::gather(row1 + 3, g);
+
+        // fade と lerp（perlin.h と同じ式）
+        F sx = fx * fx * fx * (fx * (fx * F(6.0f) - F(15.0f)) + F(10.0f));
+        F top = n0 + sx * (n1 - n0);
+        F bottom = n2 + sx * (n3 - n2);
+        return top + F(fade(ry)) * (bottom - top);
+    }
+};
+
+// 2項演算
+template <class Op>
+struct OpLanes;
+
+template <>
+struct OpLanes<AddOp> {
+    static SIMD_INLINE F apply(F a, F b) { return a + b; }
+};
+template <>
+struct OpLanes<SubtractOp> {
+    static SIMD_INLINE F apply(F a, F b) { return a - b; }
+};
+template <>
+struct OpLanes<MultiplyOp> {
+    static SIMD_INLINE F apply(F a, F b) { return a * b; }
+};
+
+template <class Op, class L, class R>
+struct Lanes<BinaryExpr<Op, L, R>> {
+    static SIMD_INLINE F evaluate(const BinaryExpr<Op, L, R>& e, F x, float y) {
+        return OpLanes<Op>::apply(Lanes<L>::evaluate(e.left, x, y), Lanes<R>::evaluate(e.right, x, y));
+    }
+};
+
+// fBm（fbm2 と同じ順に足し、振幅の合計で割る）
+template <class E>
+struct Lanes<FbmExpr<E>> {
+    static SIMD_INLINE F evaluate(const FbmExpr<E>& e, F x, float y) {
+        F sum(0.0f);
+        float amplitude = 1.0f;
+        for (int o = 0; o < e.octaves; o++) {
+            sum = sum + F(amplitude) * Lanes<E>::evaluate(e.source, x, y);
+            x = x * F(2.0f);
+            y *= 2.0f;
+            amplitude *= 0.5f;
+        }
+        return e.total > 0.0f ? sum / F(e.total) : F(0.0f);
+    }
+};
+
+template <class E>
+struct Lanes<RidgedExpr<E>> {
+    static SIMD_INLINE F evaluate(const RidgedExpr<E>& e, F x, float y) {
+        return F(1.0f) - S::abs(Lanes<E>::evaluate(e.source, x, y));
+    }
+};
+
+template <class E>
+struct Lanes<ClampExpr<E>> {
+    static SIMD_INLINE F evaluate(const ClampExpr<E>& e, F x, float y) {
+        return S::min(S::max(Lanes<E>::evaluate(e.source, x, y), F(e.lower)), F(e.upper));
+    }
+};
+
+// 式の値を矩形領域について求める（式全体を展開した1つのループで、WIDTH 点ずつ出力へ直接書く）
+// 端数の点は WIDTH 要素の一時領域で1回分として計算する
+template <class E>
+void evaluateTile(const E& e, int x0, int y0, int width, int height, float* out, size_t stride) {
+    const int vectorEnd = width - width % S::WIDTH;
+    for (int y = 0; y < height; y++) {
+        float* row = out + (size_t)y * stride;
+        float py = (float)(y0 + y);
+        for (int i = 0; i < vectorEnd; i += S::WIDTH) {
+            S::store(row + i, Lanes<E>::evaluate(e, S::toFloat(S::indices(x0 + i)), py));
+        }
+        if (vectorEnd < width) {
+            float tail[S::WIDTH];
+            S::store(tail, Lanes<E>::evaluate(e, S::toFloat(S::indices(x0 + vectorEnd)), py));
+            for (int i = vectorEnd; i < width; i++) row[i] = tail[i - vectorEnd];
+        }
+    }
+}
+
+} // namespace NOISE_EXPR_NAMESPACE
+
+#undef NOISE_EXPR_SIMD
+#undef NOISE_EXPR_NAMESPACE
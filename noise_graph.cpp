@@ -0,0 +1,386 @@
+﻿#include "noise_graph.h"
+#include "noise_simd.h"
+#include "parallel.h"
+
+#include <algorithm>  // std::min, std::max, std::swap
+#include <cstring>    // memcpy
+#include <map>        // 座標の組の番号
+#include <set>        // 評価済みのノードの記録
+#include <unordered_map> // タイル内で使い回す結果
+#include <utility>    // std::pair
+
+// Perlin ノードの勾配配列の周期（グリッド点数）
+const int GRAPH_PERIOD = 256;
+
+// 座標の組の番号付け
+// 座標の組は、タイルの座標（-1）から辿った Warp ノードの並びで決まる
+// （同じ Warp でも外側の Warp が違えば別の座標になる）ので、(外側の組, Warp ノード) の組ごとに新しい番号を振る
+struct WarpContexts {
+    std::map<std::pair<int, int>, int> ids;
+
+    // 座標の組 parent の中で Warp ノード warp がずらした座標の組の番号
+    int child(int parent, int warp) {
+        auto found = ids.emplace(std::make_pair(parent, warp), (int)ids.size());
+        return found.first->second;
+    }
+};
+
+// タイル評価用の作業領域
+// タイル大の配列を積み上げ式に貸し出し、ノードの評価が終わったら返してもらう
+// 同時に使う数はグラフの深さ程度なので、配列は少数をずっと使い回せる
+struct TileScratch {
+    std::vector<std::vector<float>> buffers;
+    int used = 0;
+    int capacity = 0;  // 1つの配列の要素数
+
+    // タイルの位置と大きさ（座標の組 -1 の点はこの矩形のピクセルを行優先に並べたもの）
+    int tileX0 = 0;
+    int tileY0 = 0;
+    int tileWidth = 0;
+    int tileHeight = 0;
+
+    // 複数の枝から使われるノードの結果（(座標の組 << 32) | ノード番号 → 値）
+    // タイルの評価が終わるまで保持する
+    std::unordered_map<uint64_t, std::vector<float>> shared;
+    WarpContexts contexts;
+
+    float* acquire() {
+        if (used == (int)buffers.size()) buffers.emplace_back(capacity);
+        return buffers[used++].data();
+    }
+    void release(int count = 1) {
+        used -= count;
+    }
+};
+
+// float をビット列のまま比較するための変換
+static uint32_t floatBits(float v) {
+    uint32_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+int NoiseGraph::addNode(const NoiseNode& added) {
+    NoiseNode n = added;
+    int used = 0;
+
+    // 入力を代表ノードに置き換える（加算・乗算は順序を問わないので並べ替えておく）
+    for (int i = 0; i < 3; i++) {
+        if (n.inputs[i] >= 0) {
+            n.inputs[i] = canonical[n.inputs[i]];
+            used = i + 1;
+        }
+    }
+    if ((n.type == NoiseNodeType::Add || n.type == NoiseNodeType::Multiply) && n.inputs[0] > n.inputs[1]) {
+        std::swap(n.inputs[0], n.inputs[1]);
+    }
+
+    int index = (int)nodes.size();
+    nodes.push_back(n);
+
+    // 同じ計算をするノードが既にあればそれを代表にする
+    NodeKey key((int)n.type, n.inputs[0], n.inputs[1], n.inputs[2],
+        floatBits(n.params[0]), floatBits(n.params[1]), floatBits(n.params[2]),
+        n.type == NoiseNodeType::Perlin ? n.octaves : 0, n.gradientIndex);
+    auto found = uniqueNodes.find(key);
+    if (found != uniqueNodes.end()) {
+        canonical.push_back(found->second);
+    } else {
+        uniqueNodes.emplace(key, index);
+        canonical.push_back(index);
+        for (int i = 0; i < used; i++) useCount[n.inputs[i]]++;
+    }
+    useCount.push_back(0);
+    return index;
+}
+
+int NoiseGraph::perlin(float frequency, int octaves, unsigned seed) {
+    NoiseNode n;
+    n.type = NoiseNodeType::Perlin;
+    n.params[0] = frequency;
+    n.octaves = std::max(octaves, 1);
+
+    // 同じ種の勾配配列があれば使い回す
+    for (int i = 0; i < (int)gradientSeeds.size(); i++) {
+        if (gradientSeeds[i] == seed) n.gradientIndex = i;
+    }
+    if (n.gradientIndex < 0) {
+        gradientTables.push_back(flattenGradients(makeTileableGradients(GRAPH_PERIOD, seed)));
+        gradientSeeds.push_back(seed);
+        n.gradientIndex = (int)gradientTables.size() - 1;
+    }
+    return addNode(n);
+}
+
+int NoiseGraph::constant(float value) {
+    NoiseNode n;
+    n.type = NoiseNodeType::Constant;
+    n.params[0] = value;
+    return addNode(n);
+}
+
+int NoiseGraph::add(int a, int b) {
+    NoiseNode n;
+    n.type = NoiseNodeType::Add;
+    n.inputs[0] = a;
+    n.inputs[1] = b;
+    return addNode(n);
+}
+
+int NoiseGraph::multiply(int a, int b) {
+    NoiseNode n;
+    n.type = NoiseNodeType::Multiply;
+    n.inputs[0] = a;
+    n.inputs[1] = b;
+    return addNode(n);
+}
+
+int NoiseGraph::scaleBias(int a, float scale, float bias) {
+    NoiseNode n;
+    n.type = NoiseNodeType::ScaleBias;
+    n.inputs[0] = a;
+    n.params[0] = scale;
+    n.params[1] = bias;
+    return addNode(n);
+}
+
+int NoiseGraph::clamp(int a, float lower, float upper) {
+    NoiseNode n;
+    n.type = NoiseNodeType::Clamp;
+    n.inputs[0] = a;
+    n.params[0] = lower;
+    n.params[1] = upper;
+    return addNode(n);
+}
+
+int NoiseGraph::select(int control, int a, int b, float threshold, float falloff) {
+    NoiseNode n;
+    n.type = NoiseNodeType::Select;
+    n.inputs[0] = control;
+    n.inputs[1] = a;
+    n.inputs[2] = b;
+    n.params[0] = threshold;
+    n.params[1] = std::max(falloff, 0.0f);
+    return addNode(n);
+}
+
+int NoiseGraph::warp(int source, int dx, int dy, float strength) {
+    NoiseNode n;
+    n.type = NoiseNodeType::Warp;
+    n.inputs[0] = source;
+    n.inputs[1] = dx;
+    n.inputs[2] = dy;
+    n.params[0] = strength;
+    return addNode(n);
+}
+
+void NoiseGraph::evaluateNode(int index, const float* xs, const float* ys, int count, float* out,
+    TileScratch& scratch, int context) const {
+
+    index = canonical[index];
+    const NoiseNode& n = nodes[index];
+
+    // 複数の枝から使われるノードは、同じ座標の組で評価済みならその結果を写すだけにする
+    std::vector<float>* cached = nullptr;
+    if (sharingEnabled && useCount[index] > 1) {
+        uint64_t key = ((uint64_t)(uint32_t)context << 32) | (uint32_t)index;
+        auto found = scratch.shared.find(key);
+        if (found != scratch.shared.end()) {
+            std::copy(found->second.begin(), found->second.end(), out);
+            return;
+        }
+        cached = &scratch.shared[key];
+    }
+
+    switch (n.type) {
+    case NoiseNodeType::Perlin: {
+        GradientTableView table;
+        table.period = GRAPH_PERIOD;
+        table.data = gradientTables[n.gradientIndex].data();
+        float frequency = n.params[0];
+        if (context == -1) {
+            // タイルの格子そのものなら、矩形単位の SIMD カーネルで勾配の行を先読みしながら求める
+            // （値は1点ずつ fbm2 で求めた場合と同じ）
+            fbm2BlockPortable(out, scratch.tileWidth, scratch.tileHeight, (size_t)scratch.tileWidth,
+                scratch.tileX0, scratch.tileY0, frequency, n.octaves, table);
+        } else {
+            // ワープでずらした座標は並びに規則が無いので1点ずつ
+            for (int i = 0; i < count; i++) {
+                out[i] = fbm2Table(xs[i] * frequency, ys[i] * frequency, n.octaves, table);
+            }
+        }
+        break;
+    }
+    case NoiseNodeType::Constant:
+        std::fill(out, out + count, n.params[0]);
+        break;
+
+    case NoiseNodeType::Add:
+    case NoiseNodeType::Multiply: {
+        evaluateNode(n.inputs[0], xs, ys, count, out, scratch, context);
+        float* b = scratch.acquire();
+        evaluateNode(n.inputs[1], xs, ys, count, b, scratch, context);
+        if (n.type == NoiseNodeType::Add) {
+            for (int i = 0; i < count; i++) out[i] += b[i];
+        } else {
+            for (int i = 0; i < count; i++) out[i] *= b[i];
+        }
+        scratch.release();
+        break;
+    }
+    case NoiseNodeType::ScaleBias: {
+        evaluateNode(n.inputs[0], xs, ys, count, out, scratch, context);
+        float scale = n.params[0];
+        float bias = n.params[1];
+        for (int i = 0; i < count; i++) out[i] = out[i] * scale + bias;
+        break;
+    }
+    case NoiseNodeType::Clamp: {
+        evaluateNode(n.inputs[0], xs, ys, count, out, scratch, context);
+        float lower = n.params[0];
+        float upper = n.params[1];
+        for (int i = 0; i < count; i++) out[i] = std::min(std::max(out[i], lower), upper);
+        break;
+    }
+    case NoiseNodeType::Select: {
+        float* control = scratch.acquire();
+        float* b = scratch.acquire();
+        evaluateNode(n.inputs[0], xs, ys, count, control, scratch, context);
+        evaluateNode(n.inputs[1], xs, ys, count, out, scratch, context);
+        evaluateNode(n.inputs[2], xs, ys, count, b, scratch, context);
+
+        // threshold の前後 falloff の幅を S字補間でつなぐ（幅 0 なら切り替えるだけ）
+        float threshold = n.params[0];
+        float falloff = n.params[1];
+        for (int i = 0; i < count; i++) {
+            float t;
+            if (falloff > 0.0f) {
+                t = (control[i] - (threshold - falloff)) / (2.0f * falloff);
+                t = fade(std::min(std::max(t, 0.0f), 1.0f));
+            } else {
+                t = control[i] < threshold ? 0.0f : 1.0f;
+            }
+            out[i] = lerp(out[i], b[i], t);
+        }
+        scratch.release(2);
+        break;
+    }
+    case NoiseNodeType::Warp: {
+        // ずらした座標を作り、その座標で source を評価する
+        float* wx = scratch.acquire();
+        float* wy = scratch.acquire();
+        evaluateNode(n.inputs[1], xs, ys, count, wx, scratch, context);
+        evaluateNode(n.inputs[2], xs, ys, count, wy, scratch, context);
+        float strength = n.params[0];
+        for (int i = 0; i < count; i++) {
+            wx[i] = xs[i] + wx[i] * strength;
+            wy[i] = ys[i] + wy[i] * strength;
+        }
+        evaluateNode(n.inputs[0], wx, wy, count, out, scratch, scratch.contexts.child(context, index));
+        scratch.release(2);
+        break;
+    }
+    }
+
+    if (cached) cached->assign(out, out + count);
+}
+
+void NoiseGraph::evaluateTile(int output, int x0, int y0, int width, int height, float* out,
+    size_t stride) const {
+
+    int count = width * height;
+    TileScratch scratch;
+    scratch.capacity = count;
+    scratch.tileX0 = x0;
+    scratch.tileY0 = y0;
+    scratch.tileWidth = width;
+    scratch.tileHeight = height;
+
+    // タイル内の各点のピクセル座標と、結果の一時置き場
+    float* xs = scratch.acquire();
+    float* ys = scratch.acquire();
+    float* values = scratch.acquire();
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            xs[y * width + x] = (float)(x0 + x);
+            ys[y * width + x] = (float)(y0 + y);
+        }
+    }
+
+    evaluateNode(output, xs, ys, count, values, scratch, -1);
+
+    for (int y = 0; y < height; y++) {
+        std::copy(values + y * width, values + (y + 1) * width, out + (size_t)y * stride);
+    }
+}
+
+void NoiseGraph::render(int output, float* out, int width, int height, int tileSize, int threadCount) const {
+    if (tileSize <= 0) tileSize = 64;
+    int tilesX = (width + tileSize - 1) / tileSize;
+    int tilesY = (height + tileSize - 1) / tileSize;
+
+    parallelFor(tilesX * tilesY, threadCount, [&](int t) {
+        int x0 = (t % tilesX) * tileSize;
+        int y0 = (t / tilesX) * tileSize;
+        int w = std::min(tileSize, width - x0);
+        int h = std::min(tileSize, height - y0);
+        evaluateTile(output, x0, y0, w, h, out + (size_t)y0 * width + x0, (size_t)width);
+    });
+}
+
+NoiseGraphReport NoiseGraph::report(int output) const {
+    NoiseGraphReport result;
+
+    // 1点あたりの計算量（Perlin はオクターブ数に比例）
+    auto cost = [&](int index) {
+        const NoiseNode& n = nodes[index];
+        return n.type == NoiseNodeType::Perlin ? (double)n.octaves : 1.0;
+    };
+
+    // 共有しない場合：出力から木として展開したときに各ノードが現れる回数で数える
+    // 追加順に入力が先なので、番号の大きい方から出現回数を入力へ配っていけばよい
+    std::vector<double> occurrences(nodes.size(), 0.0);
+    occurrences[canonical[output]] = 1.0;
+    for (int i = (int)nodes.size() - 1; i >= 0; i--) {
+        if (occurrences[i] == 0.0) continue;
+        result.naiveCost += occurrences[i] * cost(i);
+        for (int input : nodes[i].inputs) {
+            if (input >= 0) occurrences[input] += occurrences[i];
+        }
+    }
+
+    // 共有した場合：(座標の組, 代表ノード) ごとに1回だけ数える（座標の組の番号は評価のときと同じ付け方）
+    WarpContexts contexts;
+    std::set<std::pair<int, int>> visited;
+    std::set<int> unique;
+    std::vector<std::pair<int, int>> stack;
+    stack.emplace_back(-1, canonical[output]);
+    while (!stack.empty()) {
+        std::pair<int, int> item = stack.back();
+        stack.pop_back();
+        int context = item.first;
+        int index = item.second;
+        bool shared = sharingEnabled && useCount[index] > 1;
+        if (shared && !visited.insert(item).second) continue;
+
+        unique.insert(index);
+        result.sharedCost += cost(index);
+        const NoiseNode& n = nodes[index];
+        for (int i = 0; i < 3; i++) {
+            if (n.inputs[i] < 0) continue;
+            // Warp の source は Warp がずらした座標の組で評価される
+            int inputContext = (n.type == NoiseNodeType::Warp && i == 0) ? contexts.child(context, index) : context;
+            stack.emplace_back(inputContext, n.inputs[i]);
+        }
+    }
+
+    // 出力から辿れる、追加したままのノード（重複も含む）を数える
+    for (int i = 0; i < (int)nodes.size(); i++) {
+        if (occurrences[canonical[i]] > 0.0) result.nodes++;
+    }
+    result.uniqueNodes = (int)unique.size();
+    for (int index : unique) {
+        if (useCount[index] > 1) result.sharedNodes++;
+    }
+    return result;
+}
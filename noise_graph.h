@@ -0,0 +1,111 @@
+﻿// ノイズの合成グラフ
+// 複数のノイズ源を加算・乗算・切り詰め・選択・座標のゆがみ（ワープ）で組み合わせる
+// 評価はタイル単位で行い、途中の値はタイル大の小さな作業領域だけに置く（画像全体の中間バッファは作らない）
+// 同じ種類・同じ値・同じ入力のノードは追加時にまとめ、複数の枝から使われる部分はタイルごとに1回だけ評価する
+#pragma once
+
+#include <cstddef>  // size_t
+#include <cstdint>  // uint32_t
+#include <map>      // 同じノードを探す表
+#include <tuple>    // ノードの比較キー
+#include <vector>   // ベクタ型を使用するため
+
+#include "perlin.h" // パーリンノイズ本体
+
+struct TileScratch; // タイル評価用の作業領域（noise_graph.cpp）
+
+// ノードの種類
+enum class NoiseNodeType {
+    Perlin,     // パーリンノイズ（fBm）
+    Constant,   // 定数
+    Add,        // a + b
+    Multiply,   // a * b
+    ScaleBias,  // a * scale + bias
+    Clamp,      // a を [lower, upper] に切り詰める
+    Select,     // control が threshold 未満なら a、以上なら b（falloff の幅で滑らかにつなぐ）
+    Warp,       // source を (x + dx * strength, y + dy * strength) で評価する
+};
+
+// グラフのノード
+struct NoiseNode {
+    NoiseNodeType type = NoiseNodeType::Constant;
+    int inputs[3] = { -1, -1, -1 };  // 入力ノードの番号（種類ごとに使う数が違う）
+    float params[3] = { 0, 0, 0 };   // 種類ごとの値（周波数、定数、倍率など）
+    int octaves = 1;                 // Perlin のオクターブ数
+    int gradientIndex = -1;          // Perlin が使う勾配配列の番号
+};
+
+// 共通部分の共有でどれだけ計算が減ったかの報告
+struct NoiseGraphReport {
+    int nodes = 0;             // 出力から辿れるノードの数（追加した重複も含む）
+    int uniqueNodes = 0;       // 重複をまとめた後のノードの数
+    int sharedNodes = 0;       // 複数の枝から使われ、タイルごとに結果を使い回すノードの数
+    double naiveCost = 0.0;    // 共有しない場合の1点あたりの計算量（Perlin はオクターブ数、他は1）
+    double sharedCost = 0.0;   // 共有した場合の1点あたりの計算量
+};
+
+// ノイズの合成グラフ
+// ノードを追加すると番号が返り、それを他のノードの入力に使う
+// 入力は必ず先に追加したノードなので、グラフに循環はできない
+class NoiseGraph {
+public:
+    // パーリンノイズのノード
+    // frequency: 1ピクセルあたりの周波数（1 / グリッド間隔）
+    // octaves: 重ねるオクターブ数
+    // seed: 乱数の種（同じ種のノードは勾配配列を共有する）
+    int perlin(float frequency, int octaves, unsigned seed);
+
+    int constant(float value);
+    int add(int a, int b);
+    int multiply(int a, int b);
+    int scaleBias(int a, float scale, float bias);
+    int clamp(int a, float lower, float upper);
+    int select(int control, int a, int b, float threshold, float falloff);
+    int warp(int source, int dx, int dy, float strength);
+
+    // ノードの数と中身
+    int nodeCount() const { return (int)nodes.size(); }
+    const NoiseNode& node(int index) const { return nodes[index]; }
+
+    // 重複をまとめた代表ノードの番号（同じ計算をするノードは同じ番号になる）
+    int canonicalNode(int index) const { return canonical[index]; }
+
+    // 複数の枝から使われるノードの結果をタイルごとに使い回すかどうか（既定は true、比較用に切れる）
+    void setSubexpressionSharing(bool enabled) { sharingEnabled = enabled; }
+
+    // 出力ノードを評価するときに、共有でどれだけ計算が減るかを調べる
+    NoiseGraphReport report(int output) const;
+
+    // 出力ノードの値を矩形領域について求める
+    // output: 出力ノードの番号
+    // x0, y0: 左上のピクセル座標
+    // width, height: 矩形の大きさ
+    // out: 書き込み先（行 y の先頭は out + y * stride）
+    void evaluateTile(int output, int x0, int y0, int width, int height, float* out, size_t stride) const;
+
+    // 出力ノードの値を画像全体について求める（タイルごとに並列に評価する）
+    // tileSize: タイルの一辺（作業領域がキャッシュに収まる大きさにする）
+    // threadCount: スレッド数（0 以下なら論理プロセッサ数）
+    void render(int output, float* out, int width, int height, int tileSize = 64, int threadCount = 0) const;
+
+private:
+    // ノードを追加して番号を返す
+    int addNode(const NoiseNode& n);
+
+    // タイル内の点の集合について、ノードの値を out に求める（作業領域は scratch から借りる）
+    // context: 座標の組の識別子（タイルの座標なら -1、Warp の中では外側の組と Warp ノードから振った番号）
+    //          使い回す結果は同じ座標の組の中でだけ有効
+    void evaluateNode(int index, const float* xs, const float* ys, int count, float* out,
+        TileScratch& scratch, int context) const;
+
+    // ノードの比較キー（種類、入力、値のビット列、オクターブ数、勾配配列）
+    typedef std::tuple<int, int, int, int, uint32_t, uint32_t, uint32_t, int, int> NodeKey;
+
+    std::vector<NoiseNode> nodes;
+    std::vector<int> canonical;                // 各ノードの代表ノード
+    std::vector<int> useCount;                 // 代表ノードを入力に使う代表ノードの数
+    std::map<NodeKey, int> uniqueNodes;        // キー → 代表ノード
+    bool sharingEnabled = true;
+    std::vector<std::vector<float>> gradientTables;  // Perlin ノードが使う勾配配列（flattenGradients の形）
+    std::vector<unsigned> gradientSeeds;       // 各勾配配列の種
+};
@@ -0,0 +1,117 @@
+﻿// このファイルのループは gather を使うベクトル化が前提
+// GCC の -O2 の既定（very-cheap）ではベクトル化されないので、-O3 と同じ判断基準にする
+// また、FMA を持つ版（avx512f など）でも積和を1命令にまとめない（丸めが1回減って fbm2 と値が変わるため）
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("tree-vectorize", "vect-cost-model=dynamic", "fp-contract=off")
+#elif defined(__clang__)
+#pragma clang fp contract(off)
+#endif
+
+#include "noise_kernels.h"
+
+// 各命令セット版の中に展開させるための修飾（展開されないと既定の命令セットの1つだけになる）
+#if defined(__GNUC__) || defined(__clang__)
+#define KERNEL_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define KERNEL_INLINE __forceinline
+#else
+#define KERNEL_INLINE inline
+#endif
+
+// 分岐の無い floor（|v| < 2^31 の範囲で std::floor と同じ値）
+// std::floor の呼び出しがあると GCC は gather を使うベクトル化をしない
+static KERNEL_INLINE float floorFast(float v) {
+    int i = (int)v;
+    i -= v < (float)i;
+    return (float)i;
+}
+
+// 1行分のパーリンノイズを out に足し込む（amplitude 倍して加える）
+// multiplier: オクターブの周波数の倍率（2 の累乗なので座標は fbm2 と同じく正確に求まる）
+// 分岐を持たない形で書いてあるので、ループ全体がベクトル化される（勾配の読み込みは gather になる）
+static KERNEL_INLINE void accumulatePerlinRow(float* __restrict out, int count, int px0, int py, float scale,
+    float multiplier, float amplitude, const GradientTableView& table) {
+
+    const int periodCells = table.period;
+    const float period = (float)periodCells;
+    const int rowStride = (periodCells + 1) * 2;
+
+    // y はこの行で共通
+    float y = (float)py * scale * multiplier;
+    y = y - floorFast(y / period) * period;
+    int iy = (int)y;
+    float fy = y - (float)iy;
+    iy = iy >= periodCells ? 0 : iy;
+    float sy = fade(fy);
+    const float* __restrict row0 = table.data + (size_t)iy * rowStride;
+    const float* __restrict row1 = row0 + rowStride;
+
+    for (int i = 0; i < count; i++) {
+        float x = (float)(px0 + i) * scale * multiplier;
+        x = x - floorFast(x / period) * period;
+        int ix = (int)x;
+        float fx = x - (float)ix;
+
+        // 丸めで period ちょうどになった点は 0 に戻す（このとき fx は 0 なので整数側だけ直せばよい）
+        ix -= periodCells & -(int)(ix >= periodCells);
+        float sx = fade(fx);
+
+        int g = ix * 2;
+        float n0 = fx * row0[g] + fy * row0[g + 1];
+        float n1 = (fx - 1.0f) * row0[g + 2] + fy * row0[g + 3];
+        float n2 = fx * row1[g] + (fy - 1.0f) * row1[g + 1];
+        float n3 = (fx - 1.0f) * row1[g + 2] + (fy - 1.0f) * row1[g + 3];
+        out[i] += amplitude * lerp(lerp(n0, n1, sx), lerp(n2, n3, sx), sy);
+    }
+}
+
+static KERNEL_INLINE void fbm2RowBody(float* out, int count, int px0, int py, float scale, int octaves,
+    const GradientTableView& table) {
+
+    for (int i = 0; i < count; i++) out[i] = 0.0f;
+
+    float multiplier = 1.0f;
+    float amplitude = 1.0f;
+    for (int o = 0; o < octaves; o++) {
+        accumulatePerlinRow(out, count, px0, py, scale, multiplier, amplitude, table);
+        multiplier *= 2.0f;
+        amplitude *= 0.5f;
+    }
+
+    // fbm2 と同じく振幅の合計で割る（逆数を掛けると丸めが変わる）
+    float total = fbmAmplitudeSum(octaves);
+    if (octaves > 1) {
+        for (int i = 0; i < count; i++) out[i] /= total;
+    }
+}
+
+PERLIN_TARGET_CLONES
+void perlinRow(float* out, int count, int px0, int py, float scale, const GradientTableView& table) {
+    for (int i = 0; i < count; i++) out[i] = 0.0f;
+    accumulatePerlinRow(out, count, px0, py, scale, 1.0f, 1.0f, table);
+}
+
+PERLIN_TARGET_CLONES
+void fbm2Row(float* out, int count, int px0, int py, float scale, int octaves, const GradientTableView& table) {
+    fbm2RowBody(out, count, px0, py, scale, octaves, table);
+}
+
+void perlinRowBaseline(float* out, int count, int px0, int py, float scale, const GradientTableView& table) {
+    for (int i = 0; i < count; i++) out[i] = 0.0f;
+    accumulatePerlinRow(out, count, px0, py, scale, 1.0f, 1.0f, table);
+}
+
+void fbm2RowBaseline(float* out, int count, int px0, int py, float scale, int octaves,
+    const GradientTableView& table) {
+    fbm2RowBody(out, count, px0, py, scale, octaves, table);
+}
+
+const char* selectedKernelTarget() {
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__) && defined(__ELF__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return "avx512f";
+    if (__builtin_cpu_supports("avx2")) return "avx2";
+    if (__builtin_cpu_supports("sse4.1")) return "sse4.1";
+#endif
+    return "default";
+}
@@ -0,0 +1,32 @@
+﻿// 行単位のノイズ評価カーネル（平らな勾配配列を使う）
+// 1点ずつ関数を呼ぶ代わりに1行分をまとめて計算するので、コンパイラが自動ベクトル化できる
+// GCC / Clang（ELF）では同じカーネルを複数の命令セット向けにコンパイルし（target_clones）、
+// 起動時に CPU に合ったものが選ばれる。それ以外のコンパイラでは通常の1つだけになる
+#pragma once
+
+#include "perlin.h" // GradientTableView
+
+// 複数の命令セット向けにコンパイルする関数の修飾
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__) && defined(__ELF__)
+#define PERLIN_TARGET_CLONES __attribute__((target_clones("avx512f", "avx2", "sse4.1", "default")))
+#else
+#define PERLIN_TARGET_CLONES
+#endif
+
+// 1行分のパーリンノイズ（1オクターブ、perlinTable と同じ値）
+// out: 出力先（count 要素）
+// px0: 行の先頭のピクセルの x 座標
+// py: 行のピクセルの y 座標
+// scale: ピクセル座標からノイズ空間への倍率（1 / グリッド間隔）
+void perlinRow(float* out, int count, int px0, int py, float scale, const GradientTableView& table);
+
+// 1行分の fBm（fbm2 / fbm2Table と同じ値。ビット単位で一致する）
+void fbm2Row(float* out, int count, int px0, int py, float scale, int octaves, const GradientTableView& table);
+
+// 比較用：同じカーネルを命令セットの指定なし（既定のターゲット）でコンパイルしたもの
+void perlinRowBaseline(float* out, int count, int px0, int py, float scale, const GradientTableView& table);
+void fbm2RowBaseline(float* out, int count, int px0, int py, float scale, int octaves,
+    const GradientTableView& table);
+
+// target_clones で選ばれる命令セットの名前（"avx512f" など、複数版を持たない場合は "default"）
+const char* selectedKernelTarget();
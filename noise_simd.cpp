@@ -0,0 +1,100 @@
+﻿#include "noise_simd.h"
+
+#if defined(_MSC_VER) && defined(SIMD_X86)
+#include <intrin.h>  // __cpuidex, _xgetbv
+#endif
+
+void fbm2RowScalar(float* out, int count, int px0, int py, float scale, int octaves, const GradientTableView& table) {
+    fbmRowSimd<SimdScalar, TablePerlinEvaluator>(out, count, px0, py, scale, octaves, table);
+}
+
+void fbm2BlockScalar(float* out, int width, int height, size_t stride, int px0, int py0, float scale, int octaves,
+    const GradientTableView& table, int prefetchRows) {
+    fbmBlockSimd<SimdScalar>(out, width, height, stride, px0, py0, scale, octaves, table, prefetchRows);
+}
+
+void fbm2HashedRowScalar(float* out, int count, int px0, int py, float scale, int octaves, const HashedNoise& noise) {
+    fbmRowSimd<SimdScalar, HashedPerlinEvaluator>(out, count, px0, py, scale, octaves, noise);
+}
+
+static SimdLevel querySimdLevel() {
+#if defined(SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return SimdLevel::Avx512;
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::Avx2;
+    if (__builtin_cpu_supports("sse4.1")) return SimdLevel::Sse41;
+    if (__builtin_cpu_supports("sse2")) return SimdLevel::Sse2;
+#elif defined(SIMD_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, 1, 0);
+    bool sse2 = (info[3] & (1 << 26)) != 0;
+    bool sse41 = (info[2] & (1 << 19)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+
+    // OS が YMM / ZMM レジスタを保存するか（XCR0）
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    bool ymm = avx && (xcr0 & 0x6) == 0x6;
+    bool zmm = ymm && (xcr0 & 0xE0) == 0xE0;
+
+    __cpuidex(info, 7, 0);
+    bool avx2 = ymm && (info[1] & (1 << 5)) != 0;
+    bool avx512f = zmm && (info[1] & (1 << 16)) != 0;
+    if (avx512f) return SimdLevel::Avx512;
+    if (avx2) return SimdLevel::Avx2;
+    if (sse41) return SimdLevel::Sse41;
+    if (sse2) return SimdLevel::Sse2;
+#endif
+    return SimdLevel::Scalar;
+}
+
+SimdLevel detectSimdLevel() {
+    // 初回の呼び出しで1回だけ調べる（静的変数の初期化はスレッド安全）
+    static const SimdLevel level = querySimdLevel();
+    return level;
+}
+
+Fbm2RowKernel selectFbm2RowKernel(const char** name) {
+    const char* selected = "scalar";
+    Fbm2RowKernel kernel = fbm2RowScalar;
+#if defined(SIMD_X86)
+    switch (detectSimdLevel()) {
+    case SimdLevel::Avx512: selected = "avx512f"; kernel = fbm2RowAvx512; break;
+    case SimdLevel::Avx2:   selected = "avx2";    kernel = fbm2RowAvx2;   break;
+    case SimdLevel::Sse41:  selected = "sse4.1";  kernel = fbm2RowSse41;  break;
+    case SimdLevel::Sse2:   selected = "sse2";    kernel = fbm2RowSse2;   break;
+    default: break;
+    }
+#endif
+    if (name) *name = selected;
+    return kernel;
+}
+
+void fbm2RowPortable(float* out, int count, int px0, int py, float scale, int octaves,
+    const GradientTableView& table) {
+    // 初回の呼び出しで1回だけ選ぶ（静的変数の初期化はスレッド安全）
+    static const Fbm2RowKernel kernel = selectFbm2RowKernel();
+    kernel(out, count, px0, py, scale, octaves, table);
+}
+
+Fbm2BlockKernel selectFbm2BlockKernel(const char** name) {
+    const char* selected = "scalar";
+    Fbm2BlockKernel kernel = fbm2BlockScalar;
+#if defined(SIMD_X86)
+    switch (detectSimdLevel()) {
+    case SimdLevel::Avx512: selected = "avx512f"; kernel = fbm2BlockAvx512; break;
+    case SimdLevel::Avx2:   selected = "avx2";    kernel = fbm2BlockAvx2;   break;
+    case SimdLevel::Sse41:  selected = "sse4.1";  kernel = fbm2BlockSse41;  break;
+    case SimdLevel::Sse2:   selected = "sse2";    kernel = fbm2BlockSse2;   break;
+    default: break;
+    }
+#endif
+    if (name) *name = selected;
+    return kernel;
+}
+
+void fbm2BlockPortable(float* out, int width, int height, size_t stride, int px0, int py0, float scale, int octaves,
+    const GradientTableView& table, int prefetchRows) {
+    static const Fbm2BlockKernel kernel = selectFbm2BlockKernel();
+    kernel(out, width, height, stride, px0, py0, scale, octaves, table, prefetchRows);
+}
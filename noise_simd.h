@@ -0,0 +1,333 @@
+﻿// simd.h のラッパーで1回だけ書いた行単位の fBm カーネル
+// 命令セットごとの実体は noise_simd_sse2.cpp / noise_simd_sse41.cpp / noise_simd_avx2.cpp / noise_simd_avx512.cpp にあり、
+// fbm2RowPortable が実行中の CPU で使える最も幅の広いものを選ぶ
+// 値は fbm2 / fbm2RowBaseline（noise_kernels.h）とビット単位で同じになる
+// （命令セットごとの翻訳単位では積和を FMA にまとめないようにしてあり、正規化も fbm2 と同じく割り算で行う）
+//
+// 勾配を表から読む版のほかに、格子座標のハッシュで 32 方向の固定勾配から選ぶ版（fbm2HashedRow*）もある
+// 固定勾配はレジスタ2本に収まるので、AVX-512 ではメモリの gather の代わりに vpermi2ps で引ける
+#pragma once
+
+#include <cstddef>  // size_t
+
+#include "perlin.h" // GradientTableView, fade
+#include "simd.h"   // SimdScalar ほか
+
+// 行単位のカーネルの型（引数は fbm2Row と同じ）
+typedef void (*Fbm2RowKernel)(float* out, int count, int px0, int py, float scale, int octaves,
+    const GradientTableView& table);
+
+// 命令セットごとの実体（使えない命令セットのものを呼んではいけない）
+void fbm2RowScalar(float* out, int count, int px0, int py, float scale, int octaves, const GradientTableView& table);
+#if defined(SIMD_X86)
+void fbm2RowSse2(float* out, int count, int px0, int py, float scale, int octaves, const GradientTableView& table);
+void fbm2RowSse41(float* out, int count, int px0, int py, float scale, int octaves, const GradientTableView& table);
+void fbm2RowAvx2(float* out, int count, int px0, int py, float scale, int octaves, const GradientTableView& table);
+void fbm2RowAvx512(float* out, int count, int px0, int py, float scale, int octaves, const GradientTableView& table);
+#endif
+
+// 矩形（タイル）単位のカーネルの型
+// out: 出力先（行 y の先頭は out + y * stride）
+// px0, py0: 左上のピクセル座標
+// prefetchRows: 何ピクセル行先で使う勾配の行を先読みするか（0 以下なら先読みしない）
+typedef void (*Fbm2BlockKernel)(float* out, int width, int height, size_t stride, int px0, int py0, float scale,
+    int octaves, const GradientTableView& table, int prefetchRows);
+
+// 先読みの距離の既定値（ピクセル行、bench prefetch で決めた値）
+const int GRADIENT_PREFETCH_ROWS = 4;
+
+// 矩形単位の命令セットごとの実体
+// 行ごとに fbm2Row* と同じ値を求め、その間に prefetchRows 行先のセルの行の勾配を先読みしておく
+void fbm2BlockScalar(float* out, int width, int height, size_t stride, int px0, int py0, float scale, int octaves,
+    const GradientTableView& table, int prefetchRows);
+#if defined(SIMD_X86)
+void fbm2BlockSse2(float* out, int width, int height, size_t stride, int px0, int py0, float scale, int octaves,
+    const GradientTableView& table, int prefetchRows);
+void fbm2BlockSse41(float* out, int width, int height, size_t stride, int px0, int py0, float scale, int octaves,
+    const GradientTableView& table, int prefetchRows);
+void fbm2BlockAvx2(float* out, int width, int height, size_t stride, int px0, int py0, float scale, int octaves,
+    const GradientTableView& table, int prefetchRows);
+void fbm2BlockAvx512(float* out, int width, int height, size_t stride, int px0, int py0, float scale, int octaves,
+    const GradientTableView& table, int prefetchRows);
+#endif
+
+// ハッシュで勾配を選ぶノイズの設定
+struct HashedNoise {
+    int period = 256;   // 周期（格子座標をこの値で折り返してからハッシュする）
+    unsigned seed = 0;  // 乱数の種
+};
+
+// ハッシュ版の行単位のカーネルの型
+typedef void (*Fbm2HashedRowKernel)(float* out, int count, int px0, int py, float scale, int octaves,
+    const HashedNoise& noise);
+
+// ハッシュ版の命令セットごとの実体
+// Avx512 は固定勾配を vpermi2ps で引き、Avx512Gather は同じ計算を gather で引く（比較用）
+void fbm2HashedRowScalar(float* out, int count, int px0, int py, float scale, int octaves, const HashedNoise& noise);
+#if defined(SIMD_X86)
+void fbm2HashedRowAvx2(float* out, int count, int px0, int py, float scale, int octaves, const HashedNoise& noise);
+void fbm2HashedRowAvx512(float* out, int count, int px0, int py, float scale, int octaves, const HashedNoise& noise);
+void fbm2HashedRowAvx512Gather(float* out, int count, int px0, int py, float scale, int octaves,
+    const HashedNoise& noise);
+#endif
+
+// CPU と OS が対応している命令セット（後のものほど幅が広い）
+enum class SimdLevel { Scalar, Sse2, Sse41, Avx2, Avx512 };
+
+// 実行中の CPU で使える最も幅の広い命令セット（初回に調べた結果を返す）
+SimdLevel detectSimdLevel();
+
+// 実行中の CPU で使える最も幅の広いカーネルを返す
+// name: 選んだ命令セットの名前を受け取る（不要なら nullptr）
+Fbm2RowKernel selectFbm2RowKernel(const char** name = nullptr);
+
+// 選んだカーネルで1行分の fBm を求める
+void fbm2RowPortable(float* out, int count, int px0, int py, float scale, int octaves,
+    const GradientTableView& table);
+
+// 実行中の CPU で使える最も幅の広い矩形単位のカーネルを返す
+Fbm2BlockKernel selectFbm2BlockKernel(const char** name = nullptr);
+
+// 選んだカーネルで矩形の fBm を求める
+void fbm2BlockPortable(float* out, int width, int height, size_t stride, int px0, int py0, float scale, int octaves,
+    const GradientTableView& table, int prefetchRows = GRADIENT_PREFETCH_ROWS);
+
+// 先読みの距離を付けた勾配配列（矩形単位のカーネルが TablePerlinEvaluator に渡す）
+struct PrefetchedGradientTable {
+    GradientTableView table;
+    int prefetchRows = 0;  // 何ピクセル行先で使う勾配の行を先読みするか
+};
+
+// 1行分の計算で共通の値
+struct PerlinRowSetup {
+    const float* row0;   // セルの上辺の勾配の行
+    const float* row1;   // セルの下辺の勾配の行
+    float fy;            // セル内の y
+    float sy;            // fade(fy)
+    float scale;         // ピクセル座標からノイズ空間への倍率
+    float multiplier;    // オクターブの周波数の倍率
+    int periodCells;     // 周期
+};
+
+// y 座標とオクターブから行の共通の値を求める
+// （命令セットごとの翻訳単位で別々の実体になるよう内部リンケージにしておく）
+static inline PerlinRowSetup makePerlinRowSetup(int py, float scale, float multiplier, const GradientTableView& table) {
+    PerlinRowSetup r;
+    const float period = (float)table.period;
+    float y = (float)py * scale * multiplier;
+    y = y - std::floor(y / period) * period;
+    int iy = (int)y;
+    r.fy = y - (float)iy;
+    if (iy >= table.period) iy = 0;
+    r.row0 = table.data + (size_t)iy * (table.period + 1) * 2;
+    r.row1 = r.row0 + (table.period + 1) * 2;
+    r.sy = fade(r.fy);
+    r.scale = scale;
+    r.multiplier = multiplier;
+    r.periodCells = table.period;
+    return r;
+}
+
+// 勾配を表から読むパーリンノイズ（1オクターブ）を WIDTH 点ずつ求める
+// S: simd.h の命令セットの型
+template <class S>
+struct TablePerlinEvaluator {
+    typedef typename S::F F;
+    typedef typename S::I I;
+
+    PerlinRowSetup r;
+    const float* prefetchRow;  // 先読みする勾配の行（無ければ nullptr）
+
+    SIMD_INLINE TablePerlinEvaluator(const GradientTableView& table, int py, float scale, float multiplier)
+        : r(makePerlinRowSetup(py, scale, multiplier, table)), prefetchRow(nullptr) {}
+
+    // prefetchRows 行先のピクセル行が使うセルの下辺の行が今の2行と違えば、その行を先読みの対象にする
+    // （上辺の行はそれより前のピクセル行で下辺として先読みしてある）
+    SIMD_INLINE TablePerlinEvaluator(const PrefetchedGradientTable& source, int py, float scale, float multiplier)
+        : r(makePerlinRowSetup(py, scale, multiplier, source.table)), prefetchRow(nullptr) {
+        if (source.prefetchRows > 0) {
+            const float* ahead = makePerlinRowSetup(py + source.prefetchRows, scale, multiplier, source.table).row1;
+            if (ahead != r.row0 && ahead != r.row1) prefetchRow = ahead;
+        }
+    }
+
+    // ピクセル px, px + 1, ..., px + WIDTH - 1 の値
+    SIMD_INLINE F operator()(int px) const {
+        if (prefetchRow) {
+            // 先頭の点のセルの勾配を先読みする（同じキャッシュラインへの重複は安い）
+            const float period = (float)r.periodCells;
+            float x = (float)px * r.scale * r.multiplier;
+            x = x - std::floor(x / period) * period;
+            simdPrefetch(prefetchRow + (size_t)(int)x * 2);
+        }
+
+        const F period((float)r.periodCells);
+        const F one(1.0f);
+        const F fy(r.fy);
+        const F fy1 = fy - one;
+
+        // 座標を周期で折り返す（丸めで period ちょうどになった点は格子 0 に戻す）
+        F x = S::toFloat(S::indices(px)) * F(r.scale) * F(r.multiplier);
+        x = x - S::floor(x / period) * period;
+        I ix = S::truncate(x);
+        F fx = x - S::toFloat(ix);
+        ix = S::wrapIndex(ix, r.periodCells);
+        F fx1 = fx - one;
+
+        // 4隅の勾配との内積
+        I g = ix + ix;
+        F n0 = fx * S::gather(r.row0, g) + fy * S::gather(r.row0 + 1, g);
+        F n1 = fx1 * S::gather(r.row0 + 2, g) + fy * S::gather(r.row0 + 3, g);
+        F n2 = fx * S::gather(r.row1, g) + fy1 * S::gather(r.row1 + 1, g);
+        F n3 = fx1 * S::gather(r.row1 + 2, g) + fy1 * S::gather(r.row1 + 3, g);
+
+        // fade と lerp（perlin.h と同じ式）
+        F sx = fx * fx * fx * (fx * (fx * F(6.0f) - F(15.0f)) + F(10.0f));
+        F top = n0 + sx * (n1 - n0);
+        F bottom = n2 + sx * (n3 - n2);
+        return top + F(r.sy) * (bottom - top);
+    }
+};
+
+// ハッシュ版の固定勾配（単位円を 32 等分した方向）
+static const float HASHED_GRADIENT_X[32] = {
+    1.000000000f, 0.980785280f, 0.923879533f, 0.831469612f, 0.707106781f, 0.555570233f, 0.382683432f, 0.195090322f,
+    0.000000000f, -0.195090322f, -0.382683432f, -0.555570233f, -0.707106781f, -0.831469612f, -0.923879533f, -0.980785280f,
+    -1.000000000f, -0.980785280f, -0.923879533f, -0.831469612f, -0.707106781f, -0.555570233f, -0.382683432f, -0.195090322f,
+    0.000000000f, 0.195090322f, 0.382683432f, 0.555570233f, 0.707106781f, 0.831469612f, 0.923879533f, 0.980785280f,
+};
+static const float HASHED_GRADIENT_Y[32] = {
+    0.000000000f, 0.195090322f, 0.382683432f, 0.555570233f, 0.707106781f, 0.831469612f, 0.923879533f, 0.980785280f,
+    1.000000000f, 0.980785280f, 0.923879533f, 0.831469612f, 0.707106781f, 0.555570233f, 0.382683432f, 0.195090322f,
+    0.000000000f, -0.195090322f, -0.382683432f, -0.555570233f, -0.707106781f, -0.831469612f, -0.923879533f, -0.980785280f,
+    -1.000000000f, -0.980785280f, -0.923879533f, -0.831469612f, -0.707106781f, -0.555570233f, -0.382683432f, -0.195090322f,
+};
+
+// ハッシュに使う乗数
+const int HASH_PRIME_X = (int)0x8da6b343u;
+const int HASH_PRIME_Y = (int)0xd8163841u;
+const int HASH_PRIME_SEED = (int)0xcb1ab31fu;
+const int HASH_MIX = (int)0x9e3779b1u;
+
+// 格子座標のハッシュで固定勾配を選ぶパーリンノイズ（1オクターブ）を WIDTH 点ずつ求める
+template <class S>
+struct HashedPerlinEvaluator {
+    typedef typename S::F F;
+    typedef typename S::I I;
+
+    typename S::Table32 gradientX;  // 固定勾配（AVX-512 ではレジスタに置く）
+    typename S::Table32 gradientY;
+    int rowHash0;     // セルの上辺の y と種のハッシュ
+    int rowHash1;     // セルの下辺の y と種のハッシュ
+    float fy;
+    float sy;
+    float scale;
+    float multiplier;
+    int periodCells;
+
+    SIMD_INLINE HashedPerlinEvaluator(const HashedNoise& noise, int py, float scale, float multiplier)
+        : gradientX(S::loadTable32(HASHED_GRADIENT_X)), gradientY(S::loadTable32(HASHED_GRADIENT_Y)),
+          scale(scale), multiplier(multiplier), periodCells(noise.period) {
+
+        const float period = (float)noise.period;
+        float y = (float)py * scale * multiplier;
+        y = y - std::floor(y / period) * period;
+        int iy = (int)y;
+        fy = y - (float)iy;
+        if (iy >= noise.period) iy = 0;
+        int iy1 = iy + 1 >= noise.period ? 0 : iy + 1;
+        sy = fade(fy);
+
+        int seedHash = (int)(noise.seed * (unsigned)HASH_PRIME_SEED);
+        rowHash0 = (int)((unsigned)iy * (unsigned)HASH_PRIME_Y) ^ seedHash;
+        rowHash1 = (int)((unsigned)iy1 * (unsigned)HASH_PRIME_Y) ^ seedHash;
+    }
+
+    // 列のハッシュと行のハッシュから 0〜31 の勾配番号を作る
+    static SIMD_INLINE I gradientIndex(I columnHash, int rowHash) {
+        I h = S::xorInt(columnHash, I(rowHash));
+        h = S::xorInt(h, S::shiftRight(h, 13));
+        h = S::mulInt(h, HASH_MIX);
+        h = S::xorInt(h, S::shiftRight(h, 16));
+        return S::andInt(h, 31);
+    }
+
+    // ピクセル px, px + 1, ..., px + WIDTH - 1 の値
+    SIMD_INLINE F operator()(int px) const {
+        const F period((float)periodCells);
+        const F one(1.0f);
+        const F vfy(fy);
+        const F fy1 = vfy - one;
+
+        F x = S::toFloat(S::indices(px)) * F(scale) * F(multiplier);
+        x = x - S::floor(x / period) * period;
+        I ix = S::truncate(x);
+        F fx = x - S::toFloat(ix);
+        ix = S::wrapIndex(ix, periodCells);
+        I ix1 = S::wrapIndex(ix + I(1), periodCells);
+        F fx1 = fx - one;
+
+        I column0 = S::mulInt(ix, HASH_PRIME_X);
+        I column1 = S::mulInt(ix1, HASH_PRIME_X);
+        I g00 = gradientIndex(column0, rowHash0);
+        I g10 = gradientIndex(column1, rowHash0);
+        I g01 = gradientIndex(column0, rowHash1);
+        I g11 = gradientIndex(column1, rowHash1);
+
+        F n0 = fx * S::lookup32(gradientX, g00) + vfy * S::lookup32(gradientY, g00);
+        F n1 = fx1 * S::lookup32(gradientX, g10) + vfy * S::lookup32(gradientY, g10);
+        F n2 = fx * S::lookup32(gradientX, g01) + fy1 * S::lookup32(gradientY, g01);
+        F n3 = fx1 * S::lookup32(gradientX, g11) + fy1 * S::lookup32(gradientY, g11);
+
+        F sx = fx * fx * fx * (fx * (fx * F(6.0f) - F(15.0f)) + F(10.0f));
+        F top = n0 + sx * (n1 - n0);
+        F bottom = n2 + sx * (n3 - n2);
+        return top + F(sy) * (bottom - top);
+    }
+};
+
+// 1行分の fBm（本体）
+// Evaluator: 1オクターブ分を WIDTH 点ずつ求める型（TablePerlinEvaluator など）
+// 端数の点は WIDTH 要素の一時領域で1回分として計算する（命令セットの版ごとに閉じるように SimdScalar は使わない）
+template <class S, template <class> class Evaluator, class Source>
+SIMD_INLINE void fbmRowSimd(float* out, int count, int px0, int py, float scale, int octaves, const Source& source) {
+    typedef typename S::F F;
+    const int vectorEnd = count - count % S::WIDTH;
+    for (int i = 0; i < count; i++) out[i] = 0.0f;
+
+    float multiplier = 1.0f;
+    float amplitude = 1.0f;
+    for (int o = 0; o < octaves; o++) {
+        const Evaluator<S> evaluate(source, py, scale, multiplier);
+        const F vAmplitude(amplitude);
+        for (int i = 0; i < vectorEnd; i += S::WIDTH) {
+            S::store(out + i, S::load(out + i) + vAmplitude * evaluate(px0 + i));
+        }
+        if (vectorEnd < count) {
+            float tail[S::WIDTH] = {};
+            for (int i = vectorEnd; i < count; i++) tail[i - vectorEnd] = out[i];
+            S::store(tail, S::load(tail) + vAmplitude * evaluate(px0 + vectorEnd));
+            for (int i = vectorEnd; i < count; i++) out[i] = tail[i - vectorEnd];
+        }
+        multiplier *= 2.0f;
+        amplitude *= 0.5f;
+    }
+
+    if (octaves > 1) {
+        float total = fbmAmplitudeSum(octaves);
+        for (int i = 0; i < count; i++) out[i] /= total;
+    }
+}
+
+// 矩形の fBm（本体）
+// 各行を fbmRowSimd で求め、prefetchRows 行先で使う勾配の行を同じ x の位置で先読みする
+template <class S>
+SIMD_INLINE void fbmBlockSimd(float* out, int width, int height, size_t stride, int px0, int py0, float scale,
+    int octaves, const GradientTableView& table, int prefetchRows) {
+    PrefetchedGradientTable source;
+    source.table = table;
+    source.prefetchRows = prefetchRows;
+    for (int y = 0; y < height; y++) {
+        fbmRowSimd<S, TablePerlinEvaluator>(out + (size_t)y * stride, width, px0, py0 + y, scale, octaves, source);
+    }
+}
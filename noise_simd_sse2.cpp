@@ -0,0 +1,41 @@
+﻿// noise_simd.h のカーネルの SSE2 版
+// このファイルの関数だけを SSE2 向けにコンパイルする（呼び出し側が CPU の対応を確かめてから使う）
+//
+// 共有するインライン関数（perlin.h など）は命令セットの指定より前に読み込み、既定の命令セットのままにしておく
+// 指定の後に定義されるのはこの命令セット専用のテンプレートの実体だけになる
+#include <cmath>      // std::floor
+#include <cstddef>    // size_t
+
+#include "perlin.h"   // GradientTableView, fade
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sse2"))), apply_to = function)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#define SIMD_ENABLE_SSE2
+#include "noise_simd.h"
+
+void fbm2RowSse2(float* out, int count, int px0, int py, float scale, int octaves, const GradientTableView& table) {
+    fbmRowSimd<SimdSse2, TablePerlinEvaluator>(out, count, px0, py, scale, octaves, table);
+}
+
+void fbm2BlockSse2(float* out, int width, int height, size_t stride, int px0, int py0, float scale, int octaves,
+    const GradientTableView& table, int prefetchRows) {
+    fbmBlockSimd<SimdSse2>(out, width, height, stride, px0, py0, scale, octaves, table, prefetchRows);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
@@ -0,0 +1,41 @@
+﻿// 簡易な並列実行ヘルパー（std::thread のみを使用）
+#pragma once
+
+#include <atomic>   // 作業番号の取り合いに使用
+#include <thread>   // std::thread
+#include <vector>   // スレッドの保持
+
+// 使用するスレッド数を決める
+// requested: 希望するスレッド数（0 以下なら論理プロセッサ数）
+// 戻り値: 1 以上のスレッド数
+inline int resolveThreadCount(int requested) {
+    if (requested > 0) return requested;
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw > 0 ? (int)hw : 1;
+}
+
+// 0〜count-1 の番号を複数スレッドで分担して func(番号) を呼ぶ
+// 番号は早い者勝ちで配るので、処理時間にばらつきがあっても偏りにくい
+// count: 作業の数
+// threadCount: スレッド数（0 以下なら論理プロセッサ数）
+// func: void(int) の呼び出し可能オブジェクト
+template <class Func>
+void parallelFor(int count, int threadCount, Func func) {
+    int n = resolveThreadCount(threadCount);
+    if (n > count) n = count;
+    if (n <= 1) {
+        for (int i = 0; i < count; i++) func(i);
+        return;
+    }
+
+    std::atomic<int> next(0);
+    auto worker = [&]() {
+        for (int i = next++; i < count; i = next++) func(i);
+    };
+
+    // 呼び出し元のスレッドも作業に参加する
+    std::vector<std::thread> threads;
+    for (int t = 1; t < n; t++) threads.emplace_back(worker);
+    worker();
+    for (auto& th : threads) th.join();
+}
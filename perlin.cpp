@@ -0,0 +1,340 @@
+﻿#include "perlin.h"
+
+#include <cmath>    // 数学関数（sin, cos など）用
+
+float dotGridGradient(int ix, int iy, float x, float y, const GradientGrid& gradients) {
+
+    // 点とグリッドの差分（距離ベクトル）
+    float dx = x - ix;
+    float dy = y - iy;
+
+    // 勾配ベクトルの取得（ランダムに与えられている）
+    auto grad = gradients[iy][ix];
+
+    // 距離ベクトルと勾配ベクトルの内積
+    return dx * grad.first + dy * grad.second;
+}
+
+float perlin(float x, float y, const GradientGrid& gradients) {
+
+    // 対象座標の左上整数グリッド
+    int x0 = (int)x;
+    int y0 = (int)y;
+
+    // 右隣・下隣のグリッド
+    int x1 = x0 + 1;
+    int y1 = y0 + 1;
+
+    // 小数部分を補間パラメータにする（S字補間に備える）
+    float sx = fade(x - x0);
+    float sy = fade(y - y0);
+
+    // 4つのグリッド点に対する内積計算
+    float n0 = dotGridGradient(x0, y0, x, y, gradients);
+    float n1 = dotGridGradient(x1, y0, x, y, gradients);
+    float ix0 = lerp(n0, n1, sx); // 上辺補間
+
+    float n2 = dotGridGradient(x0, y1, x, y, gradients);
+    float n3 = dotGridGradient(x1, y1, x, y, gradients);
+    float ix1 = lerp(n2, n3, sx); // 下辺補間
+
+    // 上下を補間して最終ノイズ値にする
+    return lerp(ix0, ix1, sy);
+}
+
+std::pair<float, float> randomGradient(std::mt19937& gen) {
+    std::uniform_real_distribution<float> dist(0.0f, 2.0f * 3.1415926f);
+    float angle = dist(gen); // 0〜2πのランダム角度
+    return { std::cos(angle), std::sin(angle) }; // 単位ベクトル
+}
+
+GradientGrid makeGradients(int gridW, int gridH, unsigned seed) {
+    // 乱数生成器（種を固定すれば毎回同じパターンに）
+    std::mt19937 rng(seed);
+
+    GradientGrid gradients(gridH, std::vector<std::pair<float, float>>(gridW));
+    for (int y = 0; y < gridH; y++) {
+        for (int x = 0; x < gridW; x++) {
+            gradients[y][x] = randomGradient(rng);
+        }
+    }
+    return gradients;
+}
+
+void generateHeightmap(float* out, int width, int height, int gridSize,
+    const GradientGrid& gradients) {
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            // 現在のピクセルをノイズ空間に正規化（グリッドサイズで割る）
+            float fx = (float)x / gridSize;
+            float fy = (float)y / gridSize;
+
+            out[y * width + x] = perlin(fx, fy, gradients);
+        }
+    }
+}
+
+Gradient3 randomGradient3(std::mt19937& gen) {
+    // z を一様に選び、残りを円周上の角度で決めると球面上で一様になる
+    std::uniform_real_distribution<float> distZ(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> distAngle(0.0f, 2.0f * 3.1415926f);
+    float z = distZ(gen);
+    float angle = distAngle(gen);
+    float r = std::sqrt(1.0f - z * z);
+    return { r * std::cos(angle), r * std::sin(angle), z };
+}
+
+GradientVolume makeGradientVolume(int width, int height, int depth, unsigned seed) {
+    std::mt19937 rng(seed);
+
+    GradientVolume volume;
+    volume.width = width;
+    volume.height = height;
+    volume.depth = depth;
+    volume.gradients.resize((size_t)width * height * depth);
+    for (auto& g : volume.gradients) {
+        g = randomGradient3(rng);
+    }
+    return volume;
+}
+
+// 周期 n で折り返したグリッド座標（負の値にも対応）
+static int wrapIndex(int i, int n) {
+    int r = i % n;
+    return r < 0 ? r + n : r;
+}
+
+// 3D版のドット積計算（グリッド座標は周期で折り返して勾配を引く）
+static float dotGridGradient3(int ix, int iy, int iz, float x, float y, float z,
+    const GradientVolume& volume) {
+
+    const Gradient3& g = volume.gradients[
+        ((size_t)wrapIndex(iz, volume.depth) * volume.height + wrapIndex(iy, volume.height))
+        * volume.width + wrapIndex(ix, volume.width)];
+    return (x - ix) * g.x + (y - iy) * g.y + (z - iz) * g.z;
+}
+
+float perlin3(float x, float y, float z, const GradientVolume& volume) {
+
+    // 対象座標を囲むグリッド（負の座標でも正しく切り捨てる）
+    int x0 = (int)std::floor(x);
+    int y0 = (int)std::floor(y);
+    int z0 = (int)std::floor(z);
+    int x1 = x0 + 1;
+    int y1 = y0 + 1;
+    int z1 = z0 + 1;
+
+    float sx = fade(x - x0);
+    float sy = fade(y - y0);
+    float sz = fade(z - z0);
+
+    // 手前の面（z0）で2D と同じ補間
+    float a0 = lerp(dotGridGradient3(x0, y0, z0, x, y, z, volume),
+                    dotGridGradient3(x1, y0, z0, x, y, z, volume), sx);
+    float a1 = lerp(dotGridGradient3(x0, y1, z0, x, y, z, volume),
+                    dotGridGradient3(x1, y1, z0, x, y, z, volume), sx);
+    float front = lerp(a0, a1, sy);
+
+    // 奥の面（z1）
+    float b0 = lerp(dotGridGradient3(x0, y0, z1, x, y, z, volume),
+                    dotGridGradient3(x1, y0, z1, x, y, z, volume), sx);
+    float b1 = lerp(dotGridGradient3(x0, y1, z1, x, y, z, volume),
+                    dotGridGradient3(x1, y1, z1, x, y, z, volume), sx);
+    float back = lerp(b0, b1, sy);
+
+    // 2つの面を z 方向に補間
+    return lerp(front, back, sz);
+}
+
+float fbm3Octaves(float x, float y, float z, int firstOctave, int octaveCount,
+    const GradientVolume& volume) {
+
+    // 最初のオクターブの周波数と振幅
+    float frequency = (float)(1 << firstOctave);
+    float amplitude = 1.0f / frequency;
+
+    float sum = 0.0f;
+    for (int o = 0; o < octaveCount; o++) {
+        sum += amplitude * perlin3(x * frequency, y * frequency, z * frequency, volume);
+
+        // 次のオクターブは周波数2倍・振幅半分
+        frequency *= 2.0f;
+        amplitude *= 0.5f;
+    }
+    return sum;
+}
+
+float fbmAmplitudeSum(int octaves) {
+    // 1 + 1/2 + 1/4 + ... （octaves 項）
+    return octaves > 0 ? 2.0f - 2.0f / (float)(1 << octaves) : 0.0f;
+}
+
+float fbm3(float x, float y, float z, int octaves, const GradientVolume& volume) {
+    float total = fbmAmplitudeSum(octaves);
+    return total > 0.0f ? fbm3Octaves(x, y, z, 0, octaves, volume) / total : 0.0f;
+}
+
+Gradient4 randomGradient4(std::mt19937& gen) {
+    // 正規分布の4成分を正規化すると4次元球面上で一様になる
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    for (;;) {
+        Gradient4 g = { dist(gen), dist(gen), dist(gen), dist(gen) };
+        float length = std::sqrt(g.x * g.x + g.y * g.y + g.z * g.z + g.w * g.w);
+        if (length < 1e-6f) continue; // ほぼ零ベクトルは向きが定まらないので引き直す
+        return { g.x / length, g.y / length, g.z / length, g.w / length };
+    }
+}
+
+GradientHypervolume makeGradientHypervolume(int sizeX, int sizeY, int sizeZ, int sizeW, unsigned seed) {
+    std::mt19937 rng(seed);
+
+    GradientHypervolume volume;
+    volume.size[0] = sizeX;
+    volume.size[1] = sizeY;
+    volume.size[2] = sizeZ;
+    volume.size[3] = sizeW;
+    volume.gradients.resize((size_t)sizeX * sizeY * sizeZ * sizeW);
+    for (auto& g : volume.gradients) {
+        g = randomGradient4(rng);
+    }
+    return volume;
+}
+
+float perlin4(float x, float y, float z, float w, const GradientHypervolume& volume) {
+    const float p[4] = { x, y, z, w };
+
+    // 各方向について、囲むグリッド2点の（折り返し済み）番号・距離・補間係数を求める
+    int index[4][2];
+    float delta[4][2];
+    float s[4];
+    for (int d = 0; d < 4; d++) {
+        int i0 = (int)std::floor(p[d]);
+        index[d][0] = wrapIndex(i0, volume.size[d]);
+        index[d][1] = wrapIndex(i0 + 1, volume.size[d]);
+        delta[d][0] = p[d] - i0;
+        delta[d][1] = delta[d][0] - 1.0f;
+        s[d] = fade(delta[d][0]);
+    }
+
+    // 16 個の頂点の内積を求め、x → y → z → w の順に補間していく
+    float values[16];
+    for (int c = 0; c < 16; c++) {
+        int bx = c & 1, by = (c >> 1) & 1, bz = (c >> 2) & 1, bw = (c >> 3) & 1;
+        const Gradient4& g = volume.gradients[
+            (((size_t)index[3][bw] * volume.size[2] + index[2][bz]) * volume.size[1] + index[1][by])
+            * volume.size[0] + index[0][bx]];
+        values[c] = delta[0][bx] * g.x + delta[1][by] * g.y + delta[2][bz] * g.z + delta[3][bw] * g.w;
+    }
+    for (int d = 0, count = 16; d < 4; d++) {
+        count /= 2;
+        for (int c = 0; c < count; c++) {
+            values[c] = lerp(values[2 * c], values[2 * c + 1], s[d]);
+        }
+    }
+    return values[0];
+}
+
+float fbm4(float x, float y, float z, float w, int octaves, const GradientHypervolume& volume) {
+    float sum = 0.0f;
+    float amplitude = 1.0f;
+    for (int o = 0; o < octaves; o++) {
+        sum += amplitude * perlin4(x, y, z, w, volume);
+
+        // 次のオクターブは周波数2倍・振幅半分
+        x *= 2.0f;
+        y *= 2.0f;
+        z *= 2.0f;
+        w *= 2.0f;
+        amplitude *= 0.5f;
+    }
+    float total = fbmAmplitudeSum(octaves);
+    return total > 0.0f ? sum / total : 0.0f;
+}
+
+GradientGrid makeTileableGradients(int period, unsigned seed) {
+    GradientGrid gradients = makeGradients(period + 1, period + 1, seed);
+
+    // 右端の列・下端の行を先頭と同じにして、周期の境目でも値がつながるようにする
+    for (int y = 0; y <= period; y++) {
+        gradients[y][period] = gradients[y][0];
+    }
+    gradients[period] = gradients[0];
+    return gradients;
+}
+
+float perlinTiled(float x, float y, int period, const GradientGrid& gradients) {
+    // [0, period) に折り返す（負の値にも対応）
+    float fx = x - std::floor(x / period) * period;
+    float fy = y - std::floor(y / period) * period;
+
+    // 浮動小数の丸めで period ちょうどになった場合は 0 に戻す
+    if (fx >= period) fx = 0.0f;
+    if (fy >= period) fy = 0.0f;
+    return perlin(fx, fy, gradients);
+}
+
+float fbm2(float x, float y, int octaves, int period, const GradientGrid& gradients) {
+    float sum = 0.0f;
+    float amplitude = 1.0f;
+    for (int o = 0; o < octaves; o++) {
+        sum += amplitude * perlinTiled(x, y, period, gradients);
+
+        // 次のオクターブは周波数2倍・振幅半分
+        x *= 2.0f;
+        y *= 2.0f;
+        amplitude *= 0.5f;
+    }
+    float total = fbmAmplitudeSum(octaves);
+    return total > 0.0f ? sum / total : 0.0f;
+}
+
+std::vector<float> flattenGradients(const GradientGrid& gradients) {
+    std::vector<float> flat;
+    for (const auto& row : gradients) {
+        for (const auto& g : row) {
+            flat.push_back(g.first);
+            flat.push_back(g.second);
+        }
+    }
+    return flat;
+}
+
+// 格子点 (ix, iy) の勾配ベクトルと点 (x, y) までの距離ベクトルの内積（dotGridGradient と同じ計算）
+static float dotTableGradient(int ix, int iy, float x, float y, const GradientTableView& table) {
+    float dx = x - ix;
+    float dy = y - iy;
+    const float* g = table.data + ((size_t)iy * (table.period + 1) + ix) * 2;
+    return dx * g[0] + dy * g[1];
+}
+
+float perlinTable(float x, float y, const GradientTableView& table) {
+    // [0, period) に折り返す（perlinTiled と同じ）
+    int period = table.period;
+    x = x - std::floor(x / period) * period;
+    y = y - std::floor(y / period) * period;
+    if (x >= period) x = 0.0f;
+    if (y >= period) y = 0.0f;
+
+    int x0 = (int)x;
+    int y0 = (int)y;
+    float sx = fade(x - x0);
+    float sy = fade(y - y0);
+
+    float ix0 = lerp(dotTableGradient(x0, y0, x, y, table), dotTableGradient(x0 + 1, y0, x, y, table), sx);
+    float ix1 = lerp(dotTableGradient(x0, y0 + 1, x, y, table), dotTableGradient(x0 + 1, y0 + 1, x, y, table), sx);
+    return lerp(ix0, ix1, sy);
+}
+
+float fbm2Table(float x, float y, int octaves, const GradientTableView& table) {
+    float sum = 0.0f;
+    float amplitude = 1.0f;
+    for (int o = 0; o < octaves; o++) {
+        sum += amplitude * perlinTable(x, y, table);
+        x *= 2.0f;
+        y *= 2.0f;
+        amplitude *= 0.5f;
+    }
+    float total = fbmAmplitudeSum(octaves);
+    return total > 0.0f ? sum / total : 0.0f;
+}
@@ -0,0 +1,164 @@
+﻿// パーリンノイズ本体（DxLib に依存しない部分）
+// 描画側（main.cpp）とヘッドレスな処理の両方から使う
+#pragma once
+
+#include <vector>   // ベクタ型を使用するため
+#include <random>   // 乱数生成用
+#include <utility>  // std::pair
+
+// 勾配ベクトルの2次元配列（[y][x] で (cosθ, sinθ) を保持）
+using GradientGrid = std::vector<std::vector<std::pair<float, float>>>;
+
+// 補間関数：スムーズステップ（S字カーブ）
+// t: [0.0〜1.0] の補間パラメータ
+// 戻り値: tを滑らかにした値
+// （他の翻訳単位の評価ループでも展開されるようにヘッダーで定義する）
+inline float fade(float t) {
+    return t * t * t * (t * (t * 6 - 15) + 10);
+}
+
+// 線形補間関数
+// a, b: 補間元の2値
+// t: 補間係数（0〜1）
+// 戻り値: aとbをtで補間した値
+inline float lerp(float a, float b, float t) {
+    return a + t * (b - a);
+}
+
+// ドット積計算：グリッドの勾配ベクトルと対象点からの距離ベクトルの内積を求める
+// ix, iy: 勾配ベクトルのグリッド座標
+// x, y: 対象点の座標（連続空間）
+// gradients: 勾配ベクトルの2次元配列
+// 戻り値: 点(x,y)とグリッド(ix,iy)のベクトルの内積
+float dotGridGradient(int ix, int iy, float x, float y, const GradientGrid& gradients);
+
+// パーリンノイズ計算関数（1オクターブ）
+// x, y: ノイズ空間上の座標（float）
+// gradients: 勾配ベクトルの2次元配列
+// 戻り値: パーリンノイズ値（範囲は概ね -1.0〜1.0）
+float perlin(float x, float y, const GradientGrid& gradients);
+
+// 勾配ベクトルをランダムに生成
+// gen: 乱数エンジン
+// 戻り値: 単位長の2Dベクトル（cosθ, sinθ）
+std::pair<float, float> randomGradient(std::mt19937& gen);
+
+// 勾配ベクトルを各グリッド点に割り当てた配列を作る
+// gridW, gridH: グリッド点の数
+// seed: 乱数の種（同じ種なら毎回同じパターン）
+// 戻り値: gridH × gridW の勾配配列
+GradientGrid makeGradients(int gridW, int gridH, unsigned seed);
+
+// 画像全体のノイズ値を float の高さマップとして書き出す
+// out: 出力先（width * height 要素、行優先）
+// width, height: 画像サイズ（ピクセル）
+// gridSize: グリッドの間隔（ピクセル）
+// gradients: 勾配ベクトルの2次元配列（width / gridSize + 2 以上の大きさが必要）
+void generateHeightmap(float* out, int width, int height, int gridSize,
+    const GradientGrid& gradients);
+
+// 3次元の勾配ベクトル（単位長）
+struct Gradient3 {
+    float x, y, z;
+};
+
+// 3次元の勾配ベクトル配列（x, y, z 方向それぞれ周期的に繰り返す）
+// 3軸目を時間として使えば、滑らかに変化するアニメーション用ノイズになる
+struct GradientVolume {
+    int width = 0;                    // x 方向のグリッド点数（周期）
+    int height = 0;                   // y 方向のグリッド点数（周期）
+    int depth = 0;                    // z 方向のグリッド点数（周期）
+    std::vector<Gradient3> gradients; // [(z * height + y) * width + x]
+};
+
+// 単位球面上に一様に分布する3D勾配ベクトルをランダムに生成
+// gen: 乱数エンジン
+// 戻り値: 単位長の3Dベクトル
+Gradient3 randomGradient3(std::mt19937& gen);
+
+// 3D勾配ベクトル配列を作る
+// width, height, depth: 各方向のグリッド点数（この周期でノイズが繰り返す）
+// seed: 乱数の種
+GradientVolume makeGradientVolume(int width, int height, int depth, unsigned seed);
+
+// 3次元パーリンノイズ（1オクターブ）
+// x, y, z: ノイズ空間上の座標（負の値や周期を超える値も可）
+// volume: 3D勾配ベクトル配列
+// 戻り値: ノイズ値（範囲は概ね -1.0〜1.0）
+float perlin3(float x, float y, float z, const GradientVolume& volume);
+
+// fBm のうち指定した範囲のオクターブだけを足し合わせる（正規化はしない）
+// オクターブ o は周波数 2^o・振幅 0.5^o で重ねる
+// firstOctave: 最初のオクターブ番号（0 が基本周波数）
+// octaveCount: 足し合わせるオクターブ数
+float fbm3Octaves(float x, float y, float z, int firstOctave, int octaveCount,
+    const GradientVolume& volume);
+
+// octaves 個のオクターブの振幅の合計（fbm3 の正規化に使う値）
+float fbmAmplitudeSum(int octaves);
+
+// 3次元パーリンノイズを複数オクターブ重ねたもの（fBm）
+// octaves: 重ねるオクターブ数（1 なら perlin3 と同じ）
+// 戻り値: 振幅の合計で正規化したノイズ値（範囲は概ね -1.0〜1.0）
+float fbm3(float x, float y, float z, int octaves, const GradientVolume& volume);
+
+// 4次元の勾配ベクトル（単位長）
+struct Gradient4 {
+    float x, y, z, w;
+};
+
+// 4次元の勾配ベクトル配列（4方向それぞれ周期的に繰り返す）
+// 3軸目と4軸目の平面上で円を描くように時間を進めると、周期的に元へ戻るアニメーションになる
+struct GradientHypervolume {
+    int size[4] = { 0, 0, 0, 0 };     // 各方向のグリッド点数（周期）
+    std::vector<Gradient4> gradients; // [((w * size[2] + z) * size[1] + y) * size[0] + x]
+};
+
+// 4次元の単位球面上に一様に分布する勾配ベクトルをランダムに生成
+// gen: 乱数エンジン
+// 戻り値: 単位長の4Dベクトル
+Gradient4 randomGradient4(std::mt19937& gen);
+
+// 4D勾配ベクトル配列を作る
+// sizeX, sizeY, sizeZ, sizeW: 各方向のグリッド点数
+// seed: 乱数の種
+GradientHypervolume makeGradientHypervolume(int sizeX, int sizeY, int sizeZ, int sizeW, unsigned seed);
+
+// 4次元パーリンノイズ（1オクターブ）
+// x, y, z, w: ノイズ空間上の座標
+// 戻り値: ノイズ値（範囲は概ね -1.0〜1.0）
+float perlin4(float x, float y, float z, float w, const GradientHypervolume& volume);
+
+// 4次元パーリンノイズの fBm（振幅の合計で正規化）
+float fbm4(float x, float y, float z, float w, int octaves, const GradientHypervolume& volume);
+
+// 周期的に繰り返す（タイル可能な）勾配ベクトル配列を作る
+// 端の1行・1列は先頭のコピーにしておくので、perlinTiled で継ぎ目なく折り返せる
+// period: 周期（グリッド点数）
+// seed: 乱数の種
+// 戻り値: (period + 1) × (period + 1) の勾配配列
+GradientGrid makeTileableGradients(int period, unsigned seed);
+
+// 任意の座標（負の値や周期を超える値も可）で perlin() を評価する
+// 座標を周期で折り返してから perlin() を呼ぶ
+// period: makeTileableGradients に渡した周期
+float perlinTiled(float x, float y, int period, const GradientGrid& gradients);
+
+// perlinTiled を複数オクターブ重ねたもの（振幅の合計で正規化）
+float fbm2(float x, float y, int octaves, int period, const GradientGrid& gradients);
+
+// 平らに並べたタイル可能な勾配配列への参照（perlinTiled と同じ値を返す）
+struct GradientTableView {
+    int period = 0;               // 周期
+    const float* data = nullptr;  // [(y * (period + 1) + x) * 2] に x 成分、その次に y 成分
+};
+
+// 勾配配列を平らな配列に並べ替える
+// 戻り値: (period + 1)^2 * 2 要素の配列
+std::vector<float> flattenGradients(const GradientGrid& gradients);
+
+// 平らな勾配配列で perlinTiled を評価する（座標は周期で折り返す）
+float perlinTable(float x, float y, const GradientTableView& table);
+
+// perlinTable を複数オクターブ重ねたもの（fbm2 と同じ値を返す）
+float fbm2Table(float x, float y, int octaves, const GradientTableView& table);
@@ -0,0 +1,142 @@
+﻿#include "perlin_c.h"
+#include "perlin.h"
+#include "noise_simd.h"
+#include "parallel.h"
+#include "stream_store.h"
+
+#include <new>      // std::bad_alloc
+#include <vector>   // ベクタ型を使用するため
+
+// 勾配ベクトルの周期（グリッド点数）
+// この周期でノイズが繰り返すので、グリッド間隔 32 なら 8192 ピクセルごとになる
+const int GENERATOR_PERIOD = 256;
+
+// オクターブ数の上限（これ以上は周波数が細かすぎて意味がない）
+const int MAX_OCTAVES = 16;
+
+// 並列化の単位となる点の数（少ない点数ではスレッドを立てる方が遅い）
+const size_t EVALUATE_CHUNK = 4096;
+
+struct PerlinGenerator {
+    std::vector<float> gradients;  // 平らに並べた勾配配列（flattenGradients、周期は GENERATOR_PERIOD）
+    float gridSize = 32.0f;
+    int octaves = 1;
+    int threads = 0;
+};
+
+// C++ の例外を C の戻り値に変換する（例外を ABI の外へ出さない）
+template <class Func>
+static PerlinStatus guard(Func func) {
+    try {
+        func();
+        return PERLIN_OK;
+    } catch (const std::bad_alloc&) {
+        return PERLIN_ERROR_OUT_OF_MEMORY;
+    } catch (...) {
+        return PERLIN_ERROR_INTERNAL;
+    }
+}
+
+// 種から勾配配列を作る
+static void setGradients(PerlinGenerator* g, unsigned seed) {
+    g->gradients = flattenGradients(makeTileableGradients(GENERATOR_PERIOD, seed));
+}
+
+// 勾配配列への参照（行単位のカーネルに渡す）
+static GradientTableView gradientTable(const PerlinGenerator* g) {
+    GradientTableView table;
+    table.period = GENERATOR_PERIOD;
+    table.data = g->gradients.data();
+    return table;
+}
+
+// 1点のノイズ値（ピクセル座標）
+static float evaluatePoint(const PerlinGenerator* g, float x, float y) {
+    float inv = 1.0f / g->gridSize;
+    return fbm2Table(x * inv, y * inv, g->octaves, gradientTable(g));
+}
+
+extern "C" {
+
+int perlin_api_version(void) {
+    return PERLIN_API_VERSION;
+}
+
+PerlinGenerator* perlin_create(unsigned int seed) {
+    PerlinGenerator* generator = nullptr;
+    PerlinStatus status = guard([&]() {
+        generator = new PerlinGenerator();
+        setGradients(generator, seed);
+    });
+    if (status != PERLIN_OK) {
+        delete generator;
+        return nullptr;
+    }
+    return generator;
+}
+
+void perlin_destroy(PerlinGenerator* generator) {
+    delete generator;
+}
+
+PerlinStatus perlin_set_seed(PerlinGenerator* generator, unsigned int seed) {
+    if (!generator) return PERLIN_ERROR_INVALID_ARGUMENT;
+    return guard([&]() {
+        setGradients(generator, seed);
+    });
+}
+
+PerlinStatus perlin_set_grid_size(PerlinGenerator* generator, float grid_size) {
+    if (!generator || !(grid_size > 0.0f)) return PERLIN_ERROR_INVALID_ARGUMENT;
+    generator->gridSize = grid_size;
+    return PERLIN_OK;
+}
+
+PerlinStatus perlin_set_octaves(PerlinGenerator* generator, int octaves) {
+    if (!generator || octaves < 1 || octaves > MAX_OCTAVES) return PERLIN_ERROR_INVALID_ARGUMENT;
+    generator->octaves = octaves;
+    return PERLIN_OK;
+}
+
+PerlinStatus perlin_set_threads(PerlinGenerator* generator, int threads) {
+    if (!generator || threads < 0) return PERLIN_ERROR_INVALID_ARGUMENT;
+    generator->threads = threads;
+    return PERLIN_OK;
+}
+
+PerlinStatus perlin_fill(const PerlinGenerator* generator, float* out,
+    int width, int height, int origin_x, int origin_y, size_t stride) {
+
+    if (!generator || !out || width < 0 || height < 0) return PERLIN_ERROR_INVALID_ARGUMENT;
+    if (stride == 0) stride = (size_t)width;
+    if (stride < (size_t)width) return PERLIN_ERROR_INVALID_ARGUMENT;
+
+    return guard([&]() {
+        // 行ごとに CPU に合った SIMD カーネルで求める（値は1点ずつ fbm2 で求めた場合と同じ）
+        // 出力が LLC より大きければ、キャッシュを押し流さないよう非テンポラルストアで書く
+        const GradientTableView table = gradientTable(generator);
+        const float inv = 1.0f / generator->gridSize;
+        writeRows(out, width, height, stride, generator->threads, [&](float* row, int y) {
+            fbm2RowPortable(row, width, origin_x, origin_y + y, inv, generator->octaves, table);
+        });
+    });
+}
+
+PerlinStatus perlin_evaluate(const PerlinGenerator* generator,
+    const float* xs, const float* ys, float* out, size_t count) {
+
+    if (!generator || (count > 0 && (!xs || !ys || !out))) return PERLIN_ERROR_INVALID_ARGUMENT;
+
+    return guard([&]() {
+        int chunks = (int)((count + EVALUATE_CHUNK - 1) / EVALUATE_CHUNK);
+        parallelFor(chunks, generator->threads, [&](int c) {
+            size_t begin = (size_t)c * EVALUATE_CHUNK;
+            size_t end = begin + EVALUATE_CHUNK < count ? begin + EVALUATE_CHUNK : count;
+            for (size_t i = begin; i < end; i++) {
+                out[i] = evaluatePoint(generator, xs[i], ys[i]);
+            }
+        });
+    });
+}
+
+} // extern "C"
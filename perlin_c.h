@@ -0,0 +1,91 @@
+﻿/*
+ * パーリンノイズの C 言語インターフェース
+ * C++ 以外の言語（Python の ctypes、C#、Rust など）からプロセス内で直接呼ぶためのもの
+ *
+ * 出力先のバッファは呼び出し側が用意し、ライブラリはそこへ直接書き込む（コピーしない）
+ * 関数はすべて PerlinStatus（0 なら成功、負の値なら失敗）を返すか、生成・破棄・取得のみを行う
+ *
+ * Linux で共有ライブラリとしてビルドする例:
+ *   g++ -O2 -std=c++14 -pthread -fPIC -fvisibility=hidden -shared -DPERLIN_BUILD_LIBRARY
+ *       perlin.cpp noise_simd.cpp noise_simd_sse2.cpp noise_simd_sse41.cpp noise_simd_avx2.cpp noise_simd_avx512.cpp
+ *       stream_store.cpp perlin_c.cpp -o libperlinnoise.so
+ * Windows で DLL にする場合も PERLIN_BUILD_LIBRARY を定義してビルドする
+ */
+#ifndef PERLIN_C_H
+#define PERLIN_C_H
+
+#include <stddef.h> /* size_t */
+
+/* 公開する関数の修飾（ライブラリのビルド時は書き出し、利用時は読み込み） */
+#if defined(_WIN32)
+#  if defined(PERLIN_BUILD_LIBRARY)
+#    define PERLIN_API __declspec(dllexport)
+#  else
+#    define PERLIN_API __declspec(dllimport)
+#  endif
+#elif defined(__GNUC__)
+#  define PERLIN_API __attribute__((visibility("default")))
+#else
+#  define PERLIN_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ABI のバージョン（互換性の無い変更をしたときだけ上げる） */
+#define PERLIN_API_VERSION 1
+
+/* 戻り値 */
+typedef enum PerlinStatus {
+    PERLIN_OK = 0,                      /* 成功 */
+    PERLIN_ERROR_INVALID_ARGUMENT = -1, /* 引数が不正（NULL、負のサイズなど） */
+    PERLIN_ERROR_OUT_OF_MEMORY = -2,    /* メモリ不足 */
+    PERLIN_ERROR_INTERNAL = -3          /* その他の内部エラー */
+} PerlinStatus;
+
+/* ノイズ生成器（中身は非公開） */
+typedef struct PerlinGenerator PerlinGenerator;
+
+/* ライブラリの ABI バージョン（PERLIN_API_VERSION と比べて互換性を確かめる） */
+PERLIN_API int perlin_api_version(void);
+
+/* 生成器を作る
+ * seed: 乱数の種（同じ種なら同じパターン）
+ * 戻り値: 生成器（失敗したら NULL） */
+PERLIN_API PerlinGenerator* perlin_create(unsigned int seed);
+
+/* 生成器を破棄する（NULL を渡してもよい） */
+PERLIN_API void perlin_destroy(PerlinGenerator* generator);
+
+/* 乱数の種を変える（勾配ベクトルを作り直す） */
+PERLIN_API PerlinStatus perlin_set_seed(PerlinGenerator* generator, unsigned int seed);
+
+/* グリッドの間隔（ピクセル）を設定する（既定値 32、0 より大きいこと） */
+PERLIN_API PerlinStatus perlin_set_grid_size(PerlinGenerator* generator, float grid_size);
+
+/* 重ねるオクターブ数を設定する（既定値 1、1〜16） */
+PERLIN_API PerlinStatus perlin_set_octaves(PerlinGenerator* generator, int octaves);
+
+/* perlin_fill で使うスレッド数を設定する（既定値 0 = 論理プロセッサ数） */
+PERLIN_API PerlinStatus perlin_set_threads(PerlinGenerator* generator, int threads);
+
+/* 矩形領域のノイズ値を呼び出し側のバッファに書き込む
+ * out: 出力先（行 y の先頭は out + y * stride）
+ * width, height: 矩形の大きさ（ピクセル）
+ * origin_x, origin_y: 矩形の左上のピクセル座標（タイルごとに呼べば継ぎ目なくつながる）
+ * stride: 1行あたりの要素数（width 以上、0 なら width） */
+PERLIN_API PerlinStatus perlin_fill(const PerlinGenerator* generator, float* out,
+    int width, int height, int origin_x, int origin_y, size_t stride);
+
+/* 任意の点の集合でノイズ値を求める
+ * xs, ys: 各点のピクセル座標（count 要素）
+ * out: 結果の書き込み先（count 要素） */
+PERLIN_API PerlinStatus perlin_evaluate(const PerlinGenerator* generator,
+    const float* xs, const float* ys, float* out, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PERLIN_C_H */
@@ -0,0 +1,252 @@
+﻿// Python 拡張モジュール perlinnoise
+// NumPy 配列など書き込み可能なバッファを、コピーせずにその場でノイズ値で埋める
+// 生成中は GIL を手放すので、他の Python スレッドは止まらない
+//
+//   import numpy as np, perlinnoise
+//   g = perlinnoise.Generator(seed=123, grid_size=32.0, octaves=4)
+//   img = np.empty((720, 1280), dtype=np.float32)
+//   g.fill(img)                       # img を直接書き換える
+//   g.fill(img[100:200, 300:400], origin_x=300, origin_y=100)  # 切り出した範囲だけ
+//
+// Linux でのビルド例:
+//   g++ -O2 -std=c++14 -pthread -fPIC -shared -DPERLIN_BUILD_LIBRARY $(python3-config --includes)
+//       perlin.cpp noise_simd.cpp noise_simd_sse2.cpp noise_simd_sse41.cpp noise_simd_avx2.cpp noise_simd_avx512.cpp
+//       stream_store.cpp perlin_c.cpp perlin_python.cpp -o perlinnoise$(python3-config --extension-suffix)
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <climits>  // INT_MAX
+#include <cstring>  // strcmp
+
+#include "perlin_c.h"  // C 言語インターフェース
+
+// Python 側の Generator オブジェクト
+struct GeneratorObject {
+    PyObject_HEAD
+    PerlinGenerator* generator;
+};
+
+// PerlinStatus を Python の例外に変換する
+// 戻り値: 成功なら true（失敗なら例外を設定して false）
+static bool checkStatus(PerlinStatus status) {
+    switch (status) {
+    case PERLIN_OK:
+        return true;
+    case PERLIN_ERROR_INVALID_ARGUMENT:
+        PyErr_SetString(PyExc_ValueError, "invalid argument");
+        return false;
+    case PERLIN_ERROR_OUT_OF_MEMORY:
+        PyErr_NoMemory();
+        return false;
+    default:
+        PyErr_SetString(PyExc_RuntimeError, "noise generation failed");
+        return false;
+    }
+}
+
+// バッファの要素が float32 かどうか（バイト順の指定 '<' '=' '@' は許す）
+static bool isFloat32(const Py_buffer& view) {
+    if (view.itemsize != 4 || !view.format) return false;
+    const char* f = view.format;
+    if (*f == '<' || *f == '=' || *f == '@') f++;
+    return std::strcmp(f, "f") == 0;
+}
+
+static int Generator_init(GeneratorObject* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = { "seed", "grid_size", "octaves", "threads", nullptr };
+    unsigned int seed = 123;
+    float gridSize = 32.0f;
+    int octaves = 1;
+    int threads = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|Ifii", (char**)keywords,
+            &seed, &gridSize, &octaves, &threads)) {
+        return -1;
+    }
+
+    if (!self->generator) {
+        self->generator = perlin_create(seed);
+        if (!self->generator) {
+            PyErr_NoMemory();
+            return -1;
+        }
+    } else if (!checkStatus(perlin_set_seed(self->generator, seed))) {
+        return -1;
+    }
+
+    if (!checkStatus(perlin_set_grid_size(self->generator, gridSize)) ||
+        !checkStatus(perlin_set_octaves(self->generator, octaves)) ||
+        !checkStatus(perlin_set_threads(self->generator, threads))) {
+        return -1;
+    }
+    return 0;
+}
+
+static void Generator_dealloc(GeneratorObject* self) {
+    // PyType_FromSpec で作った型はインスタンスが型への参照を持つので、最後に手放す
+    PyTypeObject* type = Py_TYPE(self);
+    perlin_destroy(self->generator);
+    type->tp_free((PyObject*)self);
+    Py_DECREF(type);
+}
+
+// fill(array, origin_x=0, origin_y=0)
+// 2次元（または1次元）の float32 バッファをその場で埋める
+// 行の間隔（ストライド）は自由だが、1行の中の要素は連続している必要がある
+static PyObject* Generator_fill(GeneratorObject* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = { "array", "origin_x", "origin_y", nullptr };
+    PyObject* target = nullptr;
+    int originX = 0;
+    int originY = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|ii", (char**)keywords,
+            &target, &originX, &originY)) {
+        return nullptr;
+    }
+
+    Py_buffer view;
+    if (PyObject_GetBuffer(target, &view, PyBUF_RECORDS) != 0) return nullptr;
+
+    // 大きさは C 言語インターフェースの int に収まらなければならない
+    bool valid = isFloat32(view);
+    bool tooLarge = false;
+    for (int i = 0; valid && i < view.ndim; i++) {
+        if (view.shape[i] > INT_MAX) tooLarge = true;
+    }
+    if (tooLarge) {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_ValueError, "array dimensions must not exceed INT_MAX");
+        return nullptr;
+    }
+
+    int width = 0;
+    int height = 0;
+    Py_ssize_t rowStride = 0;
+    if (valid && view.ndim == 2) {
+        height = (int)view.shape[0];
+        width = (int)view.shape[1];
+        rowStride = view.strides[0];
+        valid = view.strides[1] == 4 && rowStride % 4 == 0 && rowStride >= (Py_ssize_t)width * 4;
+    } else if (valid && view.ndim == 1) {
+        height = 1;
+        width = (int)view.shape[0];
+        rowStride = (Py_ssize_t)width * 4;
+        valid = view.strides[0] == 4;
+    } else {
+        valid = false;
+    }
+    if (!valid) {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_ValueError,
+            "expected a writable 1-D or 2-D float32 buffer with contiguous rows");
+        return nullptr;
+    }
+
+    PerlinStatus status;
+    Py_BEGIN_ALLOW_THREADS
+    status = perlin_fill(self->generator, (float*)view.buf, width, height, originX, originY,
+        (size_t)(rowStride / 4));
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&view);
+    if (!checkStatus(status)) return nullptr;
+    Py_RETURN_NONE;
+}
+
+// evaluate(xs, ys, out)
+// 連続した1次元の float32 バッファ xs, ys の各点のノイズ値を out に書き込む
+static PyObject* Generator_evaluate(GeneratorObject* self, PyObject* args) {
+    PyObject* objects[3];
+    if (!PyArg_ParseTuple(args, "OOO", &objects[0], &objects[1], &objects[2])) return nullptr;
+
+    Py_buffer views[3];
+    int acquired = 0;
+    bool valid = true;
+    for (; acquired < 3; acquired++) {
+        int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | (acquired == 2 ? PyBUF_WRITABLE : 0);
+        if (PyObject_GetBuffer(objects[acquired], &views[acquired], flags) != 0) {
+            valid = false;
+            break;
+        }
+    }
+
+    size_t count = 0;
+    if (valid) {
+        count = (size_t)(views[0].len / 4);
+        for (int i = 0; i < 3; i++) {
+            if (!isFloat32(views[i]) || (size_t)(views[i].len / 4) != count) valid = false;
+        }
+        if (!valid) {
+            PyErr_SetString(PyExc_ValueError, "expected three float32 buffers of the same length");
+        }
+    }
+
+    PerlinStatus status = PERLIN_OK;
+    if (valid) {
+        Py_BEGIN_ALLOW_THREADS
+        status = perlin_evaluate(self->generator, (const float*)views[0].buf,
+            (const float*)views[1].buf, (float*)views[2].buf, count);
+        Py_END_ALLOW_THREADS
+    }
+
+    for (int i = 0; i < acquired; i++) PyBuffer_Release(&views[i]);
+    if (!valid || !checkStatus(status)) return nullptr;
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef Generator_methods[] = {
+    { "fill", (PyCFunction)(void (*)(void))Generator_fill, METH_VARARGS | METH_KEYWORDS,
+      "fill(array, origin_x=0, origin_y=0)\n"
+      "Fill a writable float32 buffer in place. The GIL is released while generating." },
+    { "evaluate", (PyCFunction)Generator_evaluate, METH_VARARGS,
+      "evaluate(xs, ys, out)\n"
+      "Write the noise value of each (xs[i], ys[i]) pixel position into out[i]." },
+    { nullptr, nullptr, 0, nullptr },
+};
+
+// Generator の型（PyType_FromSpec で作る）
+static PyType_Slot Generator_slots[] = {
+    { Py_tp_doc, (void*)"Generator(seed=123, grid_size=32.0, octaves=1, threads=0)" },
+    { Py_tp_new, (void*)PyType_GenericNew },
+    { Py_tp_init, (void*)Generator_init },
+    { Py_tp_dealloc, (void*)Generator_dealloc },
+    { Py_tp_methods, (void*)Generator_methods },
+    { 0, nullptr },
+};
+
+static PyType_Spec Generator_spec = {
+    "perlinnoise.Generator",   // name
+    sizeof(GeneratorObject),   // basicsize
+    0,                         // itemsize
+    Py_TPFLAGS_DEFAULT,        // flags
+    Generator_slots,           // slots
+};
+
+static PyModuleDef perlinModule = {
+    PyModuleDef_HEAD_INIT,
+    "perlinnoise",                                                   // m_name
+    "Multithreaded Perlin noise that fills NumPy arrays in place.",  // m_doc
+    -1,                                                              // m_size
+    nullptr,                                                         // m_methods
+    nullptr,                                                         // m_slots
+    nullptr,                                                         // m_traverse
+    nullptr,                                                         // m_clear
+    nullptr,                                                         // m_free
+};
+
+PyMODINIT_FUNC PyInit_perlinnoise(void) {
+    PyObject* module = PyModule_Create(&perlinModule);
+    if (!module) return nullptr;
+
+    PyObject* type = PyType_FromSpec(&Generator_spec);
+    if (!type) {
+        Py_DECREF(module);
+        return nullptr;
+    }
+    // PyModule_AddObject は成功したときだけ参照を引き取る
+    if (PyModule_AddObject(module, "Generator", type) < 0) {
+        Py_DECREF(type);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    PyModule_AddIntConstant(module, "API_VERSION", perlin_api_version());
+    return module;
+}
@@ -0,0 +1,143 @@
+﻿#include "preset.h"
+
+#include <cstring>  // memcpy, memcmp, memset
+#include <fstream>  // ファイル出力
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>     // open
+#include <sys/mman.h>  // mmap
+#include <sys/stat.h>  // fstat
+#include <unistd.h>    // close
+#endif
+
+// ファイルの先頭の識別子
+static const char PRESET_MAGIC[8] = { 'P', 'N', 'P', 'R', 'E', 'S', 'E', 'T' };
+
+// バイト順の確認用の値
+const uint32_t PRESET_BYTE_ORDER = 0x01020304;
+
+// 勾配配列の境界（SIMD の読み込みで境界をまたがないように）
+const uint64_t PRESET_TABLE_ALIGN = 64;
+
+// オクターブ数の上限
+const int PRESET_MAX_OCTAVES = 16;
+
+// 周期の上限（勾配配列はおよそ 2 GiB。壊れた見出しの大きさの計算があふれないようにもする）
+const int PRESET_MAX_PERIOD = 16384;
+
+bool savePreset(const std::string& path, const NoisePreset& preset) {
+    if (preset.period <= 0 || preset.period > PRESET_MAX_PERIOD ||
+        preset.octaves < 1 || preset.octaves > PRESET_MAX_OCTAVES ||
+        !(preset.gridSize > 0.0f)) {
+        return false;
+    }
+
+    std::vector<float> table = flattenGradients(makeTileableGradients(preset.period, preset.seed));
+
+    PresetHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, PRESET_MAGIC, sizeof(header.magic));
+    header.version = PRESET_VERSION;
+    header.byteOrder = PRESET_BYTE_ORDER;
+    header.headerSize = sizeof(PresetHeader);
+    header.seed = preset.seed;
+    header.gridSize = preset.gridSize;
+    header.octaves = preset.octaves;
+    header.period = preset.period;
+    header.tableOffset = (sizeof(PresetHeader) + PRESET_TABLE_ALIGN - 1) / PRESET_TABLE_ALIGN * PRESET_TABLE_ALIGN;
+    header.tableBytes = (uint64_t)table.size() * sizeof(float);
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+    file.write((const char*)&header, sizeof(header));
+    std::vector<char> padding((size_t)header.tableOffset - sizeof(header), 0);
+    file.write(padding.data(), padding.size());
+    file.write((const char*)table.data(), (std::streamsize)header.tableBytes);
+    return (bool)file;
+}
+
+bool MappedPreset::open(const std::string& path) {
+    close();
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    HANDLE map = nullptr;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+        map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    CloseHandle(file); // マッピングが残っていればファイルは閉じてよい
+    if (!map) return false;
+    void* address = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+    if (!address) {
+        CloseHandle(map);
+        return false;
+    }
+    base = (const unsigned char*)address;
+    size = (size_t)fileSize.QuadPart;
+    mapping = map;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    void* address = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        address = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd); // 割り当てが残っていればファイルは閉じてよい
+    if (address == MAP_FAILED) return false;
+    base = (const unsigned char*)address;
+    size = (size_t)info.st_size;
+#endif
+
+    // 形式を確かめる（合わなければ割り当てを解除する）
+    PresetHeader header;
+    bool valid = size >= sizeof(header);
+    if (valid) {
+        std::memcpy(&header, base, sizeof(header));
+        valid = header.period > 0 && header.period <= PRESET_MAX_PERIOD;
+    }
+    if (valid) {
+        uint64_t side = (uint64_t)header.period + 1;
+        uint64_t expected = side * side * 2 * sizeof(float);
+        valid = std::memcmp(header.magic, PRESET_MAGIC, sizeof(header.magic)) == 0 &&
+            header.version == PRESET_VERSION &&
+            header.byteOrder == PRESET_BYTE_ORDER &&
+            header.headerSize == sizeof(PresetHeader) &&
+            header.octaves >= 1 && header.octaves <= PRESET_MAX_OCTAVES &&
+            header.gridSize > 0.0f &&
+            header.tableOffset % PRESET_TABLE_ALIGN == 0 &&
+            header.tableBytes == expected &&
+            header.tableOffset <= size && header.tableBytes <= size - header.tableOffset;
+    }
+    if (!valid) {
+        close();
+        return false;
+    }
+
+    preset.seed = header.seed;
+    preset.gridSize = header.gridSize;
+    preset.octaves = header.octaves;
+    preset.period = header.period;
+    view.period = header.period;
+    view.data = (const float*)(base + header.tableOffset);
+    return true;
+}
+
+void MappedPreset::close() {
+    if (!base) return;
+#if defined(_WIN32)
+    UnmapViewOfFile(base);
+    CloseHandle((HANDLE)mapping);
+#else
+    munmap((void*)base, size);
+#endif
+    base = nullptr;
+    size = 0;
+    mapping = nullptr;
+    view = GradientTableView();
+}
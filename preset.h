@@ -0,0 +1,77 @@
+﻿// 生成器のプリセット（設定と作成済みの勾配配列をまとめたバイナリファイル）
+// 起動のたびに乱数から勾配配列を作り直す代わりに、ファイルをメモリに割り当てて（mmap）そのまま使う
+// 周期の大きい設定ほど作り直しに時間がかかるので、起動がほぼ一瞬になる
+//
+// ファイルの構成（値はすべて書き出したマシンのバイト順）
+//   PresetHeader（64 バイト）
+//   勾配配列: (period + 1)^2 個の (x, y) の float の組（行優先、64 バイト境界から始まる）
+#pragma once
+
+#include <cstddef>  // size_t
+#include <cstdint>  // uint32_t, uint64_t
+#include <string>   // ファイル名
+#include <vector>   // ベクタ型を使用するため
+
+#include "perlin.h" // GradientGrid
+
+// プリセットの形式のバージョン（互換性の無い変更をしたときだけ上げる）
+const uint32_t PRESET_VERSION = 1;
+
+// 生成器の設定
+struct NoisePreset {
+    unsigned seed = 123;     // 乱数の種
+    float gridSize = 32.0f;  // グリッドの間隔（ピクセル）
+    int octaves = 4;         // 重ねるオクターブ数
+    int period = 256;        // 勾配配列の周期（グリッド点数）
+};
+
+// ファイルの先頭に置く情報
+struct PresetHeader {
+    char magic[8];           // "PNPRESET"
+    uint32_t version;        // PRESET_VERSION
+    uint32_t byteOrder;      // 0x01020304（読み込み側とバイト順が違えば別の値に見える）
+    uint32_t headerSize;     // sizeof(PresetHeader)
+    uint32_t seed;
+    float gridSize;
+    int32_t octaves;
+    int32_t period;
+    uint32_t reserved;
+    uint64_t tableOffset;    // 勾配配列の位置（ファイル先頭から）
+    uint64_t tableBytes;     // 勾配配列の大きさ
+    uint64_t padding;
+};
+
+// プリセットを作って書き出す（勾配配列はここで作る）
+// 戻り値: 書き出せたら true
+bool savePreset(const std::string& path, const NoisePreset& preset);
+
+// メモリに割り当てたプリセット
+// 勾配配列はファイルの中を直接指すので、close() するまで table() の参照は有効
+class MappedPreset {
+public:
+    MappedPreset() {}
+    ~MappedPreset() { close(); }
+    MappedPreset(const MappedPreset&) = delete;
+    MappedPreset& operator=(const MappedPreset&) = delete;
+
+    // ファイルを開いて割り当てる（形式が合わなければ false）
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return base != nullptr; }
+    const NoisePreset& settings() const { return preset; }
+    GradientTableView table() const { return view; }
+
+    // 1点のノイズ値（ピクセル座標）
+    float evaluate(float x, float y) const {
+        float inv = 1.0f / preset.gridSize;
+        return fbm2Table(x * inv, y * inv, preset.octaves, view);
+    }
+
+private:
+    const unsigned char* base = nullptr;  // 割り当てたファイルの先頭
+    size_t size = 0;                      // ファイルの大きさ
+    void* mapping = nullptr;              // Windows のファイルマッピングのハンドル
+    NoisePreset preset;
+    GradientTableView view;
+};
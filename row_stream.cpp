@@ -0,0 +1,158 @@
+﻿#include "row_stream.h"
+#include "parallel.h"
+
+#include <algorithm>           // std::min
+#include <atomic>              // 作業番号の取り合い
+#include <cerrno>              // EPIPE
+#include <chrono>              // 経過時間の計測
+#include <condition_variable>  // 生成スレッドと書き出しの待ち合わせ
+#include <cstring>             // memcpy
+#include <mutex>               // 共有状態の保護
+#include <string>              // 見出し
+#include <thread>              // 生成スレッド
+#include <vector>              // ベクタ型を使用するため
+
+bool isStreamableFormat(ImageFormat format) {
+    return format == ImageFormat::PGM || format == ImageFormat::PFM || format == ImageFormat::RawFloat;
+}
+
+// 形式ごとの見出し（RawFloat は無し）
+static std::string streamHeader(ImageFormat format, int width, int height) {
+    char header[64];
+    switch (format) {
+    case ImageFormat::PGM:
+        std::snprintf(header, sizeof(header), "P5\n%d %d\n255\n", width, height);
+        return header;
+    case ImageFormat::PFM:
+        std::snprintf(header, sizeof(header), "Pf\n%d %d\n-1.0\n", width, height); // 負の倍率はリトルエンディアン
+        return header;
+    default:
+        return std::string();
+    }
+}
+
+// 描いた帯をファイルの並び順のバイト列にする
+// rows: 行 y0 から count 行（上から順）
+static void encodeBand(ImageFormat format, const float* rows, int width, int count, std::vector<unsigned char>& out) {
+    size_t rowBytes = format == ImageFormat::PGM ? (size_t)width : (size_t)width * sizeof(float);
+    out.resize(rowBytes * count);
+    for (int i = 0; i < count; i++) {
+        const float* row = rows + (size_t)i * width;
+        // PFM は下の行から並ぶので、帯の中でも逆順に置く
+        unsigned char* dst = out.data() + rowBytes * (format == ImageFormat::PFM ? count - 1 - i : i);
+        if (format == ImageFormat::PGM) {
+            for (int x = 0; x < width; x++) dst[x] = noiseToGray(row[x]);
+        } else {
+            std::memcpy(dst, row, rowBytes);
+        }
+    }
+}
+
+RowStreamStats streamRows(FILE* out, const RowStreamParams& params, const BandRenderer& render) {
+    RowStreamStats stats;
+    auto start = std::chrono::steady_clock::now();
+    if (!out || !isStreamableFormat(params.format) || params.width <= 0 || params.height <= 0) {
+        stats.ok = false;
+        return stats;
+    }
+
+    int threads = resolveThreadCount(params.threadCount);
+    int bandRows = params.bandRows > 0 ? params.bandRows : 16;
+    int bands = (params.height + bandRows - 1) / bandRows;
+    int slots = params.maxBandsInFlight > 0 ? params.maxBandsInFlight : threads * 4;
+    slots = std::min(slots, bands);
+    bool bottomUp = params.format == ImageFormat::PFM;
+
+    std::string header = streamHeader(params.format, params.width, params.height);
+    errno = 0;
+    if (!header.empty() && std::fwrite(header.data(), 1, header.size(), out) != header.size()) {
+        stats.ok = false;
+        stats.closed = errno == EPIPE;
+        return stats;
+    }
+    stats.bytesWritten += header.size();
+
+    // 帯 band は slot band % slots に置く（書き出しが slots 本以上遅れたら生成を待たせる）
+    struct Slot {
+        std::vector<unsigned char> bytes;
+        bool ready = false;
+    };
+    std::vector<Slot> ring(slots);
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    int written = 0;      // 次に書き出す帯の番号
+    bool abort = false;   // 書き出しに失敗したら生成も止める
+    std::atomic<int> nextBand(0);
+
+    // 生成スレッド：帯の番号の小さい順（＝ファイルの並び順）に取っていく
+    auto worker = [&]() {
+        std::vector<float> rows((size_t)params.width * bandRows);
+        std::vector<unsigned char> bytes;
+        for (;;) {
+            int band = nextBand++;
+            if (band >= bands) break;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() { return abort || band < written + slots; });
+                if (abort) break;
+            }
+
+            // ファイルの並びで band 番目の帯が画像のどの行にあたるか
+            int first = band * bandRows;
+            int count = std::min(bandRows, params.height - first);
+            int y0 = bottomUp ? params.height - first - count : first;
+            render(y0, count, rows.data());
+            encodeBand(params.format, rows.data(), params.width, count, bytes);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                Slot& slot = ring[band % slots];
+                slot.bytes.swap(bytes);
+                slot.ready = true;
+            }
+            changed.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++) workers.emplace_back(worker);
+
+    // 書き出し：次の番号の帯が揃うのを待って順に書く
+    std::vector<unsigned char> bytes;
+    while (written < bands) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            Slot& slot = ring[written % slots];
+            changed.wait(lock, [&]() { return slot.ready; });
+            slot.bytes.swap(bytes);
+            slot.ready = false;
+        }
+
+        errno = 0;
+        bool ok = std::fwrite(bytes.data(), 1, bytes.size(), out) == bytes.size() && std::fflush(out) == 0;
+        if (written == 0) {
+            stats.firstBandMs = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ok) {
+                written++;
+                stats.bytesWritten += bytes.size();
+            } else {
+                stats.ok = false;
+                stats.closed = errno == EPIPE;
+                abort = true;
+            }
+        }
+        changed.notify_all();
+        if (!ok) break;
+    }
+
+    for (auto& th : workers) th.join();
+    stats.elapsedMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
@@ -0,0 +1,45 @@
+﻿// 行単位のストリーム書き出し（標準出力やパイプ向け）
+// 画像を数行ずつの帯に分けて全スレッドに配り、出来上がった帯をファイルの並び順に書き出す
+// 生成と書き出しが重なり、最初の帯ができた時点で下流のコマンドが読み始められる
+// （画像全体のバッファは作らず、同時に扱う帯の数だけのメモリで済む）
+//
+//   perlin_cli stream --format pgm --width 8192 --height 8192 | pnmtopng > out.png
+#pragma once
+
+#include <cstdio>      // FILE
+#include <functional>  // 帯の描画関数
+
+#include "image_io.h"  // ImageFormat
+
+// ストリーム書き出しの設定
+struct RowStreamParams {
+    int width = 1280;             // 横幅（ピクセル）
+    int height = 720;             // 高さ（ピクセル）
+    ImageFormat format = ImageFormat::PGM;  // PGM、PFM、RawFloat のどれか
+    int bandRows = 16;            // 1つの作業にする行数
+    int threadCount = 0;          // 生成スレッド数（0 以下なら論理プロセッサ数）
+    int maxBandsInFlight = 0;     // 同時に扱う帯の数の上限（0 ならスレッド数の4倍）
+};
+
+// 書き出しの結果
+struct RowStreamStats {
+    bool ok = true;             // すべて書き出せたら true
+    bool closed = false;        // 読み手がパイプを閉じたので途中でやめた（EPIPE）
+    size_t bytesWritten = 0;    // 書き出したバイト数（見出しを含む）
+    double firstBandMs = 0.0;   // 最初の帯を書き出すまでの時間
+    double elapsedMs = 0.0;     // 全体の経過時間
+};
+
+// 行 [y0, y0 + count) を描く関数
+// rows: 書き込み先（行 y0 + i の先頭は rows + i * width）
+typedef std::function<void(int y0, int count, float* rows)> BandRenderer;
+
+// 行単位で書き出せる形式かどうか
+bool isStreamableFormat(ImageFormat format);
+
+// 画像を帯ごとに生成して out へ順に書き出す
+// 書き出しは呼び出し元のスレッドが行い、帯ごとに fflush するので下流はすぐに読める
+// 書き込みに失敗したら生成を止めて戻る（パイプが閉じられたときに落ちないよう、呼び出し側で SIGPIPE を無視しておく）
+// PFM は下の行から並べる形式なので、帯も下から順に作る
+// render: 帯の描画関数（複数スレッドから同時に呼ばれる）
+RowStreamStats streamRows(FILE* out, const RowStreamParams& params, const BandRenderer& render);
@@ -0,0 +1,473 @@
+﻿// 検証集（画面を使わない、結果が正しいかを確かめる専用のプログラム）
+// 名前を指定するとその検証だけを、指定しなければすべてを順に実行し、1つでも失敗すれば 1 で終わる
+//   g++ -O2 -std=c++14 -pthread perlin.cpp noise_kernels.cpp noise_simd.cpp noise_simd_sse2.cpp noise_simd_sse41.cpp
+//       noise_simd_avx2.cpp noise_simd_avx512.cpp stream_store.cpp perlin_c.cpp noise_graph.cpp image_io.cpp
+//       tiff_writer.cpp async_writer.cpp animation.cpp selftest.cpp -o perlin_selftest
+//   ./perlin_selftest tifforder
+// Visual Studio のプロジェクトでは WinMain 側と重ならないようビルド対象から外している
+#include <algorithm> // std::find
+#include <cstdio>   // printf, fopen, remove
+#include <cstring>  // strcmp, strncmp, memcpy
+#include <string>   // std::string
+#include <vector>   // ベクタ型を使用するため
+
+#include "perlin.h"        // パーリンノイズ本体
+#include "animation.h"     // アニメーション生成
+#include "noise_kernels.h" // 行単位のカーネル
+#include "noise_simd.h"    // SIMD ラッパーで書いたカーネル
+#include "noise_graph.h"   // ノイズの合成グラフ
+#include "noise_expr.h"    // ノイズ式（式テンプレート）
+#include "perlin_c.h"      // C 言語インターフェース
+#include "tiff_writer.h"   // タイル分割 TIFF
+
+// 検証に使う一時ファイルの名前
+static const char* const CHECK_TIFF_PATH = "selftest_order.tif";
+
+// ファイルをすべて読む（読めなければ空）
+static std::vector<unsigned char> readFile(const char* path) {
+    std::vector<unsigned char> data;
+    FILE* fp = std::fopen(path, "rb");
+    if (!fp) return data;
+    unsigned char buffer[65536];
+    size_t n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), fp)) > 0) data.insert(data.end(), buffer, buffer + n);
+    std::fclose(fp);
+    return data;
+}
+
+static uint32_t readLE16(const std::vector<unsigned char>& data, size_t at) {
+    return at + 2 <= data.size() ? (uint32_t)data[at] | (uint32_t)data[at + 1] << 8 : 0;
+}
+
+static uint32_t readLE32(const std::vector<unsigned char>& data, size_t at) {
+    return at + 4 <= data.size() ? readLE16(data, at) | readLE16(data, at + 2) << 16 : 0;
+}
+
+// 書き出した TIFF（float、圧縮なし）を読み戻して、expected と同じかを確かめる
+// 戻り値: 失敗の理由（同じなら空）
+static std::string verifyTiff(const std::vector<unsigned char>& data, int width, int height,
+    const std::vector<float>& expected) {
+    if (data.size() < 8 || data[0] != 'I' || data[1] != 'I' || readLE16(data, 2) != 42) return "bad header";
+    uint32_t ifd = readLE32(data, 4);
+    if (ifd == 0 || ifd + 2 > data.size()) return "IFD offset " + std::to_string(ifd);
+
+    // 必要なタグだけを拾う（値が4バイトに収まらない配列は位置が書いてある）
+    uint32_t tileWidth = 0;
+    uint32_t tileLength = 0;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> counts;
+    uint32_t entries = readLE16(data, ifd);
+    for (uint32_t i = 0; i < entries; i++) {
+        size_t at = ifd + 2 + i * 12;
+        uint32_t tag = readLE16(data, at);
+        uint32_t count = readLE32(data, at + 4);
+        uint32_t value = readLE32(data, at + 8);
+        if (tag == 322) tileWidth = value;
+        if (tag == 323) tileLength = value;
+        if (tag == 324 || tag == 325) {
+            std::vector<uint32_t>& list = tag == 324 ? offsets : counts;
+            for (uint32_t k = 0; k < count; k++) list.push_back(count > 1 ? readLE32(data, value + k * 4) : value);
+        }
+    }
+    if (tileWidth == 0 || tileLength == 0) return "no tile size";
+    uint32_t across = (width + tileWidth - 1) / tileWidth;
+    uint32_t down = (height + tileLength - 1) / tileLength;
+    if (offsets.size() != across * down || counts.size() != offsets.size()) return "tile count";
+
+    for (uint32_t t = 0; t < offsets.size(); t++) {
+        if (counts[t] != tileWidth * tileLength * 4 || (uint64_t)offsets[t] + counts[t] > data.size()) return "tile size";
+        for (uint32_t y = 0; y < tileLength; y++) {
+            for (uint32_t x = 0; x < tileWidth; x++) {
+                uint32_t px = t % across * tileWidth + x;
+                uint32_t py = t / across * tileLength + y;
+                if (px >= (uint32_t)width || py >= (uint32_t)height) continue;
+                float v;
+                std::memcpy(&v, &data[offsets[t] + (y * tileWidth + x) * 4], 4);
+                if (v != expected[(size_t)py * width + px]) return "pixel mismatch";
+            }
+        }
+    }
+    return std::string();
+}
+
+// TIFF の書き出しが書き込みの完了順に頼っていないこと
+// 書き込みを受け付けたのと逆の順に行う Reversed でも、普段の書き込みのしかたでも、読み戻して同じになるかを確かめる
+static bool checkTiffOrder() {
+    const int width = 100;
+    const int height = 70;
+    std::vector<float> values((size_t)width * height);
+    for (size_t i = 0; i < values.size(); i++) values[i] = (float)((i * 7919) % 1000) / 500.0f - 1.0f;
+
+    struct Mode {
+        const char* name;
+        AsyncWriteBackend backend;
+    };
+    const Mode modes[] = {
+        { "reversed", AsyncWriteBackend::Reversed },
+        { "threads", AsyncWriteBackend::ThreadPool },
+        { "auto", AsyncWriteBackend::Auto },
+    };
+
+    bool ok = true;
+    for (const Mode& mode : modes) {
+        TiffOptions options;
+        options.tileSize = 32;
+        options.writeBackend = mode.backend;
+        TiledTiffWriter writer;
+        bool written = writer.open(CHECK_TIFF_PATH, width, height, options);
+        for (int ty = 0; written && ty < writer.tilesDown(); ty++) {
+            for (int tx = 0; written && tx < writer.tilesAcross(); tx++) {
+                const float* tile = &values[(size_t)ty * 32 * width + tx * 32];
+                written = writer.writeTile(tx, ty, tile, width);
+            }
+        }
+        written = written && writer.finish();
+
+        std::string reason = written ? verifyTiff(readFile(CHECK_TIFF_PATH), width, height, values) : "write failed";
+        std::printf("  %-10s %s\n", mode.name, reason.empty() ? "ok" : reason.c_str());
+        ok = ok && reason.empty();
+    }
+    std::remove(CHECK_TIFF_PATH);
+    return ok;
+}
+
+// 行単位のカーネルの設定の組（周期、グリッドの間隔、オクターブ数）
+struct KernelCase {
+    int period;
+    float gridSize;
+    int octaves;
+};
+
+static const KernelCase KERNEL_CASES[] = {
+    { 16, 32.0f, 1 }, { 16, 7.3f, 4 }, { 256, 32.0f, 4 }, { 256, 100.0f, 7 }, { 256, 3.0f, 16 },
+};
+
+// 矩形の fBm を fbm2 で1点ずつ求める（カーネルの比べる相手）
+static void referenceFbm2(float* out, int width, int height, int px0, int py0, const KernelCase& c,
+    const GradientGrid& gradients) {
+    float inv = 1.0f / c.gridSize;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            float x0 = (float)(px0 + x) * inv;
+            float y0 = (float)(py0 + y) * inv;
+            out[(size_t)y * width + x] = fbm2(x0, y0, c.octaves, c.period, gradients);
+        }
+    }
+}
+
+// 行単位のカーネルで矩形を埋める
+static void fillRows(float* out, int width, int height, int px0, int py0, const KernelCase& c,
+    const GradientTableView& table, void (*kernel)(float*, int, int, int, float, int, const GradientTableView&)) {
+    for (int y = 0; y < height; y++) {
+        kernel(out + (size_t)y * width, width, px0, py0 + y, 1.0f / c.gridSize, c.octaves, table);
+    }
+}
+
+// 2つの結果がビット単位で一致するか（違えば最初の違いを表示する）
+static bool sameBits(const char* name, const KernelCase& c, const std::vector<float>& expected,
+    const std::vector<float>& actual) {
+    for (size_t i = 0; i < expected.size(); i++) {
+        if (std::memcmp(&expected[i], &actual[i], sizeof(float)) != 0) {
+            std::printf("  %-12s period %d grid %g octaves %d: [%zu] %.9g != %.9g\n",
+                name, c.period, c.gridSize, c.octaves, i, actual[i], expected[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// 行単位のカーネルが fbm2 と同じ値を返すこと（負の座標、周期の折り返し、行の端数を含む）
+// 命令セットごとの実体は、実行中の CPU で使えるものだけを確かめる
+static bool checkKernels() {
+    const int width = 203;
+    const int height = 19;
+    const int px0 = -1000;
+    const int py0 = -7;
+
+    bool ok = true;
+    for (const KernelCase& c : KERNEL_CASES) {
+        GradientGrid gradients = makeTileableGradients(c.period, 11);
+        std::vector<float> flat = flattenGradients(gradients);
+        GradientTableView table;
+        table.period = c.period;
+        table.data = flat.data();
+
+        std::vector<float> expected((size_t)width * height);
+        std::vector<float> actual((size_t)width * height);
+        referenceFbm2(expected.data(), width, height, px0, py0, c, gradients);
+
+        fillRows(actual.data(), width, height, px0, py0, c, table, fbm2Row);
+        ok = sameBits("clones", c, expected, actual) && ok;
+        fillRows(actual.data(), width, height, px0, py0, c, table, fbm2RowBaseline);
+        ok = sameBits("baseline", c, expected, actual) && ok;
+
+        fillRows(actual.data(), width, height, px0, py0, c, table, fbm2RowScalar);
+        ok = sameBits("scalar", c, expected, actual) && ok;
+#if defined(SIMD_X86)
+        Fbm2RowKernel best = selectFbm2RowKernel();
+        fillRows(actual.data(), width, height, px0, py0, c, table, fbm2RowSse2);
+        ok = sameBits("sse2", c, expected, actual) && ok;
+        if (best != fbm2RowSse2) {
+            fillRows(actual.data(), width, height, px0, py0, c, table, fbm2RowSse41);
+            ok = sameBits("sse4.1", c, expected, actual) && ok;
+        }
+        if (best == fbm2RowAvx2 || best == fbm2RowAvx512) {
+            fillRows(actual.data(), width, height, px0, py0, c, table, fbm2RowAvx2);
+            ok = sameBits("avx2", c, expected, actual) && ok;
+        }
+        if (best == fbm2RowAvx512) {
+            fillRows(actual.data(), width, height, px0, py0, c, table, fbm2RowAvx512);
+            ok = sameBits("avx512f", c, expected, actual) && ok;
+        }
+#endif
+        fillRows(actual.data(), width, height, px0, py0, c, table, fbm2RowPortable);
+        ok = sameBits("portable", c, expected, actual) && ok;
+
+        // 矩形単位（先読みあり・なし）。出力の行の間隔が幅より広くてもよい
+        const size_t stride = width + 5;
+        std::vector<float> block(stride * height);
+        for (int prefetchRows : { 0, GRADIENT_PREFETCH_ROWS }) {
+            fbm2BlockPortable(block.data(), width, height, stride, px0, py0, 1.0f / c.gridSize, c.octaves, table,
+                prefetchRows);
+            for (int y = 0; y < height; y++) {
+                std::memcpy(&actual[(size_t)y * width], &block[y * stride], width * sizeof(float));
+            }
+            ok = sameBits(prefetchRows > 0 ? "block" : "block nopf", c, expected, actual) && ok;
+        }
+
+        // 1点ずつ平らな勾配配列で
+        float inv = 1.0f / c.gridSize;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                float x0 = (float)(px0 + x) * inv;
+                float y0 = (float)(py0 + y) * inv;
+                actual[(size_t)y * width + x] = fbm2Table(x0, y0, c.octaves, table);
+            }
+        }
+        ok = sameBits("fbm2Table", c, expected, actual) && ok;
+    }
+    const char* selected = nullptr;
+    selectFbm2RowKernel(&selected);
+    std::printf("  portable selects %s, target_clones selects %s\n", selected, selectedKernelTarget());
+    return ok;
+}
+
+// C 言語インターフェースの perlin_fill が fbm2 と同じ値を返すこと（切り出し・行の間隔・複数スレッド）
+static bool checkCApi() {
+    const unsigned seed = 42;
+    const int period = 256; // perlin_c.cpp の GENERATOR_PERIOD
+    const KernelCase c = { period, 24.5f, 5 };
+    const int width = 300;
+    const int height = 40;
+    const int originX = -77;
+    const int originY = 1234;
+    const size_t stride = width + 3;
+
+    GradientGrid gradients = makeTileableGradients(period, seed);
+    std::vector<float> expected((size_t)width * height);
+    referenceFbm2(expected.data(), width, height, originX, originY, c, gradients);
+
+    PerlinGenerator* generator = perlin_create(seed);
+    if (!generator) return false;
+    bool ok = perlin_set_grid_size(generator, c.gridSize) == PERLIN_OK &&
+        perlin_set_octaves(generator, c.octaves) == PERLIN_OK;
+
+    std::vector<float> actual((size_t)width * height);
+    for (int threads : { 1, 4 }) {
+        std::vector<float> filled(stride * height);
+        ok = ok && perlin_set_threads(generator, threads) == PERLIN_OK &&
+            perlin_fill(generator, filled.data(), width, height, originX, originY, stride) == PERLIN_OK;
+        for (int y = 0; ok && y < height; y++) {
+            std::memcpy(&actual[(size_t)y * width], &filled[y * stride], width * sizeof(float));
+        }
+        ok = ok && sameBits(threads > 1 ? "fill mt" : "fill", c, expected, actual);
+    }
+
+    // perlin_evaluate（任意の点の並び）
+    std::vector<float> xs;
+    std::vector<float> ys;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            xs.push_back((float)(originX + x));
+            ys.push_back((float)(originY + y));
+        }
+    }
+    ok = ok && perlin_evaluate(generator, xs.data(), ys.data(), actual.data(), actual.size()) == PERLIN_OK;
+    ok = ok && sameBits("evaluate", c, expected, actual);
+
+    perlin_destroy(generator);
+    return ok;
+}
+
+// 合成グラフのタイル評価が、Perlin ノードを1点ずつ fbm2 で求めた場合と同じ値を返すこと
+// （タイルの格子は矩形単位のカーネルで、ワープした座標は1点ずつ求める）
+// 入れ子のワープで、結果の使い回しが値を変えないこと
+static bool checkGraph() {
+    const int period = 256; // noise_graph.cpp の GRAPH_PERIOD
+    const KernelCase c = { period, 40.0f, 6 };
+    const unsigned seed = 7;
+    const int x0 = 96;
+    const int y0 = -64;
+    const int width = 75;
+    const int height = 33;
+
+    NoiseGraph graph;
+    int base = graph.perlin(1.0f / c.gridSize, c.octaves, seed);
+    int dx = graph.perlin(1.0f / 50.0f, 2, seed + 1);
+    int warped = graph.warp(base, dx, dx, 0.0f); // 強さ 0 なら座標は変わらない
+
+    GradientGrid gradients = makeTileableGradients(period, seed);
+    std::vector<float> expected((size_t)width * height);
+    referenceFbm2(expected.data(), width, height, x0, y0, c, gradients);
+
+    const size_t stride = width + 9;
+    std::vector<float> tile(stride * height);
+    std::vector<float> actual((size_t)width * height);
+    bool ok = true;
+    const int outputs[] = { base, warped };
+    for (int output : outputs) {
+        graph.evaluateTile(output, x0, y0, width, height, tile.data(), stride);
+        for (int y = 0; y < height; y++) {
+            std::memcpy(&actual[(size_t)y * width], &tile[y * stride], width * sizeof(float));
+        }
+        ok = sameBits(output == base ? "tile" : "warped", c, expected, actual) && ok;
+    }
+
+    // 入れ子のワープ：内側の Warp は外側の Warp を通るかどうかで別の座標で評価されるので、
+    // 結果の使い回しを有効にしても無効にしたときと同じ値になること
+    NoiseGraph nested;
+    int p = nested.perlin(1.0f / c.gridSize, c.octaves, seed);
+    int innerX = nested.perlin(1.0f / 50.0f, 2, seed + 1);
+    int innerY = nested.perlin(1.0f / 50.0f, 2, seed + 2);
+    int outerX = nested.perlin(1.0f / 70.0f, 2, seed + 3);
+    int outerY = nested.perlin(1.0f / 70.0f, 2, seed + 4);
+    int inner = nested.warp(p, innerX, innerY, 20.0f);
+    int outer = nested.warp(inner, outerX, outerY, 30.0f);
+    int output = nested.add(nested.add(inner, p), outer);
+    std::vector<float> unshared((size_t)width * height);
+    nested.setSubexpressionSharing(false);
+    nested.evaluateTile(output, x0, y0, width, height, unshared.data(), width);
+    nested.setSubexpressionSharing(true);
+    nested.evaluateTile(output, x0, y0, width, height, actual.data(), width);
+    ok = sameBits("nested warp", c, unshared, actual) && ok;
+    return ok;
+}
+
+// 式テンプレートの fBm が fbm2 と同じ値を返し、ほかのノードを組み合わせた式も命令セットによらず同じ値になること
+// （負の座標と行の端数を含む。命令セットごとの実体は、実行中の CPU で使えるものだけを確かめる）
+static bool checkExpr() {
+    const KernelCase c = { 256, 40.0f, 6 };
+    const int x0 = -300;
+    const int y0 = -17;
+    const int width = 203;
+    const int height = 19;
+
+    GradientGrid gradients = makeTileableGradients(c.period, 5);
+    std::vector<float> flat = flattenGradients(gradients);
+    GradientTableView table;
+    table.period = c.period;
+    table.data = flat.data();
+    auto source = fbm(perlinSource(table, 1.0f / c.gridSize), c.octaves);
+    auto mixed = clampExpr(ridged(source) * 1.5f - perlinSource(table, 1.0f / 9.0f), -0.25f, 0.75f) + 0.5f * source;
+
+    std::vector<float> expected((size_t)width * height);
+    std::vector<float> expectedMixed((size_t)width * height);
+    std::vector<float> actual((size_t)width * height);
+    referenceFbm2(expected.data(), width, height, x0, y0, c, gradients);
+    exprScalar::evaluateTile(mixed, x0, y0, width, height, expectedMixed.data(), width);
+
+    bool ok = true;
+    exprScalar::evaluateTile(source, x0, y0, width, height, actual.data(), width);
+    ok = sameBits("scalar", c, expected, actual) && ok;
+#if defined(SIMD_X86)
+    SimdLevel level = detectSimdLevel();
+    exprSse2::evaluateTile(source, x0, y0, width, height, actual.data(), width);
+    ok = sameBits("sse2", c, expected, actual) && ok;
+    exprSse2::evaluateTile(mixed, x0, y0, width, height, actual.data(), width);
+    ok = sameBits("sse2 mixed", c, expectedMixed, actual) && ok;
+    if (level >= SimdLevel::Sse41) {
+        exprSse41::evaluateTile(source, x0, y0, width, height, actual.data(), width);
+        ok = sameBits("sse4.1", c, expected, actual) && ok;
+        exprSse41::evaluateTile(mixed, x0, y0, width, height, actual.data(), width);
+        ok = sameBits("sse4.1 mixed", c, expectedMixed, actual) && ok;
+    }
+    if (level >= SimdLevel::Avx2) {
+        exprAvx2::evaluateTile(source, x0, y0, width, height, actual.data(), width);
+        ok = sameBits("avx2", c, expected, actual) && ok;
+        exprAvx2::evaluateTile(mixed, x0, y0, width, height, actual.data(), width);
+        ok = sameBits("avx2 mixed", c, expectedMixed, actual) && ok;
+    }
+    if (level >= SimdLevel::Avx512) {
+        exprAvx512::evaluateTile(source, x0, y0, width, height, actual.data(), width);
+        ok = sameBits("avx512f", c, expected, actual) && ok;
+        exprAvx512::evaluateTile(mixed, x0, y0, width, height, actual.data(), width);
+        ok = sameBits("avx512f mixed", c, expectedMixed, actual) && ok;
+    }
+#endif
+    return ok;
+}
+
+// 時間方向の間引きで、全オクターブを計算するフレームを挟んでから間引きに戻ったとき、
+// 高オクターブ成分を作り直すこと（挟む前の古い成分を使わず、新しく始めた場合と同じ値になる）
+static bool checkTemporal() {
+    AnimationParams params;
+    params.width = 96;
+    params.height = 64;
+    params.detailRefreshSide = 2;
+    params.freshOctaves = 1;
+    GradientVolume volume = makeAnimationVolume();
+    const KernelCase c = { volume.width, params.gridSize, 4 };
+
+    FrameQuality temporal;
+    temporal.octaves = c.octaves;
+    FrameQuality full;
+    full.octaves = params.freshOctaves; // fresh >= octaves なので間引かない
+
+    std::vector<float> expected((size_t)params.width * params.height);
+    std::vector<float> actual(expected.size());
+    AnimationState resumed;
+    renderAnimatedFrame(actual.data(), params, volume, 0.0, temporal, resumed);
+    renderAnimatedFrame(actual.data(), params, volume, 1.0, full, resumed);
+    renderAnimatedFrame(actual.data(), params, volume, 2.0, temporal, resumed);
+
+    AnimationState fresh;
+    renderAnimatedFrame(expected.data(), params, volume, 2.0, temporal, fresh);
+    return sameBits("resumed", c, expected, actual);
+}
+
+struct Check {
+    const char* name;
+    bool (*run)();
+};
+
+static const Check CHECKS[] = {
+    { "kernels", checkKernels },
+    { "capi", checkCApi },
+    { "graph", checkGraph },
+    { "expr", checkExpr },
+    { "temporal", checkTemporal },
+    { "tifforder", checkTiffOrder },
+};
+
+int main(int argc, char** argv) {
+    std::vector<std::string> names;
+    for (int i = 1; i < argc; i++) names.push_back(argv[i]);
+
+    int ran = 0;
+    int failed = 0;
+    for (const Check& c : CHECKS) {
+        if (!names.empty() && std::find(names.begin(), names.end(), c.name) == names.end()) continue;
+        std::printf("%s\n", c.name);
+        bool ok = c.run();
+        std::printf("%s: %s\n", c.name, ok ? "ok" : "FAILED");
+        if (!ok) failed++;
+        ran++;
+    }
+    if (ran == 0) {
+        std::printf("usage: perlin_selftest [name...]\nchecks:");
+        for (const Check& c : CHECKS) std::printf(" %s", c.name);
+        std::printf("\n");
+        return 1;
+    }
+    return failed > 0 ? 1 : 0;
+}
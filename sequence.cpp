@@ -0,0 +1,189 @@
+﻿#include "sequence.h"
+#include "parallel.h"
+#include "tiff_writer.h"
+
+#include <algorithm>           // std::max, std::min
+#include <atomic>              // 作業番号の取り合い
+#include <chrono>              // 経過時間の計測
+#include <condition_variable>  // 生成スレッドと書き出しの待ち合わせ
+#include <map>                 // 生成中・並べ替え待ちのフレーム
+#include <memory>              // std::unique_ptr
+#include <mutex>               // 共有状態の保護
+#include <thread>              // 生成スレッド
+#include <vector>              // ベクタ型を使用するため
+
+SequenceStats renderSequence(const SequenceParams& params, const TileRenderer& render) {
+    SequenceStats stats;
+    auto start = std::chrono::steady_clock::now();
+    if (params.width <= 0 || params.height <= 0) {
+        stats.ok = false;
+        return stats;
+    }
+
+    int threads = resolveThreadCount(params.threadCount);
+    int maxInFlight = params.maxFramesInFlight > 0 ? params.maxFramesInFlight : threads * 2;
+    int tile = params.tileSize > 0 ? params.tileSize : std::max(params.width, params.height);
+    int tilesX = (params.width + tile - 1) / tile;
+    int tilesY = (params.height + tile - 1) / tile;
+    int tilesPerFrame = tilesX * tilesY;
+    long long totalItems = (long long)params.frames * tilesPerFrame;
+    size_t framePixels = (size_t)params.width * params.height;
+
+    ImageOptions imageOptions;
+    imageOptions.compress = params.compress;
+    imageOptions.writeBackend = params.writeBackend;
+
+    // TIFF のタイルを生成のタイルに揃えられるなら、タイルごとに書き足す
+    bool streamTiles = isTiffFormat(params.format) && params.tileSize > 0 && params.tileSize % TIFF_TILE_ALIGN == 0;
+    TiffOptions tiffOptions;
+    tiffOptions.sample = params.format == ImageFormat::Tiff16 ? TiffSampleFormat::UInt16 : TiffSampleFormat::Float32;
+    tiffOptions.tileSize = tile;
+    tiffOptions.compress = params.compress;
+    tiffOptions.writeBackend = params.writeBackend;
+
+    // 生成中のフレーム（残りのタイル数を数え、0 になったら並べ替え待ちへ移す）
+    struct FrameWork {
+        std::vector<float> pixels;
+        std::unique_ptr<TiledTiffWriter> tiff;  // タイルごとに書き足すときのファイル
+        int remaining = 0;
+    };
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::map<int, FrameWork> active;                // 生成中
+    std::map<int, FrameWork> completed;             // 並べ替え待ち（番号順に書き出すまで保持）
+    std::vector<std::vector<float>> freeBuffers;    // 書き出し済みで再利用できるバッファ
+    int written = 0;                                // 次に書き出すフレーム番号
+    bool abort = false;                             // 書き出しに失敗したら生成も止める
+    std::atomic<long long> nextItem(0);
+
+    // 生成スレッド：作業番号の小さい順（＝フレーム順）に取っていくので、並べ替え待ちは少なく済む
+    auto worker = [&]() {
+        for (;;) {
+            long long item = nextItem++;
+            if (item >= totalItems) break;
+            int frame = (int)(item / tilesPerFrame);
+            int t = (int)(item % tilesPerFrame);
+
+            float* pixels;
+            TiledTiffWriter* tiff = nullptr;
+            {
+                // 書き出しが maxInFlight フレーム以上遅れていたら追いつくまで待つ
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() { return abort || frame < written + maxInFlight; });
+                if (abort) break;
+
+                auto it = active.find(frame);
+                if (it == active.end()) {
+                    FrameWork work;
+                    if (!freeBuffers.empty()) {
+                        work.pixels = std::move(freeBuffers.back());
+                        freeBuffers.pop_back();
+                    }
+                    work.pixels.resize(framePixels);
+                    work.remaining = tilesPerFrame;
+                    if (streamTiles) {
+                        work.tiff.reset(new TiledTiffWriter());
+                        if (!work.tiff->open(numberedPath(params.prefix, frame, params.format),
+                                params.width, params.height, tiffOptions)) {
+                            stats.ok = false;
+                            abort = true;
+                            changed.notify_all();
+                            break;
+                        }
+                    }
+                    it = active.emplace(frame, std::move(work)).first;
+                }
+                pixels = it->second.pixels.data();
+                tiff = it->second.tiff.get();
+            }
+
+            int x0 = (t % tilesX) * tile;
+            int y0 = (t / tilesX) * tile;
+            render(frame, x0, y0, std::min(x0 + tile, params.width), std::min(y0 + tile, params.height), pixels);
+
+            // 描き終えたタイルをすぐに符号化して書き足す（他のスレッドのタイルと並行してよい）
+            bool tileOk = !tiff || tiff->writeTile(t % tilesX, t / tilesX,
+                pixels + (size_t)y0 * params.width + x0, (size_t)params.width);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!tileOk) {
+                    stats.ok = false;
+                    abort = true;
+                    changed.notify_all();
+                    break;
+                }
+                auto it = active.find(frame);
+                if (--it->second.remaining == 0) {
+                    completed.emplace(frame, std::move(it->second));
+                    active.erase(it);
+                    stats.maxReorderDepth = std::max(stats.maxReorderDepth, (int)completed.size());
+                    changed.notify_all();
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++) workers.emplace_back(worker);
+
+    // 書き出し：次の番号のフレームが揃うのを待って順に書く
+    while (written < params.frames) {
+        FrameWork work;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() { return abort || completed.count(written) != 0; });
+            if (abort) break;
+            auto it = completed.find(written);
+            work = std::move(it->second);
+            completed.erase(it);
+        }
+
+        bool ok;
+        if (work.tiff) {
+            // タイルは書き足し済みなので、IFD を書いて閉じるだけ
+            ok = work.tiff->finish();
+        } else {
+            ok = writeImage(numberedPath(params.prefix, written, params.format),
+                work.pixels.data(), params.width, params.height, params.format, imageOptions);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            freeBuffers.push_back(std::move(work.pixels));
+            if (ok) {
+                written++;
+                stats.framesWritten++;
+            } else {
+                stats.ok = false;
+                abort = true;
+            }
+        }
+        changed.notify_all();
+        if (!ok) break;
+    }
+
+    for (auto& th : workers) th.join();
+    stats.elapsedMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+SequenceStats exportAnimationSequence(const AnimationParams& animation, double fps, int octaves,
+    const SequenceParams& sequence) {
+
+    GradientVolume volume = makeAnimationVolume();
+    float inv = 1.0f / animation.gridSize;
+    int width = sequence.width;
+
+    return renderSequence(sequence, [&](int frame, int x0, int y0, int x1, int y1, float* pixels) {
+        float z = (float)(frame / fps * animation.timeScale);
+        for (int y = y0; y < y1; y++) {
+            float* row = pixels + (size_t)y * width;
+            for (int x = x0; x < x1; x++) {
+                row[x] = fbm3(x * inv, y * inv, z, octaves, volume);
+            }
+        }
+    });
+}
@@ -0,0 +1,51 @@
+﻿// 連番フレームのオフライン書き出し
+// フレーム（またはフレーム×タイル）を作業単位として全スレッドに配り、
+// 出来上がったフレームを並べ替えバッファで番号順に戻してから書き出す
+#pragma once
+
+#include <functional>  // タイル描画関数
+#include <string>      // 出力ファイル名
+
+#include "animation.h"  // AnimationParams
+#include "image_io.h"   // ImageFormat
+
+// 連番書き出しの設定
+struct SequenceParams {
+    int width = 1280;            // 横幅（ピクセル）
+    int height = 720;            // 高さ（ピクセル）
+    int frames = 120;            // フレーム数
+    int tileSize = 0;            // タイルの一辺（0 ならフレーム全体を1つの作業にする）
+    int threadCount = 0;         // 生成スレッド数（0 以下なら論理プロセッサ数）
+    int maxFramesInFlight = 0;   // 同時に扱うフレーム数の上限（0 ならスレッド数の2倍）
+    std::string prefix = "frame_";         // 出力ファイル名の先頭
+    ImageFormat format = ImageFormat::PNG; // 書き出す形式
+    bool compress = false;       // TIFF を圧縮する（ImageOptions::compress）
+    AsyncWriteBackend writeBackend = AsyncWriteBackend::Auto;  // TIFF の書き込みのしかた（ImageOptions::writeBackend）
+};
+
+// 書き出しの結果
+struct SequenceStats {
+    bool ok = true;          // すべて書き出せたら true
+    int framesWritten = 0;   // 書き出したフレーム数
+    int maxReorderDepth = 0; // 並べ替えバッファに溜まったフレーム数の最大値
+    double elapsedMs = 0.0;  // 全体の経過時間
+};
+
+// フレーム frame の矩形 [x0, x1) × [y0, y1) を描く関数
+// pixels はフレーム全体のバッファ（width * height 要素）で、矩形の中だけを書く
+typedef std::function<void(int frame, int x0, int y0, int x1, int y1, float* pixels)> TileRenderer;
+
+// 全フレームを生成して番号順に書き出す
+// 書き出しは呼び出し元のスレッドが行い、生成スレッドは書き出しを待たずに次の作業へ進む
+// TIFF でタイルの一辺が 16 の倍数なら、TIFF のタイルを生成のタイルと同じにして、
+// 生成スレッドが描き終えたタイルをその場で符号化してファイルへ書き足す（書き出し側は最後に IFD を書くだけ）
+// params: 書き出しの設定（幅か高さが 0 以下なら何もせず ok = false で戻る）
+// render: タイル描画関数（複数スレッドから同時に呼ばれる）
+SequenceStats renderSequence(const SequenceParams& params, const TileRenderer& render);
+
+// 時間を3軸目にした3Dノイズのアニメーションを連番で書き出す
+// animation: ノイズの設定（width, height は sequence 側の値を使う）
+// fps: 1秒あたりのフレーム数（時間軸の進み方に使う）
+// octaves: 重ねるオクターブ数
+SequenceStats exportAnimationSequence(const AnimationParams& animation, double fps, int octaves,
+    const SequenceParams& sequence);
@@ -0,0 +1,312 @@
+﻿#include "shm_ring.h"
+
+#include <cerrno>   // EEXIST
+#include <chrono>   // 待ち時間
+#include <cstring>  // memcpy, memcmp, memset
+#include <new>      // placement new
+#include <thread>   // sleep_for, yield
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>     // O_CREAT
+#include <sys/mman.h>  // shm_open, mmap
+#include <sys/stat.h>  // fstat
+#include <unistd.h>    // ftruncate, close
+#endif
+
+// 共有メモリの先頭の識別子
+static const char SHM_RING_MAGIC[8] = { 'P', 'N', 'S', 'H', 'R', 'I', 'N', 'G' };
+
+// バイト順の確認用の値
+const uint32_t SHM_RING_BYTE_ORDER = 0x01020304;
+
+// 枠の境界（枠ごとにキャッシュラインを分け、float の行を SIMD で読みやすくする）
+const uint64_t SHM_RING_SLOT_ALIGN = 64;
+
+// 共有メモリの中の atomic はプロセスをまたいで使うので、ロックを使う実装では困る
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "shared-memory counters must be lock-free");
+
+// pred() が true になるまで待つ（初めは回り、その後は眠る時間を少しずつ延ばす）
+// timeoutMs: 待つ時間の上限（負なら無制限）
+// 戻り値: pred() が true になれば true
+template <class Pred>
+static bool waitUntil(Pred pred, int timeoutMs) {
+    auto start = std::chrono::steady_clock::now();
+    int sleepUs = 0;
+    for (int spin = 0; ; spin++) {
+        if (pred()) return true;
+        if (timeoutMs >= 0 && std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(timeoutMs)) {
+            return false;
+        }
+        if (spin < 64) {
+            std::this_thread::yield();
+        } else {
+            sleepUs = sleepUs < 1000 ? sleepUs + 20 : 1000;
+            std::this_thread::sleep_for(std::chrono::microseconds(sleepUs));
+        }
+    }
+}
+
+#if defined(_WIN32)
+static std::string mappingName(const std::string& name) { return "Local\\" + name; }
+#else
+static std::string mappingName(const std::string& name) { return "/" + name; }
+#endif
+
+bool ShmRingMapping::create(const std::string& name, size_t size, bool replace) {
+    unmap();
+    taken = false;
+#if defined(_WIN32)
+    (void)replace; // 名前は開いている全員が閉じたときに消えるので、先に消すことはできない
+    HANDLE map = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        (DWORD)((uint64_t)size >> 32), (DWORD)size, mappingName(name).c_str());
+    if (!map) return false;
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        // 別の生成側（か、まだ開いている読み込み側）が使っている
+        CloseHandle(map);
+        taken = true;
+        return false;
+    }
+    void* address = MapViewOfFile(map, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!address) {
+        CloseHandle(map);
+        return false;
+    }
+    mapping = map;
+#else
+    std::string path = mappingName(name);
+    if (replace) shm_unlink(path.c_str()); // 頼まれたときだけ、前の実行が残した同じ名前のものを消す
+    int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        taken = errno == EEXIST;
+        return false;
+    }
+    void* address = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0) {
+        address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd); // 割り当てが残っていればファイルは閉じてよい
+    if (address == MAP_FAILED) {
+        shm_unlink(path.c_str());
+        return false;
+    }
+    owned = path;
+#endif
+    base = (unsigned char*)address;
+    this->size = size;
+    return true;
+}
+
+bool ShmRingMapping::open(const std::string& name) {
+    unmap();
+#if defined(_WIN32)
+    HANDLE map = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, mappingName(name).c_str());
+    if (!map) return false;
+    void* address = MapViewOfFile(map, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info;
+    if (!address || VirtualQuery(address, &info, sizeof(info)) == 0) {
+        if (address) UnmapViewOfFile(address);
+        CloseHandle(map);
+        return false;
+    }
+    mapping = map;
+    base = (unsigned char*)address;
+    size = (size_t)info.RegionSize;
+#else
+    int fd = shm_open(mappingName(name).c_str(), O_RDWR, 0);
+    if (fd < 0) return false;
+    struct stat info;
+    void* address = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        address = mmap(nullptr, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (address == MAP_FAILED) return false;
+    base = (unsigned char*)address;
+    size = (size_t)info.st_size;
+#endif
+    return true;
+}
+
+void ShmRingMapping::unmap() {
+    if (!base) return;
+#if defined(_WIN32)
+    UnmapViewOfFile(base);
+    CloseHandle((HANDLE)mapping);
+#else
+    munmap(base, size);
+    if (!owned.empty()) shm_unlink(owned.c_str());
+#endif
+    base = nullptr;
+    size = 0;
+    mapping = nullptr;
+    owned.clear();
+}
+
+// 枠 index の先頭
+static unsigned char* slotAddress(ShmRingHeader* header, uint64_t index) {
+    return (unsigned char*)header + header->slotsOffset + (index % header->slotCount) * header->slotBytes;
+}
+
+// 枠の中の値の位置（ShmChunkHeader の直後を 64 バイト境界に揃える）
+static const uint64_t SHM_CHUNK_DATA_OFFSET =
+    (sizeof(ShmChunkHeader) + SHM_RING_SLOT_ALIGN - 1) / SHM_RING_SLOT_ALIGN * SHM_RING_SLOT_ALIGN;
+
+bool ShmRingProducer::create(const std::string& name, int slotCount, int chunkWidth, int chunkHeight,
+    bool replace) {
+    close();
+    if (slotCount <= 0 || chunkWidth <= 0 || chunkHeight <= 0) return false;
+
+    uint64_t dataBytes = (uint64_t)chunkWidth * chunkHeight * sizeof(float);
+    uint64_t slotBytes = (SHM_CHUNK_DATA_OFFSET + dataBytes + SHM_RING_SLOT_ALIGN - 1) /
+        SHM_RING_SLOT_ALIGN * SHM_RING_SLOT_ALIGN;
+    uint64_t slotsOffset = (sizeof(ShmRingHeader) + SHM_RING_SLOT_ALIGN - 1) / SHM_RING_SLOT_ALIGN * SHM_RING_SLOT_ALIGN;
+    uint64_t total = slotsOffset + slotBytes * slotCount;
+    if (total > (uint64_t)SIZE_MAX || !mapping.create(name, (size_t)total, replace)) return false;
+
+    // 見出しを書く（state は最後に Ready にする）
+    header = new (mapping.data()) ShmRingHeader();
+    std::memcpy(header->magic, SHM_RING_MAGIC, sizeof(header->magic));
+    header->version = SHM_RING_VERSION;
+    header->byteOrder = SHM_RING_BYTE_ORDER;
+    header->headerSize = sizeof(ShmRingHeader);
+    header->slotCount = (uint32_t)slotCount;
+    header->chunkWidth = (uint32_t)chunkWidth;
+    header->chunkHeight = (uint32_t)chunkHeight;
+    header->slotBytes = slotBytes;
+    header->slotsOffset = slotsOffset;
+    header->consumerAttached.store(0, std::memory_order_relaxed);
+    header->written.store(0, std::memory_order_relaxed);
+    header->consumed.store(0, std::memory_order_relaxed);
+    header->state.store(SHM_RING_READY, std::memory_order_release);
+    return true;
+}
+
+bool ShmRingProducer::waitForConsumer(int timeoutMs) const {
+    if (!header) return false;
+    return waitUntil([&]() { return header->consumerAttached.load(std::memory_order_acquire) != 0; }, timeoutMs);
+}
+
+float* ShmRingProducer::acquire(int timeoutMs) {
+    if (!header || current) return current;
+    uint64_t written = header->written.load(std::memory_order_relaxed);
+    // 読み込み側が枠を返すまで（consumed が進むまで）待つ
+    bool free = waitUntil([&]() {
+        return written - header->consumed.load(std::memory_order_acquire) < header->slotCount;
+    }, timeoutMs);
+    if (!free) return nullptr;
+    current = (float*)(slotAddress(header, written) + SHM_CHUNK_DATA_OFFSET);
+    return current;
+}
+
+void ShmRingProducer::publish(int x, int y, int width, int height) {
+    if (!header || !current) return;
+    uint64_t written = header->written.load(std::memory_order_relaxed);
+    ShmChunkHeader* chunk = (ShmChunkHeader*)slotAddress(header, written);
+    chunk->x = x;
+    chunk->y = y;
+    chunk->width = width;
+    chunk->height = height;
+    chunk->sequence = written;
+    chunk->reserved = 0;
+    current = nullptr;
+    // 値と情報を書き終えてから数を進める（読み込み側は数を見てから読む）
+    header->written.store(written + 1, std::memory_order_release);
+}
+
+void ShmRingProducer::finish() {
+    if (header) header->state.store(SHM_RING_FINISHED, std::memory_order_release);
+}
+
+bool ShmRingProducer::waitForDrain(int timeoutMs) const {
+    if (!header) return false;
+    uint64_t written = header->written.load(std::memory_order_relaxed);
+    return waitUntil([&]() { return header->consumed.load(std::memory_order_acquire) >= written; }, timeoutMs);
+}
+
+void ShmRingProducer::close() {
+    if (header) finish();
+    header = nullptr;
+    current = nullptr;
+    mapping.unmap();
+}
+
+bool ShmRingConsumer::attach(const std::string& name, int timeoutMs) {
+    close();
+
+    // 生成側が作るまで待つ
+    bool opened = waitUntil([&]() { return mapping.open(name); }, timeoutMs);
+    if (!opened || mapping.bytes() < sizeof(ShmRingHeader)) {
+        close();
+        return false;
+    }
+    ShmRingHeader* h = (ShmRingHeader*)mapping.data();
+    bool ready = waitUntil([&]() { return h->state.load(std::memory_order_acquire) != SHM_RING_CREATING; }, timeoutMs);
+
+    // 形式を確かめる（合わなければ割り当てを解除する）
+    uint64_t minSlot = SHM_CHUNK_DATA_OFFSET + (uint64_t)h->chunkWidth * h->chunkHeight * sizeof(float);
+    bool valid = ready &&
+        std::memcmp(h->magic, SHM_RING_MAGIC, sizeof(h->magic)) == 0 &&
+        h->version == SHM_RING_VERSION &&
+        h->byteOrder == SHM_RING_BYTE_ORDER &&
+        h->headerSize == sizeof(ShmRingHeader) &&
+        h->slotCount > 0 && h->chunkWidth > 0 && h->chunkHeight > 0 &&
+        h->slotBytes >= minSlot && h->slotBytes % SHM_RING_SLOT_ALIGN == 0 &&
+        h->slotsOffset >= sizeof(ShmRingHeader) &&
+        h->slotsOffset + h->slotBytes * h->slotCount <= mapping.bytes();
+    if (!valid) {
+        close();
+        return false;
+    }
+
+    header = h;
+    header->consumerAttached.store(1, std::memory_order_release);
+    return true;
+}
+
+bool ShmRingConsumer::next(ShmChunk& chunk, int timeoutMs) {
+    if (!header || holding) return false;
+    uint64_t consumed = header->consumed.load(std::memory_order_relaxed);
+    bool available = waitUntil([&]() {
+        return header->written.load(std::memory_order_acquire) > consumed ||
+            header->state.load(std::memory_order_acquire) == SHM_RING_FINISHED;
+    }, timeoutMs);
+    // 終了を見た後でも、終了の前に書かれたチャンクが残っていれば読む
+    if (!available || header->written.load(std::memory_order_acquire) <= consumed) return false;
+
+    const unsigned char* slot = slotAddress(header, consumed);
+    const ShmChunkHeader* info = (const ShmChunkHeader*)slot;
+    if (info->width <= 0 || info->height <= 0 ||
+        info->width > (int32_t)header->chunkWidth || info->height > (int32_t)header->chunkHeight) {
+        return false;
+    }
+    chunk.x = info->x;
+    chunk.y = info->y;
+    chunk.width = info->width;
+    chunk.height = info->height;
+    chunk.sequence = info->sequence;
+    chunk.values = (const float*)(slot + SHM_CHUNK_DATA_OFFSET);
+    chunk.stride = header->chunkWidth;
+    holding = true;
+    return true;
+}
+
+void ShmRingConsumer::release() {
+    if (!header || !holding) return;
+    holding = false;
+    // 読み終えてから枠を返す（生成側は数を見てから書き始める）
+    header->consumed.fetch_add(1, std::memory_order_release);
+}
+
+bool ShmRingConsumer::finished() const {
+    if (!header) return true;
+    return header->state.load(std::memory_order_acquire) == SHM_RING_FINISHED &&
+        header->consumed.load(std::memory_order_relaxed) >= header->written.load(std::memory_order_acquire);
+}
+
+void ShmRingConsumer::close() {
+    header = nullptr;
+    holding = false;
+    mapping.unmap();
+}
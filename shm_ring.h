@@ -0,0 +1,172 @@
+﻿// 共有メモリのリングによるチャンクの受け渡し（同じマシンの別プロセス向け）
+// 生成側はチャンク（高さマップの矩形）を共有メモリの枠に直接描き、読み込み側はその枠をそのまま読む
+// 値のコピーや直列化は無く、やり取りするのは枠の番号を表す2つのカウンタだけ
+//
+// 共有メモリの構成（値はすべて生成側のマシンのバイト順。読み込み側も同じマシンで動く前提）
+//   ShmRingHeader（192 バイト）
+//   枠 × slotCount（各枠は ShmChunkHeader の後に chunkWidth * chunkHeight 個の float。64 バイト境界に揃える）
+//
+// 手順（生成側 1 つ、読み込み側 1 つ）
+//   1. 生成側が共有メモリを作り、見出しを書いてから state を Ready にする
+//   2. 読み込み側が開いて形式を確かめ、consumerAttached を 1 にする（生成側は waitForConsumer で待てる）
+//   3. 生成側は acquire で空いた枠を受け取って描き、publish で written を進める
+//      （読み込み側より slotCount 個先に進んだら、読み込み側が枠を返すまで待つ）
+//   4. 読み込み側は next で次の枠を受け取って読み、release で consumed を進めて枠を返す
+//   5. 生成側は最後に finish で state を Finished にする。読み込み側は残りの枠を読み終えたら終わる
+// カウンタは lock-free の atomic で、待つ側は短い間だけ回ってから少しずつ眠る（プロセスをまたぐ待ち合わせの仕組みは使わない）
+#pragma once
+
+#include <atomic>   // プロセス間で共有するカウンタ
+#include <cstddef>  // size_t
+#include <cstdint>  // uint32_t, uint64_t
+#include <string>   // 共有メモリの名前
+
+// 共有メモリの形式のバージョン（互換性の無い変更をしたときだけ上げる）
+const uint32_t SHM_RING_VERSION = 1;
+
+// 共有メモリの状態
+enum ShmRingState : uint32_t {
+    SHM_RING_CREATING = 0,  // 生成側が見出しを書いている
+    SHM_RING_READY = 1,     // 読み込み側が開いてよい
+    SHM_RING_FINISHED = 2,  // 生成側はもうチャンクを書かない
+};
+
+// 共有メモリの先頭に置く情報
+// 生成側が書き換えるカウンタと読み込み側が書き換えるカウンタは、別のキャッシュラインに置く
+struct ShmRingHeader {
+    char magic[8];                           // "PNSHRING"
+    uint32_t version;                        // SHM_RING_VERSION
+    uint32_t byteOrder;                      // 0x01020304
+    uint32_t headerSize;                     // sizeof(ShmRingHeader)
+    uint32_t slotCount;                      // 枠の数
+    uint32_t chunkWidth;                     // チャンクの最大の大きさ
+    uint32_t chunkHeight;
+    uint64_t slotBytes;                      // 1つの枠の大きさ（ShmChunkHeader を含む）
+    uint64_t slotsOffset;                    // 最初の枠の位置（共有メモリの先頭から）
+    std::atomic<uint32_t> state;             // ShmRingState
+    std::atomic<uint32_t> consumerAttached;  // 読み込み側が開いたら 1
+    alignas(64) std::atomic<uint64_t> written;   // 生成側が書き終えたチャンクの数
+    alignas(64) std::atomic<uint64_t> consumed;  // 読み込み側が返したチャンクの数
+};
+
+// 枠の先頭に置くチャンクの情報
+struct ShmChunkHeader {
+    int32_t x;          // チャンクの左上のピクセル座標
+    int32_t y;
+    int32_t width;      // チャンクの大きさ（chunkWidth, chunkHeight 以下）
+    int32_t height;
+    uint64_t sequence;  // 何番目のチャンクか（0 から）
+    uint64_t reserved;
+};
+
+// 受け取ったチャンク
+// values は共有メモリの中を直接指し、行 y の先頭は values + y * stride（release するまで有効）
+struct ShmChunk {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    uint64_t sequence = 0;
+    const float* values = nullptr;
+    size_t stride = 0;
+};
+
+// 共有メモリの割り当て（生成側・読み込み側の共通部分）
+class ShmRingMapping {
+public:
+    ShmRingMapping() {}
+    ~ShmRingMapping() { unmap(); }
+    ShmRingMapping(const ShmRingMapping&) = delete;
+    ShmRingMapping& operator=(const ShmRingMapping&) = delete;
+
+    // 名前の付いた共有メモリを作る／開く
+    // name: 英数字の名前（POSIX では "/" + name の shm、Windows では "Local\" + name のファイルマッピング）
+    // replace: 同じ名前のものが既にあれば消してから作る（false なら失敗し、nameTaken() が true になる）
+    //   POSIX では落ちた生成側の残した名前を片付けるのに使う。使用中のものを消すと、相手は古い方を使い続ける
+    //   Windows では名前は使う側がすべて閉じると消えるので残らず、使用中のものは消せない（replace は効かない）
+    bool create(const std::string& name, size_t size, bool replace = false);
+    bool open(const std::string& name);
+
+    // 直前の create が、同じ名前のものが既にあったために失敗した
+    bool nameTaken() const { return taken; }
+
+    // 割り当てを解除する（作った側なら名前も消す。割り当て済みの相手はそのまま使い続けられる）
+    void unmap();
+
+    bool isMapped() const { return base != nullptr; }
+    unsigned char* data() const { return base; }
+    size_t bytes() const { return size; }
+
+private:
+    unsigned char* base = nullptr;
+    size_t size = 0;
+    void* mapping = nullptr;  // Windows のファイルマッピングのハンドル
+    std::string owned;        // 作った側なら消すときの名前
+    bool taken = false;       // 直前の create で名前が使われていた
+};
+
+// 生成側
+class ShmRingProducer {
+public:
+    // 共有メモリを作って見出しを書く
+    // slotCount: 枠の数（読み込み側より何チャンク先まで書けるか）
+    // chunkWidth, chunkHeight: チャンクの最大の大きさ
+    // replace: 同じ名前のものが既にあれば消してから作る（ShmRingMapping::create を参照）
+    bool create(const std::string& name, int slotCount, int chunkWidth, int chunkHeight, bool replace = false);
+
+    // 直前の create が、同じ名前のものが既にあったために失敗した
+    bool nameTaken() const { return mapping.nameTaken(); }
+
+    // 読み込み側が開くまで待つ（timeoutMs < 0 なら無制限）
+    bool waitForConsumer(int timeoutMs) const;
+
+    // 次の枠を受け取る（空くまで待つ。timeoutMs < 0 なら無制限）
+    // 戻り値: 描き込み先（行 y の先頭は戻り値 + y * stride()）。時間切れなら nullptr
+    float* acquire(int timeoutMs);
+
+    // acquire した枠に描いたチャンクを読み込み側へ渡す
+    void publish(int x, int y, int width, int height);
+
+    // もう書かないことを読み込み側へ伝える
+    void finish();
+
+    // 読み込み側がすべての枠を返すまで待つ（timeoutMs < 0 なら無制限）
+    bool waitForDrain(int timeoutMs) const;
+
+    void close();
+
+    size_t stride() const { return header ? header->chunkWidth : 0; }
+    uint64_t published() const { return header ? header->written.load(std::memory_order_relaxed) : 0; }
+
+private:
+    ShmRingMapping mapping;
+    ShmRingHeader* header = nullptr;
+    float* current = nullptr;  // acquire した枠
+};
+
+// 読み込み側
+class ShmRingConsumer {
+public:
+    // 共有メモリを開いて形式を確かめ、開いたことを生成側に伝える（state が Ready になるまで待つ）
+    bool attach(const std::string& name, int timeoutMs);
+
+    // 次のチャンクを受け取る（届くまで待つ。timeoutMs < 0 なら無制限）
+    // 戻り値: 受け取れたら true（時間切れ、または生成側が終えて残りも無ければ false）
+    bool next(ShmChunk& chunk, int timeoutMs);
+
+    // next で受け取った枠を生成側へ返す
+    void release();
+
+    // 生成側が終えていて、読み残しも無い
+    bool finished() const;
+
+    void close();
+
+    int chunkWidth() const { return header ? (int)header->chunkWidth : 0; }
+    int chunkHeight() const { return header ? (int)header->chunkHeight : 0; }
+
+private:
+    ShmRingMapping mapping;
+    ShmRingHeader* header = nullptr;
+    bool holding = false;  // next で受け取って release していない枠がある
+};
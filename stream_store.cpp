@@ -0,0 +1,84 @@
+﻿#include "stream_store.h"
+
+#include <cstdint>  // uintptr_t
+#include <cstring>  // memcpy
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <unistd.h> // sysconf
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define STREAM_STORE_X86 1
+#endif
+
+// LLC の大きさが分からないときに使う値
+const size_t DEFAULT_LLC_BYTES = (size_t)8 << 20;
+
+// LLC の大きさを OS に問い合わせる（分からなければ 0）
+static size_t queryLastLevelCache() {
+#if defined(_WIN32)
+    DWORD bytes = 0;
+    GetLogicalProcessorInformation(nullptr, &bytes);
+    if (bytes == 0) return 0;
+    std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(bytes / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+    if (!GetLogicalProcessorInformation(info.data(), &bytes)) return 0;
+    size_t best = 0;
+    int bestLevel = 0;
+    for (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION& entry : info) {
+        if (entry.Relationship != RelationCache) continue;
+        int level = entry.Cache.Level;
+        if (level > bestLevel || (level == bestLevel && entry.Cache.Size > best)) {
+            bestLevel = level;
+            best = entry.Cache.Size;
+        }
+    }
+    return best;
+#elif defined(_SC_LEVEL3_CACHE_SIZE)
+    long l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (l3 > 0) return (size_t)l3;
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    return l2 > 0 ? (size_t)l2 : 0;
+#else
+    return 0;
+#endif
+}
+
+size_t lastLevelCacheBytes() {
+    static const size_t bytes = queryLastLevelCache();
+    return bytes > 0 ? bytes : DEFAULT_LLC_BYTES;
+}
+
+StoreMode resolveStoreMode(StoreMode mode, size_t outputBytes) {
+    if (mode != StoreMode::Auto) return mode;
+    return outputBytes > lastLevelCacheBytes() ? StoreMode::Streaming : StoreMode::Normal;
+}
+
+void streamStoreFloats(float* dst, const float* src, size_t count) {
+#if defined(STREAM_STORE_X86)
+    // 非テンポラルストアは 16 バイト境界に揃った先にしか書けないので、境界までは通常のストアで書く
+    size_t i = 0;
+    while (i < count && ((uintptr_t)(dst + i) & 15) != 0) {
+        dst[i] = src[i];
+        i++;
+    }
+    for (; i + 16 <= count; i += 16) {
+        _mm_stream_ps(dst + i, _mm_loadu_ps(src + i));
+        _mm_stream_ps(dst + i + 4, _mm_loadu_ps(src + i + 4));
+        _mm_stream_ps(dst + i + 8, _mm_loadu_ps(src + i + 8));
+        _mm_stream_ps(dst + i + 12, _mm_loadu_ps(src + i + 12));
+    }
+    for (; i + 4 <= count; i += 4) _mm_stream_ps(dst + i, _mm_loadu_ps(src + i));
+    for (; i < count; i++) dst[i] = src[i];
+#else
+    std::memcpy(dst, src, count * sizeof(float));
+#endif
+}
+
+void streamStoreFence() {
+#if defined(STREAM_STORE_X86)
+    _mm_sfence();
+#endif
+}
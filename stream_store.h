@@ -0,0 +1,62 @@
+﻿// 書き込んだ後に読み返さない大きな出力バッファへのストリーミングストア
+// 画像全体の高さマップのように一度書くだけの出力を通常のストアで埋めると、
+// 出力がキャッシュを押し流し、勾配配列など何度も読むデータまで追い出してしまう
+// 出力が最終レベルキャッシュ（LLC）より大きいときは、各スレッドが1行をキャッシュに収まる作業領域に作り、
+// 非テンポラルストア（キャッシュを経由しない書き込み）で出力へ移す
+#pragma once
+
+#include <cstddef>  // size_t
+#include <vector>   // 1行分の作業領域
+
+#include "parallel.h" // parallelFor
+
+// 出力への書き込み方
+enum class StoreMode {
+    Auto,       // 出力が LLC より大きければ Streaming、そうでなければ Normal
+    Normal,     // 出力に直接書く
+    Streaming,  // 作業領域に書いてから非テンポラルストアで移す
+};
+
+// 最終レベルキャッシュの大きさ（バイト、取得できなければ 8MiB とみなす）
+size_t lastLevelCacheBytes();
+
+// 出力の大きさから書き込み方を決める
+// mode: Auto 以外ならそのまま返す
+// outputBytes: 出力全体のバイト数
+StoreMode resolveStoreMode(StoreMode mode, size_t outputBytes);
+
+// src の count 個の float を dst へ非テンポラルストアで写す
+// x86 以外では通常のコピーになる
+// 書いた値を他のスレッドに見せる前に streamStoreFence を呼ぶこと
+void streamStoreFloats(float* dst, const float* src, size_t count);
+
+// それまでの非テンポラルストアを完了させる（以降のストアより先に見えるようにする）
+void streamStoreFence();
+
+// 行ごとに値を求めて出力を埋める（行は複数スレッドで分担する）
+// out: 出力先（行 y の先頭は out + y * stride）
+// width, height: 出力の大きさ
+// threadCount: スレッド数（0 以下なら論理プロセッサ数）
+// rowFunc: void(float* row, int y)。row に width 個の値を書く
+// mode: 書き込み方
+template <class RowFunc>
+void writeRows(float* out, int width, int height, size_t stride, int threadCount, RowFunc rowFunc,
+    StoreMode mode = StoreMode::Auto) {
+
+    mode = resolveStoreMode(mode, (size_t)height * stride * sizeof(float));
+    if (mode != StoreMode::Streaming) {
+        parallelFor(height, threadCount, [&](int y) {
+            rowFunc(out + (size_t)y * stride, y);
+        });
+        return;
+    }
+
+    parallelFor(height, threadCount, [&](int y) {
+        // 作業領域はスレッドごとに1行分だけ持ち、L1/L2 に載ったまま使い回す
+        thread_local std::vector<float> scratch;
+        if (scratch.size() < (size_t)width) scratch.resize(width);
+        rowFunc(scratch.data(), y);
+        streamStoreFloats(out + (size_t)y * stride, scratch.data(), (size_t)width);
+        streamStoreFence();
+    });
+}
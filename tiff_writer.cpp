@@ -0,0 +1,374 @@
+﻿#include "tiff_writer.h"
+
+#include <algorithm> // std::min, std::fill
+#include <cstring>  // memcpy
+
+#include "image_io.h" // noiseToGray16
+
+// ヘッダの大きさ
+const uint64_t TIFF_HEADER_SIZE = 8;
+
+// TIFF のタグの番号
+const uint16_t TAG_IMAGE_WIDTH = 256;
+const uint16_t TAG_IMAGE_LENGTH = 257;
+const uint16_t TAG_BITS_PER_SAMPLE = 258;
+const uint16_t TAG_COMPRESSION = 259;
+const uint16_t TAG_PHOTOMETRIC = 262;
+const uint16_t TAG_SAMPLES_PER_PIXEL = 277;
+const uint16_t TAG_PLANAR_CONFIGURATION = 284;
+const uint16_t TAG_PREDICTOR = 317;
+const uint16_t TAG_TILE_WIDTH = 322;
+const uint16_t TAG_TILE_LENGTH = 323;
+const uint16_t TAG_TILE_OFFSETS = 324;
+const uint16_t TAG_TILE_BYTE_COUNTS = 325;
+const uint16_t TAG_SAMPLE_FORMAT = 339;
+
+// タグの値の型
+const uint16_t TYPE_SHORT = 3;
+const uint16_t TYPE_LONG = 4;
+
+// タグの値
+const uint16_t COMPRESSION_NONE = 1;
+const uint16_t COMPRESSION_LZW = 5;
+const uint16_t PREDICTOR_HORIZONTAL = 2;
+const uint16_t PREDICTOR_FLOATING_POINT = 3;
+const uint16_t SAMPLE_FORMAT_UINT = 1;
+const uint16_t SAMPLE_FORMAT_FLOAT = 3;
+
+static void appendLE16(std::vector<unsigned char>& out, uint16_t v) {
+    out.push_back((unsigned char)v);
+    out.push_back((unsigned char)(v >> 8));
+}
+
+static void appendLE32(std::vector<unsigned char>& out, uint32_t v) {
+    out.push_back((unsigned char)v);
+    out.push_back((unsigned char)(v >> 8));
+    out.push_back((unsigned char)(v >> 16));
+    out.push_back((unsigned char)(v >> 24));
+}
+
+// TIFF の LZW 符号（libtiff と同じく、符号の幅は 9〜12 ビットで、上位ビットから詰める）
+class LzwEncoder {
+public:
+    // data を符号化して out に追加する（タイル1つが1つの符号列になる）
+    void encode(const unsigned char* data, size_t size, std::vector<unsigned char>& out) {
+        this->out = &out;
+        bitBuffer = 0;
+        bitCount = 0;
+        reset();
+        put(LZW_CLEAR);
+
+        int prefix = size > 0 ? data[0] : -1;
+        for (size_t i = 1; i < size; i++) {
+            int c = data[i];
+            uint32_t key = ((uint32_t)prefix << 8) | (uint32_t)c;
+            size_t slot = find(key);
+            if (keys[slot] == key && stamps[slot] == generation) {
+                prefix = codes[slot];
+                continue;
+            }
+            put(prefix);
+            keys[slot] = key;
+            codes[slot] = (uint16_t)nextCode;
+            stamps[slot] = generation;
+            prefix = c;
+            grow();
+        }
+        if (prefix >= 0) {
+            put(prefix);
+            grow();
+        }
+        put(LZW_END);
+        if (bitCount > 0) out.push_back((unsigned char)(bitBuffer << (8 - bitCount)));
+    }
+
+private:
+    static const int LZW_CLEAR = 256;         // 表を初期化する符号
+    static const int LZW_END = 257;           // 符号列の終わり
+    static const int LZW_FIRST = 258;         // 最初に追加する符号
+    static const int LZW_LIMIT = 4094;        // ここまで増えたら表を初期化する
+    static const size_t HASH_SIZE = 1 << 14;  // 表のハッシュの大きさ（符号の数より十分大きい2の累乗）
+
+    // 表の初期化（ハッシュは世代の番号を変えるだけで消す）
+    void reset() {
+        if (keys.empty()) {
+            keys.assign(HASH_SIZE, 0);
+            codes.assign(HASH_SIZE, 0);
+            stamps.assign(HASH_SIZE, 0);
+        }
+        generation++;
+        if (generation == 0) {
+            std::fill(stamps.begin(), stamps.end(), 0);
+            generation = 1;
+        }
+        nextCode = LZW_FIRST;
+        bits = 9;
+    }
+
+    // key の入っている場所か、入れるべき空いた場所
+    size_t find(uint32_t key) const {
+        size_t slot = (key * 2654435761u) >> 18 & (HASH_SIZE - 1);
+        while (stamps[slot] == generation && keys[slot] != key) slot = (slot + 1) & (HASH_SIZE - 1);
+        return slot;
+    }
+
+    // 符号を1つ追加した後の処理（表が一杯なら初期化し、そうでなければ必要に応じて幅を広げる）
+    void grow() {
+        nextCode++;
+        if (nextCode == LZW_LIMIT) {
+            put(LZW_CLEAR);
+            reset();
+        } else if (nextCode > (1 << bits) - 1) {
+            bits++;
+        }
+    }
+
+    void put(int code) {
+        bitBuffer = (bitBuffer << bits) | (uint32_t)code;
+        bitCount += bits;
+        while (bitCount >= 8) {
+            bitCount -= 8;
+            out->push_back((unsigned char)(bitBuffer >> bitCount));
+        }
+        bitBuffer &= (1u << bitCount) - 1;
+    }
+
+    std::vector<uint32_t> keys;    // (前の符号 << 8) | 次のバイト
+    std::vector<uint16_t> codes;   // その並びの符号
+    std::vector<uint32_t> stamps;  // 書き込んだときの世代（今の世代でなければ空き）
+    uint32_t generation = 0;
+    int nextCode = LZW_FIRST;
+    int bits = 9;
+    uint32_t bitBuffer = 0;
+    int bitCount = 0;
+    std::vector<unsigned char>* out = nullptr;
+};
+
+// 1タイル分をファイルに書くバイト列にする
+// validWidth, validHeight: 画像の内側にある部分の大きさ（残りは 0 で埋める）
+static void encodeTile(const float* values, size_t stride, int validWidth, int validHeight,
+    const TiffOptions& options, std::vector<unsigned char>& out) {
+
+    const int size = options.tileSize;
+    const bool isFloat = options.sample == TiffSampleFormat::Float32;
+    const size_t rowBytes = (size_t)size * (isFloat ? 4 : 2);
+    std::vector<unsigned char> row(rowBytes);
+    std::vector<uint32_t> samples(size);
+    thread_local std::vector<unsigned char> predicted;
+    predicted.clear();
+
+    out.clear();
+    for (int y = 0; y < size; y++) {
+        // 画素の値（16bit は変換した整数、float はビット列）
+        for (int x = 0; x < size; x++) {
+            uint32_t v = 0;
+            if (x < validWidth && y < validHeight) {
+                float n = values[(size_t)y * stride + x];
+                if (isFloat) {
+                    std::memcpy(&v, &n, sizeof(v));
+                } else {
+                    v = noiseToGray16(n);
+                }
+            }
+            samples[x] = v;
+        }
+
+        if (!isFloat) {
+            // 水平差分（Predictor 2）: 左の画素との差を 16bit で持つ
+            for (int x = size - 1; options.compress && x > 0; x--) samples[x] = (samples[x] - samples[x - 1]) & 0xFFFF;
+            for (int x = 0; x < size; x++) {
+                row[x * 2] = (unsigned char)samples[x];
+                row[x * 2 + 1] = (unsigned char)(samples[x] >> 8);
+            }
+        } else if (options.compress) {
+            // 浮動小数点の予測（Predictor 3）: 上位バイトから順にバイト面に分け、行全体で隣のバイトとの差を取る
+            for (int x = 0; x < size; x++) {
+                row[x] = (unsigned char)(samples[x] >> 24);
+                row[size + x] = (unsigned char)(samples[x] >> 16);
+                row[size * 2 + x] = (unsigned char)(samples[x] >> 8);
+                row[size * 3 + x] = (unsigned char)samples[x];
+            }
+            for (size_t i = rowBytes - 1; i > 0; i--) row[i] = (unsigned char)(row[i] - row[i - 1]);
+        } else {
+            for (int x = 0; x < size; x++) {
+                row[x * 4] = (unsigned char)samples[x];
+                row[x * 4 + 1] = (unsigned char)(samples[x] >> 8);
+                row[x * 4 + 2] = (unsigned char)(samples[x] >> 16);
+                row[x * 4 + 3] = (unsigned char)(samples[x] >> 24);
+            }
+        }
+
+        std::vector<unsigned char>& target = options.compress ? predicted : out;
+        target.insert(target.end(), row.begin(), row.end());
+    }
+
+    // 予測符号化した全行を1つの LZW 符号列にする
+    if (options.compress) {
+        thread_local LzwEncoder encoder;
+        encoder.encode(predicted.data(), predicted.size(), out);
+    }
+}
+
+bool TiledTiffWriter::open(const std::string& path, int width, int height, const TiffOptions& options) {
+    close();
+    if (width <= 0 || height <= 0 || options.tileSize <= 0) return false;
+
+    this->options = options;
+    this->options.tileSize = (options.tileSize + TIFF_TILE_ALIGN - 1) / TIFF_TILE_ALIGN * TIFF_TILE_ALIGN;
+    this->width = width;
+    this->height = height;
+    across = (width + this->options.tileSize - 1) / this->options.tileSize;
+    down = (height + this->options.tileSize - 1) / this->options.tileSize;
+    offsets.assign((size_t)across * down, 0);
+    byteCounts.assign((size_t)across * down, 0);
+    failed = false;
+
+    if (!file.open(path, options.writeBackend, options.writeQueueDepth)) return false;
+
+    // 先頭の8バイトはヘッダの場所として空けておき、IFD の位置が決まる finish() で一度だけ書く
+    // （書き込みは順不同に終わるので、同じ範囲を後から書き換えると古い内容が勝つことがある）
+    end = TIFF_HEADER_SIZE;
+    return true;
+}
+
+bool TiledTiffWriter::writeTile(int tx, int ty, const float* values, size_t stride) {
+    if (tx < 0 || ty < 0 || tx >= across || ty >= down) return false;
+
+    // 符号化はロックの外で行う（書き込みの終わったバッファを使い回す）
+    std::vector<unsigned char> encoded = file.takeBuffer();
+    int x0 = tx * options.tileSize;
+    int y0 = ty * options.tileSize;
+    encodeTile(values, stride, std::min(options.tileSize, width - x0), std::min(options.tileSize, height - y0),
+        options, encoded);
+
+    // ファイルの中の位置だけをロックの中で決める
+    uint64_t offset;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t index = (size_t)ty * across + tx;
+        if (failed || !file.isOpen() || byteCounts[index] != 0) return false;
+
+        // 通常の TIFF は位置を 32bit で持つので、4GiB を超えたら失敗にする
+        if (end + encoded.size() > 0xFFFFFFFFull) {
+            failed = true;
+            return false;
+        }
+        offset = end;
+        offsets[index] = (uint32_t)end;
+        byteCounts[index] = (uint32_t)encoded.size();
+        end += encoded.size();
+    }
+
+    if (!file.write(offset, std::move(encoded))) {
+        std::lock_guard<std::mutex> lock(mutex);
+        failed = true;
+        return false;
+    }
+    return true;
+}
+
+bool TiledTiffWriter::finish() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!file.isOpen()) return false;
+    bool ok = !failed;
+    for (uint32_t count : byteCounts) {
+        if (count == 0) ok = false;
+    }
+
+    // IFD の項目（タグの番号順）
+    struct Entry {
+        uint16_t tag;
+        uint16_t type;
+        const std::vector<uint32_t>* array;  // 値が2つ以上あるときの配列（無ければ value を使う）
+        uint32_t value;
+    };
+    const bool isFloat = options.sample == TiffSampleFormat::Float32;
+    std::vector<Entry> entries = {
+        { TAG_IMAGE_WIDTH, TYPE_LONG, nullptr, (uint32_t)width },
+        { TAG_IMAGE_LENGTH, TYPE_LONG, nullptr, (uint32_t)height },
+        { TAG_BITS_PER_SAMPLE, TYPE_SHORT, nullptr, isFloat ? 32u : 16u },
+        { TAG_COMPRESSION, TYPE_SHORT, nullptr, options.compress ? COMPRESSION_LZW : COMPRESSION_NONE },
+        { TAG_PHOTOMETRIC, TYPE_SHORT, nullptr, 1 },  // 0 が黒
+        { TAG_SAMPLES_PER_PIXEL, TYPE_SHORT, nullptr, 1 },
+        { TAG_PLANAR_CONFIGURATION, TYPE_SHORT, nullptr, 1 },
+    };
+    if (options.compress) {
+        entries.push_back({ TAG_PREDICTOR, TYPE_SHORT, nullptr,
+            isFloat ? PREDICTOR_FLOATING_POINT : PREDICTOR_HORIZONTAL });
+    }
+    entries.push_back({ TAG_TILE_WIDTH, TYPE_LONG, nullptr, (uint32_t)options.tileSize });
+    entries.push_back({ TAG_TILE_LENGTH, TYPE_LONG, nullptr, (uint32_t)options.tileSize });
+    entries.push_back({ TAG_TILE_OFFSETS, TYPE_LONG, &offsets, 0 });
+    entries.push_back({ TAG_TILE_BYTE_COUNTS, TYPE_LONG, &byteCounts, 0 });
+    entries.push_back({ TAG_SAMPLE_FORMAT, TYPE_SHORT, nullptr, isFloat ? SAMPLE_FORMAT_FLOAT : SAMPLE_FORMAT_UINT });
+
+    // IFD は偶数の位置から始める。配列は IFD の直後に置く
+    uint64_t ifdOffset = (end + 1) & ~1ull;
+    uint64_t arrayOffset = ifdOffset + 2 + entries.size() * 12 + 4;
+    uint64_t total = arrayOffset;
+    for (const Entry& e : entries) {
+        if (e.array && e.array->size() > 1) total += e.array->size() * 4;
+    }
+    if (total > 0xFFFFFFFFull) ok = false;
+
+    if (ok) {
+        std::vector<unsigned char> block;
+        if (ifdOffset != end) block.push_back(0);
+        appendLE16(block, (uint16_t)entries.size());
+        std::vector<unsigned char> arrays;
+        for (const Entry& e : entries) {
+            uint32_t count = e.array ? (uint32_t)e.array->size() : 1;
+            appendLE16(block, e.tag);
+            appendLE16(block, e.type);
+            appendLE32(block, count);
+            if (count > 1) {
+                appendLE32(block, (uint32_t)(arrayOffset + arrays.size()));
+                for (uint32_t v : *e.array) appendLE32(arrays, v);
+            } else {
+                uint32_t v = e.array ? (*e.array)[0] : e.value;
+                // SHORT の値は4バイトの欄の先頭に詰める
+                if (e.type == TYPE_SHORT) {
+                    appendLE16(block, (uint16_t)v);
+                    appendLE16(block, 0);
+                } else {
+                    appendLE32(block, v);
+                }
+            }
+        }
+        appendLE32(block, 0); // 次の IFD は無い
+        block.insert(block.end(), arrays.begin(), arrays.end());
+        ok = file.write(end, std::move(block));
+
+        // "II"（リトルエンディアン）、42、IFD の位置
+        std::vector<unsigned char> header;
+        header.push_back('I');
+        header.push_back('I');
+        appendLE16(header, 42);
+        appendLE32(header, (uint32_t)ifdOffset);
+        ok = ok && file.write(0, std::move(header));
+    }
+
+    // 残りの書き込みを待って閉じる
+    ok = file.close() && ok;
+    return ok;
+}
+
+void TiledTiffWriter::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    file.close();
+}
+
+bool writeTiff(const std::string& path, const float* values, int width, int height, const TiffOptions& options) {
+    TiledTiffWriter writer;
+    if (!writer.open(path, width, height, options)) return false;
+
+    // ファイルの中身が毎回同じになるよう、タイルは行優先の順に1スレッドで書く
+    int size = writer.tileSize();
+    for (int ty = 0; ty < writer.tilesDown(); ty++) {
+        for (int tx = 0; tx < writer.tilesAcross(); tx++) {
+            const float* tile = values + (size_t)ty * size * width + (size_t)tx * size;
+            if (!writer.writeTile(tx, ty, tile, (size_t)width)) return false;
+        }
+    }
+    return writer.finish();
+}
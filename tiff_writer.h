@@ -0,0 +1,91 @@
+﻿// タイル分割した TIFF の書き出し（16bit 整数または 32bit 浮動小数点のグレースケール）
+// GIS や映像制作のツールで高さマップとして読める形式で、8bit の PGM / PNG より階調が細かい
+// タイルは生成側のタイルと同じ大きさにできるので、連番書き出しでは出来上がったタイルから順に書ける
+// ファイルへの書き込みは AsyncFileWriter に任せるので、タイルを書くスレッドは書き込みの完了を待たない
+//
+// ファイルの構成（リトルエンディアン、TIFF 6.0 のタイル形式）
+//   ヘッダ（8 バイト、IFD の位置が決まる finish() でまとめて書く）
+//   タイルのデータ（書き込んだ順、位置は IFD の TileOffsets に記録する）
+//   IFD と、タイルの位置・大きさの配列
+// 圧縮を選ぶと、各行に予測符号化（16bit は水平差分、float はバイト面ごとの差分）をかけてからタイルごとに LZW で詰める
+// （libtiff などの読み込み側は予測符号化を LZW / Deflate との組み合わせでしか扱わないので PackBits は使わない）
+#pragma once
+
+#include <cstddef>  // size_t
+#include <cstdint>  // uint32_t
+#include <mutex>    // タイルの書き込みの排他
+#include <string>   // ファイル名
+#include <vector>   // ベクタ型を使用するため
+
+#include "async_writer.h" // 非同期のファイル書き込み
+
+// TIFF のタイルの一辺は 16 の倍数でなければならない
+const int TIFF_TILE_ALIGN = 16;
+
+// 画素の形式
+enum class TiffSampleFormat {
+    UInt16,   // ノイズ値（-1.0〜1.0）を 0〜65535 に変換する
+    Float32,  // ノイズ値をそのまま書く
+};
+
+// 書き出しの設定
+struct TiffOptions {
+    TiffSampleFormat sample = TiffSampleFormat::Float32;
+    int tileSize = 256;      // タイルの一辺（16 の倍数に切り上げる）
+    bool compress = false;   // 予測符号化 + LZW で圧縮する
+    AsyncWriteBackend writeBackend = AsyncWriteBackend::Auto;  // ファイルへの書き込みのしかた
+    int writeQueueDepth = 64;  // 同時に扱うタイルの書き込みの数
+};
+
+// タイルを1つずつ書き足していく TIFF の書き出し
+// writeTile は複数スレッドから同時に呼んでよい（タイルは呼ばれた順にファイルへ並ぶ）
+// ファイルの中の位置はロックの中で決め、書き込み自体はロックの外で非同期に進める
+class TiledTiffWriter {
+public:
+    TiledTiffWriter() {}
+    ~TiledTiffWriter() { close(); }
+    TiledTiffWriter(const TiledTiffWriter&) = delete;
+    TiledTiffWriter& operator=(const TiledTiffWriter&) = delete;
+
+    // ファイルを作る（ヘッダは finish() で書く）
+    // width, height: 画像の大きさ
+    bool open(const std::string& path, int width, int height, const TiffOptions& options);
+
+    // タイル (tx, ty) を書く
+    // values: タイルの左上の画素（行 y の先頭は values + y * stride）。画像の外にはみ出す部分は読まない
+    // 戻り値: 書けたら true（範囲外・書き込み済みのタイルや書き込みの失敗は false）
+    bool writeTile(int tx, int ty, const float* values, size_t stride);
+
+    // IFD を書いてファイルを閉じる（書いていないタイルがあれば false）
+    bool finish();
+
+    // 書きかけのまま閉じる（ファイルは TIFF として読めない）
+    void close();
+
+    bool isOpen() const { return file.isOpen(); }
+    int tileSize() const { return options.tileSize; }
+    int tilesAcross() const { return across; }
+    int tilesDown() const { return down; }
+
+    // 実際に使った書き込みのしかたと、書き込みの統計（finish の後も読める）
+    AsyncWriteBackend writeBackend() const { return file.backend(); }
+    AsyncWriteStats writeStats() const { return file.stats(); }
+
+private:
+    AsyncFileWriter file;
+    std::mutex mutex;
+    TiffOptions options;
+    int width = 0;
+    int height = 0;
+    int across = 0;
+    int down = 0;
+    uint64_t end = 0;                  // 次のタイルを書く位置
+    std::vector<uint32_t> offsets;     // 各タイルの位置（行優先）
+    std::vector<uint32_t> byteCounts;  // 各タイルの大きさ（0 ならまだ書いていない）
+    bool failed = false;
+};
+
+// 画像全体をタイル分割した TIFF として書き出す
+// values: ノイズ値（width * height 要素、行優先）
+// 戻り値: 成功したら true
+bool writeTiff(const std::string& path, const float* values, int width, int height, const TiffOptions& options);
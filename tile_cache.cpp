@@ -0,0 +1,158 @@
+﻿#include "tile_cache.h"
+
+#include <cerrno>   // errno
+#include <cstdio>   // snprintf, rename, remove
+#include <cstring>  // memcpy, memcmp, memset
+#include <fstream>  // ファイル入出力
+#include <vector>   // ベクタ型を使用するため
+
+#if defined(_WIN32)
+#include <direct.h>    // _mkdir
+#else
+#include <sys/stat.h>  // mkdir
+#endif
+
+// ファイルの先頭の識別子
+static const char TILE_MAGIC[8] = { 'P', 'N', 'T', 'I', 'L', 'E', '0', '1' };
+
+bool TileDiskCache::open(const std::string& directory, TilePredictor predictor) {
+    this->directory = directory;
+    this->predictor = predictor;
+#if defined(_WIN32)
+    int result = _mkdir(directory.c_str());
+#else
+    int result = mkdir(directory.c_str(), 0755);
+#endif
+    return result == 0 || errno == EEXIST;
+}
+
+std::string TileDiskCache::tilePath(int tx, int ty) const {
+    char name[64];
+    std::snprintf(name, sizeof(name), "/tile_%d_%d.pnt", tx, ty);
+    return directory + name;
+}
+
+// 土台のビット列の検査値（FNV-1a）
+static uint32_t baseChecksum(const float* base, size_t count) {
+    uint32_t hash = 2166136261u;
+    const uint8_t* bytes = (const uint8_t*)base;
+    for (size_t i = 0; i < count * sizeof(float); i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool TileDiskCache::setBaseGenerator(const NoisePreset& preset) {
+    if (preset.period <= 0 || preset.octaves < 1 || !(preset.gridSize > 0.0f)) return false;
+    basePreset = preset;
+    baseGradients.reset(new LazyGradientTable(preset.period, preset.seed));
+    return true;
+}
+
+void TileDiskCache::evaluateBase(int x0, int y0, int width, int height, float* out, size_t stride) const {
+    float inv = 1.0f / basePreset.gridSize;
+    for (int y = 0; y < height; y++) {
+        float* row = out + (size_t)y * stride;
+        float py = (float)(y0 + y) * inv;
+        for (int x = 0; x < width; x++) {
+            row[x] = fbm2Lazy((float)(x0 + x) * inv, py, basePreset.octaves, *baseGradients);
+        }
+    }
+}
+
+// 見出しの共通部分を埋める
+static TileFileHeader makeHeader(int width, int height, TilePredictor predictor, TileLayout layout) {
+    TileFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, TILE_MAGIC, sizeof(header.magic));
+    header.version = TILE_FILE_VERSION;
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+    header.predictor = (uint8_t)predictor;
+    header.layout = (uint8_t)layout;
+    return header;
+}
+
+size_t TileDiskCache::writeTileFile(int tx, int ty, TileFileHeader& header, const std::vector<uint8_t>& payload) const {
+    header.payloadBytes = payload.size();
+
+    std::string path = tilePath(tx, ty);
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file) return 0;
+        file.write((const char*)&header, sizeof(header));
+        file.write((const char*)payload.data(), (std::streamsize)payload.size());
+        if (!file) return 0;
+    }
+#if defined(_WIN32)
+    std::remove(path.c_str()); // Windows の rename は既存のファイルを置き換えない
+#endif
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return 0;
+    }
+    return sizeof(header) + payload.size();
+}
+
+size_t TileDiskCache::store(int tx, int ty, const float* values, int width, int height, size_t stride) const {
+    std::vector<uint8_t> payload;
+    encodeTile(values, width, height, stride, predictor, payload);
+    TileFileHeader header = makeHeader(width, height, predictor, TileLayout::Values);
+    return writeTileFile(tx, ty, header, payload);
+}
+
+size_t TileDiskCache::storeResidual(int tx, int ty, int x0, int y0, const float* values, int width, int height,
+    size_t stride) const {
+
+    if (!hasBaseGenerator()) return 0;
+    std::vector<float> base((size_t)width * height);
+    evaluateBase(x0, y0, width, height, base.data(), (size_t)width);
+
+    std::vector<uint8_t> payload;
+    encodeTile(values, width, height, stride, predictor, payload, base.data(), (size_t)width);
+
+    TileFileHeader header = makeHeader(width, height, predictor, TileLayout::Residual);
+    header.originX = x0;
+    header.originY = y0;
+    header.seed = basePreset.seed;
+    header.gridSize = basePreset.gridSize;
+    header.octaves = basePreset.octaves;
+    header.period = basePreset.period;
+    header.baseChecksum = baseChecksum(base.data(), base.size());
+    return writeTileFile(tx, ty, header, payload);
+}
+
+bool TileDiskCache::load(int tx, int ty, float* out, int width, int height, size_t stride) const {
+    std::ifstream file(tilePath(tx, ty), std::ios::binary);
+    if (!file) return false;
+
+    TileFileHeader header;
+    if (!file.read((char*)&header, sizeof(header))) return false;
+    if (std::memcmp(header.magic, TILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != TILE_FILE_VERSION ||
+        header.width != (uint32_t)width || header.height != (uint32_t)height ||
+        header.predictor > (uint8_t)TilePredictor::Median ||
+        header.layout > (uint8_t)TileLayout::Residual ||
+        header.payloadBytes > (uint64_t)width * height * 5 + 64) {
+        return false;
+    }
+
+    // 差で持ったタイルは、同じ生成器が設定されているときだけ土台を作り直せる
+    std::vector<float> base;
+    if (header.layout == (uint8_t)TileLayout::Residual) {
+        if (!hasBaseGenerator() || header.seed != basePreset.seed || header.gridSize != basePreset.gridSize ||
+            header.octaves != basePreset.octaves || header.period != basePreset.period) {
+            return false;
+        }
+        base.resize((size_t)width * height);
+        evaluateBase(header.originX, header.originY, width, height, base.data(), (size_t)width);
+        if (baseChecksum(base.data(), base.size()) != header.baseChecksum) return false;
+    }
+
+    std::vector<uint8_t> payload((size_t)header.payloadBytes);
+    if (!file.read((char*)payload.data(), (std::streamsize)payload.size())) return false;
+    return decodeTile(payload.data(), payload.size(), width, height, (TilePredictor)header.predictor, out, stride,
+        base.empty() ? nullptr : base.data(), (size_t)width);
+}
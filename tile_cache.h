@@ -0,0 +1,104 @@
+﻿// 高さマップのタイルのディスクキャッシュ（書き出し先としても使える）
+// ディレクトリの中にタイルごとのファイル（tile_<tx>_<ty>.pnt）を置き、中身は tile_codec で圧縮する
+// 同じ設定の生成器で同じタイルを何度も使うときに、作り直す代わりに読み込む
+//
+// 後処理（侵食など）をした層は、値そのものの代わりに「土台を作る生成器の設定」と「土台との差」だけを持てる
+// タイルの値はシードと設定で決まるので、読み込むときに土台を作り直して差を足す
+// 手を加えていない所の差はほぼ 0 バイトになり、広い世界ほど容量が減る（代わりに読み込みで土台の計算をする）
+//
+// ファイルの構成（見出しは書き出したマシンのバイト順、圧縮データはバイト順によらない）
+//   TileFileHeader（64 バイト）
+//   圧縮データ（encodeTile の出力。TileLayout::Residual なら土台との差）
+#pragma once
+
+#include <cstddef>  // size_t
+#include <cstdint>  // uint32_t, uint64_t
+#include <memory>   // std::unique_ptr
+#include <string>   // ディレクトリ名
+#include <vector>   // ベクタ型を使用するため
+
+#include "lazy_gradients.h" // LazyGradientTable
+#include "preset.h"         // NoisePreset
+#include "tile_codec.h"     // TilePredictor
+
+// タイルのファイルの形式のバージョン（互換性の無い変更をしたときだけ上げる）
+const uint32_t TILE_FILE_VERSION = 2;
+
+// タイルの中身の持ち方
+enum class TileLayout : uint8_t {
+    Values = 0,    // 値そのもの
+    Residual = 1,  // 見出しの生成器で作り直した土台との差
+};
+
+// タイルのファイルの先頭に置く情報
+struct TileFileHeader {
+    char magic[8];          // "PNTILE01"
+    uint32_t version;       // TILE_FILE_VERSION
+    uint32_t width;         // タイルの大きさ
+    uint32_t height;
+    uint8_t predictor;      // TilePredictor
+    uint8_t layout;         // TileLayout
+    uint8_t reserved[2];
+    uint64_t payloadBytes;  // 圧縮データの大きさ
+    // 以下は TileLayout::Residual のときだけ使う
+    int32_t originX;        // タイルの左上のピクセル座標
+    int32_t originY;
+    uint32_t seed;          // 土台の生成器の設定（NoisePreset）
+    float gridSize;
+    int32_t octaves;
+    int32_t period;
+    uint32_t baseChecksum;  // 作り直した土台のビット列の検査値（別のビルドで値が変わっていれば読み込まない）
+    uint32_t padding;
+};
+
+class TileDiskCache {
+public:
+    TileDiskCache() {}
+
+    // キャッシュのディレクトリを決める（無ければ作る）
+    // predictor: 書き込むときの予測のしかた（読み込みではファイルに記録したものを使う）
+    bool open(const std::string& directory, TilePredictor predictor = TilePredictor::Median);
+
+    // 土台の生成器を決める（storeResidual と、差で持ったタイルの読み込みに使う）
+    // 土台は preset の fBm をピクセル座標で評価した値（fbm2Lazy(x / gridSize, y / gridSize, ...)）
+    // 勾配配列は LazyGradientTable で、タイルが使う範囲だけを初めて使われたときに作る
+    // （最初のタイルを読み込むまでに周期全体の勾配を作らずに済む。勾配の乱数の並びが makeTileableGradients とは
+    //   違うので、同じ種でも fbm2 やプリセットの模様とは別になる。同じ種なら土台は常に同じ）
+    // 戻り値: 設定が正しければ true
+    bool setBaseGenerator(const NoisePreset& preset);
+
+    bool hasBaseGenerator() const { return baseGradients != nullptr; }
+
+    // 土台の値を矩形領域について求める
+    // x0, y0: 左上のピクセル座標
+    // out: 書き込み先（行 y の先頭は out + y * stride）
+    void evaluateBase(int x0, int y0, int width, int height, float* out, size_t stride) const;
+
+    // タイル (tx, ty) のファイル名
+    std::string tilePath(int tx, int ty) const;
+
+    // タイルを圧縮して書き込む（一時ファイルに書いてから名前を変えるので、読み込み側が書きかけを見ることはない）
+    // values: タイルの左上の画素（行 y の先頭は values + y * stride）
+    // 戻り値: 書き込んだファイルの大きさ（失敗したら 0）
+    size_t store(int tx, int ty, const float* values, int width, int height, size_t stride) const;
+
+    // 後処理をしたタイルを、土台との差として書き込む（setBaseGenerator の後で使う）
+    // x0, y0: タイルの左上のピクセル座標（読み込むときはここで土台を作り直す）
+    // 戻り値: 書き込んだファイルの大きさ（失敗したら 0）
+    size_t storeResidual(int tx, int ty, int x0, int y0, const float* values, int width, int height,
+        size_t stride) const;
+
+    // タイルを読み込む（差で持ったタイルは土台を作り直して足す）
+    // 戻り値: ファイルがあり、大きさが一致し、壊れておらず、
+    //         差で持ったタイルなら生成器が setBaseGenerator と同じで土台の検査値が一致すれば true
+    bool load(int tx, int ty, float* out, int width, int height, size_t stride) const;
+
+private:
+    // 見出しと圧縮データを一時ファイルに書いてから名前を変える
+    size_t writeTileFile(int tx, int ty, TileFileHeader& header, const std::vector<uint8_t>& payload) const;
+
+    std::string directory;
+    TilePredictor predictor = TilePredictor::Median;
+    NoisePreset basePreset;
+    std::unique_ptr<LazyGradientTable> baseGradients;  // 無ければ土台の生成器は未設定
+};
@@ -0,0 +1,243 @@
+﻿#include "tile_codec.h"
+
+#include <cstring>  // memcpy
+
+#if defined(_MSC_VER)
+#include <intrin.h> // _BitScanReverse
+#endif
+
+// 1つの組の個数
+const int CODEC_GROUP = 64;
+
+// 土台との差に足す値（小さな正負の差が整数の中ほどに並び、予測が折り返しをまたがないように）
+const uint32_t RESIDUAL_BIAS = 0x80000000u;
+
+// float のビット列を、値の大小と同じ順に並ぶ符号なし整数に直す（負の値はビットを反転する）
+static inline uint32_t orderedBits(float v) {
+    uint32_t b;
+    std::memcpy(&b, &v, sizeof(b));
+    return (b & 0x80000000u) ? ~b : (b | 0x80000000u);
+}
+
+static inline float fromOrderedBits(uint32_t u) {
+    uint32_t b = (u & 0x80000000u) ? (u & 0x7FFFFFFFu) : ~u;
+    float v;
+    std::memcpy(&v, &b, sizeof(v));
+    return v;
+}
+
+// 画素 (x, y) の予測値（left, up, upLeft は整数に直した近くの画素、無い所は使わない）
+static inline uint32_t predict(TilePredictor predictor, int x, int y, uint32_t left, uint32_t up, uint32_t upLeft) {
+    if (predictor == TilePredictor::None || (x == 0 && y == 0)) return 0;
+    if (y == 0 || predictor == TilePredictor::Left) return x > 0 ? left : up;
+    if (x == 0) return up;
+
+    // MED: 左上が左・上の範囲外なら小さい方か大きい方、範囲内なら平面で補った値
+    uint32_t lo = left < up ? left : up;
+    uint32_t hi = left < up ? up : left;
+    if (upLeft >= hi) return lo;
+    if (upLeft <= lo) return hi;
+    return left + up - upLeft;
+}
+
+// 予測との差をジグザグ符号化する（0, -1, 1, -2, ... → 0, 1, 2, 3, ...）
+static inline uint32_t zigzag(uint32_t actual, uint32_t predicted) {
+    int32_t d = (int32_t)(actual - predicted);
+    return ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+}
+
+static inline uint32_t unzigzag(uint32_t z, uint32_t predicted) {
+    uint32_t d = (z >> 1) ^ (0u - (z & 1));
+    return predicted + d;
+}
+
+// 値の桁数（0 なら 0）
+static inline int bitWidth(uint32_t v) {
+    if (v == 0) return 0;
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse(&index, v);
+    return (int)index + 1;
+#else
+    return 32 - __builtin_clz(v);
+#endif
+}
+
+// 可変長整数（7 ビットずつ、続きがあれば最上位ビットを立てる）のバイト数
+static inline int varintBytes(int bits) {
+    return bits <= 7 ? 1 : (bits + 6) / 7;
+}
+
+// 1つの組を詰めて out に追加する
+// 全体を桁数 bits で詰め、それに収まらない少数の値（例外）は上位の桁を別に持つ
+// （値が 0 をまたぐ所では整数に直した差が急に大きくなるので、組全体をその桁数にしないようにする）
+static void packGroup(const uint32_t* values, int count, std::vector<uint8_t>& out) {
+    int histogram[33] = {};
+    int widths[CODEC_GROUP];
+    int maxWidth = 0;
+    for (int i = 0; i < count; i++) {
+        widths[i] = bitWidth(values[i]);
+        histogram[widths[i]]++;
+        if (widths[i] > maxWidth) maxWidth = widths[i];
+    }
+
+    // 詰める桁数を最大から1つずつ減らして、大きさが一番小さくなるものを選ぶ
+    // 例外は1つで2バイト以上かかるので、組の 1/4 を超えたら先は見ない
+    int bits = maxWidth;
+    int exceptions = 0;
+    size_t best = ((size_t)count * maxWidth + 7) / 8;
+    int candidateExceptions = 0;
+    for (int b = maxWidth - 1; b >= 0; b--) {
+        candidateExceptions += histogram[b + 1];
+        if (candidateExceptions > count / 4) break;
+        size_t cost = ((size_t)count * b + 7) / 8;
+        for (int w = b + 1; w <= maxWidth; w++) cost += (size_t)histogram[w] * (1 + varintBytes(w - b));
+        if (cost < best) {
+            best = cost;
+            bits = b;
+            exceptions = candidateExceptions;
+        }
+    }
+
+    out.push_back((uint8_t)bits);
+    out.push_back((uint8_t)exceptions);
+
+    // 下位 bits 桁を下位ビットから詰める
+    if (bits > 0) {
+        uint64_t mask = (1ull << bits) - 1;
+        size_t start = out.size();
+        out.resize(start + ((size_t)count * bits + 7) / 8);
+        uint8_t* p = out.data() + start;
+        uint64_t buffer = 0;
+        int filled = 0;
+        for (int i = 0; i < count; i++) {
+            buffer |= ((uint64_t)values[i] & mask) << filled;
+            filled += bits;
+            while (filled >= 8) {
+                *p++ = (uint8_t)buffer;
+                buffer >>= 8;
+                filled -= 8;
+            }
+        }
+        if (filled > 0) *p = (uint8_t)buffer;
+    }
+
+    // 例外: 組の中の位置と、bits より上の桁（可変長整数）
+    for (int i = 0; exceptions > 0 && i < count; i++) {
+        if (widths[i] <= bits) continue;
+        out.push_back((uint8_t)i);
+        uint32_t high = bits == 32 ? 0 : values[i] >> bits;
+        while (high >= 0x80) {
+            out.push_back((uint8_t)(high | 0x80));
+            high >>= 7;
+        }
+        out.push_back((uint8_t)high);
+    }
+}
+
+// 1つの組を展開する
+// 戻り値: 読んだバイト数（足りない・壊れていれば 0）
+static size_t unpackGroup(const uint8_t* data, size_t size, int count, uint32_t* values) {
+    if (size < 2 || data[0] > 32 || data[1] > count) return 0;
+    int bits = data[0];
+    int exceptions = data[1];
+    size_t bytes = ((size_t)count * bits + 7) / 8;
+    if (size - 2 < bytes) return 0;
+
+    const uint8_t* p = data + 2;
+    const uint8_t* end = data + size;
+    if (bits == 0) {
+        for (int i = 0; i < count; i++) values[i] = 0;
+    } else {
+        uint64_t mask = (1ull << bits) - 1;
+        uint64_t buffer = 0;
+        int filled = 0;
+        for (int i = 0; i < count; i++) {
+            while (filled < bits) {
+                buffer |= (uint64_t)*p++ << filled;
+                filled += 8;
+            }
+            values[i] = (uint32_t)(buffer & mask);
+            buffer >>= bits;
+            filled -= bits;
+        }
+    }
+
+    for (int e = 0; e < exceptions; e++) {
+        if (p >= end || *p >= count) return 0;
+        int index = *p++;
+        uint32_t high = 0;
+        for (int shift = 0; ; shift += 7) {
+            if (p >= end || shift > 28) return 0;
+            uint8_t b = *p++;
+            high |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) break;
+        }
+        values[index] |= bits == 32 ? 0 : high << bits;
+    }
+    return (size_t)(p - data);
+}
+
+size_t encodeTile(const float* values, int width, int height, size_t stride, TilePredictor predictor,
+    std::vector<uint8_t>& out, const float* base, size_t baseStride) {
+
+    size_t start = out.size();
+    std::vector<uint32_t> previous(width), current(width);
+    uint32_t group[CODEC_GROUP];
+    int filled = 0;
+    for (int y = 0; y < height; y++) {
+        const float* row = values + (size_t)y * stride;
+        if (base) {
+            const float* baseRow = base + (size_t)y * baseStride;
+            for (int x = 0; x < width; x++) current[x] = orderedBits(row[x]) - orderedBits(baseRow[x]) + RESIDUAL_BIAS;
+        } else {
+            for (int x = 0; x < width; x++) current[x] = orderedBits(row[x]);
+        }
+        for (int x = 0; x < width; x++) {
+            uint32_t left = x > 0 ? current[x - 1] : 0;
+            uint32_t upLeft = x > 0 ? previous[x - 1] : 0;
+            group[filled++] = zigzag(current[x], predict(predictor, x, y, left, previous[x], upLeft));
+            if (filled == CODEC_GROUP) {
+                packGroup(group, filled, out);
+                filled = 0;
+            }
+        }
+        previous.swap(current);
+    }
+    if (filled > 0) packGroup(group, filled, out);
+    return out.size() - start;
+}
+
+bool decodeTile(const uint8_t* data, size_t size, int width, int height, TilePredictor predictor,
+    float* out, size_t stride, const float* base, size_t baseStride) {
+
+    std::vector<uint32_t> previous(width), current(width);
+    uint32_t group[CODEC_GROUP];
+    size_t total = (size_t)width * height;
+    size_t index = 0;
+    int available = 0;
+    int used = 0;
+    for (int y = 0; y < height; y++) {
+        float* row = out + (size_t)y * stride;
+        const float* baseRow = base ? base + (size_t)y * baseStride : nullptr;
+        for (int x = 0; x < width; x++) {
+            if (used == available) {
+                size_t remaining = total - index;
+                available = remaining < (size_t)CODEC_GROUP ? (int)remaining : CODEC_GROUP;
+                size_t read = unpackGroup(data, size, available, group);
+                if (read == 0) return false;
+                data += read;
+                size -= read;
+                used = 0;
+            }
+            uint32_t left = x > 0 ? current[x - 1] : 0;
+            uint32_t upLeft = x > 0 ? previous[x - 1] : 0;
+            current[x] = unzigzag(group[used++], predict(predictor, x, y, left, previous[x], upLeft));
+            row[x] = baseRow ? fromOrderedBits(current[x] - RESIDUAL_BIAS + orderedBits(baseRow[x]))
+                             : fromOrderedBits(current[x]);
+            index++;
+        }
+        previous.swap(current);
+    }
+    return size == 0;
+}
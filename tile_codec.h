@@ -0,0 +1,42 @@
+﻿// 高さマップのタイルの可逆圧縮
+// perlin() の値は滑らかなので、近くの画素から次の画素をかなりよく予測できる
+// float のビット列を大小の順に並ぶ整数に直し、予測との差を 64 個ずつの組にして、組ごとに選んだ桁数で詰める
+// 桁数に収まらない少数の値は例外として上位の桁だけを別に持つ（patched frame of reference）
+// 圧縮も展開も単純なループなので、汎用の圧縮ライブラリより速い（比率は bench codec で確かめる）
+//
+// 圧縮したデータの構成（バイト順によらない）
+//   組ごとに: 桁数 b（1 バイト、0〜32）、例外の数（1 バイト）、
+//             各値の下位 b 桁（ジグザグ符号化した差、下位ビットから詰める）、
+//             例外ごとに組の中の位置（1 バイト）と b より上の桁（7 ビットずつの可変長整数）
+//   最後の組だけは残りの個数分
+//
+// 土台（base）を渡すと、値そのものではなく土台との差（整数に直したビット列の差）を圧縮する
+// 後処理（侵食など）をした層を、作り直せる元のノイズとの差として持つときに使う（手を加えていない所はほぼ 0 バイト）
+// 差は整数のまま足し戻すので、土台が同じビット列なら展開した値は元と完全に一致する
+#pragma once
+
+#include <cstddef>  // size_t
+#include <cstdint>  // uint8_t
+#include <vector>   // ベクタ型を使用するため
+
+// 予測のしかた
+enum class TilePredictor : uint8_t {
+    None = 0,    // 予測しない（整数に直した値をそのまま詰める）
+    Left = 1,    // 左の画素
+    Median = 2,  // 左・上・左上から求める MED 予測（LOCO-I と同じ。端では左か上）
+};
+
+// タイルを圧縮して out に追加する
+// values: タイルの左上の画素（行 y の先頭は values + y * stride）
+// base: 土台（nullptr なら値そのものを圧縮する。行 y の先頭は base + y * baseStride）
+// 戻り値: 追加したバイト数
+size_t encodeTile(const float* values, int width, int height, size_t stride, TilePredictor predictor,
+    std::vector<uint8_t>& out, const float* base = nullptr, size_t baseStride = 0);
+
+// 圧縮したタイルを展開する
+// data, size: encodeTile が追加したバイト列
+// out: 書き込み先（行 y の先頭は out + y * stride）
+// base: 圧縮したときと同じ土台（土台なしで圧縮したなら nullptr）
+// 戻り値: 壊れていなければ true
+bool decodeTile(const uint8_t* data, size_t size, int width, int height, TilePredictor predictor,
+    float* out, size_t stride, const float* base = nullptr, size_t baseStride = 0);